@@ -9,16 +9,32 @@ float GetEElstIJ(float rij, float qi, float qj, float epsilon, float ceu_to_kcal
 	return ceu_to_kcal * qi * qj / (epsilon * rij);
 }
 
-kernel void CalculateNonBondedForces(constant int *combinationMatrix, constant int *nonInts, constant int *nonIntsSize, constant float3 *positions, constant float *charges, constant float *vdwRadii, constant float *vdwAttractionMagnitudes, constant float *dielectric, constant float *CEU_TO_KCAL, global float *eVDW, global float *eElst) {
-	int id = get_global_id(0);
+void PairFromIndex(ulong index, int n, int *i, int *j) {
+	float b = 2.0f * n - 1.0f;
+	long row = (long)floor((b - sqrt(max(0.0f, b * b - 8.0f * (float)index))) / 2.0f);
 
-	int i = combinationMatrix[id * 2];
-	int j = combinationMatrix[id * 2 + 1];
+	row = clamp(row, 0L, (long)n - 2);
+
+	while (row > 0 && (ulong)(row * (2L * n - row - 1) / 2) > index) row--;
+	while ((ulong)((row + 1) * (2L * n - row - 2) / 2) <= index) row++;
+
+	*i = (int)row;
+	*j = (int)(index - row * (2L * n - row - 1) / 2 + row + 1);
+}
+
+kernel void CalculateNonBondedForces(constant int *nAtoms, constant int *exclusionOffsets, constant int *exclusionPartners, constant float3 *positions, constant float *charges, constant int *typeIds, constant float2 *vdwPairs, constant int *nTypes, constant float *dielectric, constant float *CEU_TO_KCAL, global float *eVDW, global float *eElst) {
+	ulong id = get_global_id(0);
+
+	int i;
+	int j;
+
+	PairFromIndex(id, *nAtoms, &i, &j);
 
 	int found = 0;
 
-	for (int k = 0; k < *nonIntsSize; k += 2) {
-		if (nonInts[k] == i && nonInts[k + 1] == j) {
+	/* Excluded partners of i are sorted, so the scan stops at the first one past j. */
+	for (int k = exclusionOffsets[i]; k < exclusionOffsets[i + 1] && exclusionPartners[k] <= j; k++) {
+		if (exclusionPartners[k] == j) {
 			found = 1;
 		}
 	}
@@ -29,10 +45,10 @@ kernel void CalculateNonBondedForces(constant int *combinationMatrix, constant i
 		float c = positions[i].z - positions[j].z;
 
 		float distance = sqrt(a * a + b * b + c * c);
-		float vdwAttractionMagnitudeIJ = sqrt(vdwAttractionMagnitudes[i]) * sqrt(vdwAttractionMagnitudes[j]);
-		float vdwRadiusIJ = vdwRadii[i] + vdwRadii[j];
+		/* Pair parameters come from the type pair table, nbfix overrides included: x is ro_ij, y is eps_ij. */
+		float2 vdwPair = vdwPairs[typeIds[i] * (*nTypes) + typeIds[j]];
 
-		(*eVDW) += GetEVDWIJ(distance, vdwAttractionMagnitudeIJ, vdwRadiusIJ);
+		(*eVDW) += GetEVDWIJ(distance, vdwPair.y, vdwPair.x);
 		(*eElst) += GetEElstIJ(distance, charges[i], charges[j], *dielectric, *CEU_TO_KCAL);
 	}
 }
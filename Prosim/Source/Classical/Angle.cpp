@@ -6,7 +6,7 @@
 namespace classical {
 
 	Angle::Angle(int atom1, int atom2, int atom3, double degrees, double equilibriumDegrees, double springConstant) 
-		: atom1(atom1), atom2(atom2), atom3(atom3), 
+		: atom1(atom1), atom2(atom2), atom3(atom3), bond12(-1), bond23(-1), 
 		degrees(degrees), equilibriumDegrees(equilibriumDegrees), springConstant(springConstant) {
 
 	}
@@ -15,6 +15,9 @@ namespace classical {
 		int atom1;
 		int atom2;
 		int atom3;
+		/* BondGraph indices of the bonds 1-2 and 2-3. */
+		int bond12;
+		int bond23;
 		double degrees;
 		double equilibriumDegrees;
 		double springConstant;
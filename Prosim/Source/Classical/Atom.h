@@ -6,25 +6,18 @@
 
 namespace classical {
 
+	/* Descriptive data of an atom. Positions, velocities and the parameters used by the force kernels live in the
+	   molecule's ParticleStore under the same index. */
 	struct Atom {
-		Atom(const String &type, const math::Vec3 &position, double charge, ForceField *forceField, double ro, double epsilon);
-		Atom(const String &type, const math::Vec3 &position, double charge, ForceField *forceField);
+		Atom(const String &type, ForceField *forceField);
 
 		friend std::ostream& operator<<(std::ostream &stream, const Atom &atom);
 
-		math::Vec3 position;
-		math::Vec3 velocity;
-		math::Vec3 acceleration;
-		math::Vec3 previousVelocity;
-		math::Vec3 previousAcceleration;
-
 		String element;
 		String type;
+		/* Force field type id, -1 if the force field has no parameters for the type. */
+		int typeId;
 
-		double charge;
-		double vdwRadius;
-		double vdwAttractionMagnitude;
-		double mass;
 		double covalentRadius;
 
 	private:
@@ -0,0 +1,169 @@
+#include "Barostat.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "Constants.h"
+
+#include "Math/Philox.h"
+
+namespace classical {
+
+	/* Philox stream of the barostat; the initial velocities and the Langevin forces use streams 0 and 1. */
+	static const uint32_t s_barostatStream = 2;
+
+	/* Adaption interval and the bounds of the largest volume change relative to the volume. */
+	static const int s_adaptionAttempts = 10;
+	static const double s_minRelativeVolumeChange = 1e-5;
+	static const double s_maxRelativeVolumeChange = 0.3;
+
+	BarostatType ResolveBarostatType(const String &name) {
+		if (name.find("none") != String::npos) {
+			return BarostatType::None;
+		}
+		else if (name.find("monte-carlo") != String::npos) {
+			return BarostatType::MonteCarlo;
+		}
+
+		std::cout << "Unknown barostat: " << name << std::endl;
+		std::cout << "Use 'none' or 'monte-carlo'" << std::endl;
+		return BarostatType::None;
+	}
+
+	String GetBarostatTypeName(BarostatType type) {
+		switch (type) {
+		case BarostatType::MonteCarlo: return "monte-carlo";
+		default: return "none";
+		}
+	}
+
+	MonteCarloBarostat::MonteCarloBarostat(Molecule *molecule, double pressure, double temperature, int seed)
+		: m_molecule(molecule), m_pressure(pressure), m_temperature(temperature), m_seed(seed),
+		m_nAttempts(0), m_nAccepted(0), m_nRecentAttempts(0), m_nRecentAccepted(0) {
+
+		m_maxVolumeChange = 0.01 * m_molecule->GetMemberVolume();
+
+		m_molecule->GetBondGraph().FindComponents(m_moleculeOffsets, m_moleculeAtoms);
+	}
+
+	bool MonteCarloBarostat::Apply(uint64_t step) {
+		ParticleStore &particles = m_molecule->GetParticles();
+
+		double deviates[4];
+		math::GetUniformDeviates(m_seed, s_barostatStream, step, 0, deviates);
+
+		double volume = m_molecule->GetMemberVolume();
+		double newVolume = volume + m_maxVolumeChange * (2.0 * deviates[0] - 1.0);
+
+		if (newVolume <= 0.0) {
+			RecordAttempt(false);
+			return false;
+		}
+
+		double boundary = m_molecule->GetBoundary();
+		PeriodicBox box = m_molecule->GetPeriodicBox();
+		PeriodicBox scaledBox = box;
+		double ePotential = m_molecule->GetMemberEPotential();
+		double scale = cbrt(newVolume / volume);
+
+		scaledBox.Scale(scale);
+
+		/* A box compressed below twice the cutoff would let the minimum image drop pairs. */
+		if (scaledBox.IsPeriodic() && m_molecule->GetNonBondedCutoff() > 0.5 * scaledBox.GetMinimumLength()) {
+			RecordAttempt(false);
+			return false;
+		}
+
+		for (int j = 0; j < 3; j++) {
+			m_savedPositions[j] = particles.position[j];
+		}
+
+		ScaleMolecules(scale);
+		m_molecule->SetBoundary(boundary * scale);
+		m_molecule->SetPeriodicBox(scaledBox);
+		m_molecule->CalculateVolume();
+		m_molecule->UpdateInternals();
+		m_molecule->CalculateEnergyAndGradient();
+
+		/* kcal/mol; the pressure is converted from bar. */
+		double kT = BOLTZMANN_CONSTANT * m_temperature;
+		double work = m_molecule->GetMemberEPotential() - ePotential + m_pressure / KCAL_A_MOL_TO_PA * (newVolume - volume) - GetNMolecules() * kT * log(newVolume / volume);
+		bool accepted = work <= 0.0 || deviates[1] < exp(-work / kT);
+
+		if (!accepted) {
+			for (int j = 0; j < 3; j++) {
+				particles.position[j].swap(m_savedPositions[j]);
+			}
+
+			m_molecule->SetBoundary(boundary);
+			m_molecule->SetPeriodicBox(box);
+			m_molecule->CalculateVolume();
+			m_molecule->UpdateInternals();
+			m_molecule->CalculateEnergyAndGradient();
+		}
+
+		RecordAttempt(accepted);
+
+		return accepted;
+	}
+
+	void MonteCarloBarostat::RecordAttempt(bool accepted) {
+		m_nAttempts++;
+		m_nRecentAttempts++;
+
+		if (accepted) {
+			m_nAccepted++;
+			m_nRecentAccepted++;
+		}
+
+		if (m_nRecentAttempts >= s_adaptionAttempts) {
+			double acceptance = (double)m_nRecentAccepted / m_nRecentAttempts;
+			double currentVolume = m_molecule->GetMemberVolume();
+
+			if (acceptance < 0.25) {
+				m_maxVolumeChange /= 1.1;
+			}
+			else if (acceptance > 0.75) {
+				m_maxVolumeChange *= 1.1;
+			}
+
+			m_maxVolumeChange = std::min(std::max(m_maxVolumeChange, s_minRelativeVolumeChange * currentVolume), s_maxRelativeVolumeChange * currentVolume);
+			m_nRecentAttempts = 0;
+			m_nRecentAccepted = 0;
+		}
+	}
+
+	void MonteCarloBarostat::ScaleMolecules(double scale) {
+		ParticleStore &particles = m_molecule->GetParticles();
+		const math::Vec3 &origin = m_molecule->GetOrigin();
+		int nmolecules = GetNMolecules();
+
+#pragma omp parallel for
+		for (int m = 0; m < nmolecules; m++) {
+			double mass = 0.0;
+			double center[3] = { 0.0, 0.0, 0.0 };
+
+			for (int n = m_moleculeOffsets[m]; n < m_moleculeOffsets[m + 1]; n++) {
+				int i = m_moleculeAtoms[n];
+
+				mass += particles.mass[i];
+
+				for (int j = 0; j < 3; j++) {
+					center[j] += particles.mass[i] * particles.position[j][i];
+				}
+			}
+
+			/* Every atom moves with its molecule's center of mass. */
+			for (int j = 0; j < 3; j++) {
+				double shift = (scale - 1.0) * (center[j] / mass - origin[j]);
+
+				for (int n = m_moleculeOffsets[m]; n < m_moleculeOffsets[m + 1]; n++) {
+					particles.position[j][m_moleculeAtoms[n]] += shift;
+				}
+			}
+		}
+	}
+
+}
\ No newline at end of file
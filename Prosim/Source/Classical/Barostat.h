@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "Molecule.h"
+
+namespace classical {
+
+	/* Pressure control of the molecular dynamics loop. The Monte Carlo barostat changes the volume enclosed by the
+	   boundary at random and accepts or rejects the change by the NPT Metropolis criterion. */
+	enum class BarostatType {
+		None,
+		MonteCarlo
+	};
+
+	/* Maps "none" or "monte-carlo" to a barostat; anything else is reported and falls back to none. */
+	BarostatType ResolveBarostatType(const String &name);
+	String GetBarostatTypeName(BarostatType type);
+
+	/* Monte Carlo barostat (Chow and Ferguson, Comput. Phys. Commun. 91, 283 (1995); Aqvist et al., Chem. Phys. Lett. 384,
+	   288 (2004)). A trial scales the boundary, the periodic box if there is one, and the centers of mass of the
+	   molecules, the connected components of the bond graph, about the origin, so bonds, constraints and rigid waters
+	   keep their geometry. It is accepted with probability min(1, exp(-(dU + P dV - N_mol kT ln(V'/V)) / kT)). The
+	   largest volume change adapts to keep the acceptance between a quarter and three quarters. */
+	class MonteCarloBarostat {
+	public:
+		/* pressure is in bar, the unit of Molecule::CalculatePressure. */
+		MonteCarloBarostat(Molecule *molecule, double pressure, double temperature, int seed);
+
+		/* One trial volume change for the given step. The energy and gradient of the molecule have to be current and are
+		   current again afterwards. A periodic box that would no longer hold the non-bonded cutoff is rejected. Returns
+		   whether the change was accepted. */
+		bool Apply(uint64_t step);
+
+		inline int GetNMolecules() const { return m_moleculeOffsets.size() - 1; }
+		inline int GetNAttempts() const { return m_nAttempts; }
+		inline int GetNAccepted() const { return m_nAccepted; }
+		inline double GetMaxVolumeChange() const { return m_maxVolumeChange; }
+	private:
+		/* Counts a trial and adapts the largest volume change every s_adaptionAttempts trials. */
+		void RecordAttempt(bool accepted);
+		void ScaleMolecules(double scale);
+	private:
+		Molecule *m_molecule;
+		double m_pressure;
+		double m_temperature;
+		int m_seed;
+
+		double m_maxVolumeChange;
+		int m_nAttempts;
+		int m_nAccepted;
+		/* Attempts and acceptances since the last adaption of the largest volume change. */
+		int m_nRecentAttempts;
+		int m_nRecentAccepted;
+
+		/* The atoms of molecule m are m_moleculeAtoms[m_moleculeOffsets[m]] ... m_moleculeAtoms[m_moleculeOffsets[m + 1] - 1]. */
+		std::vector<int> m_moleculeOffsets;
+		std::vector<int> m_moleculeAtoms;
+		std::vector<double> m_savedPositions[3];
+	};
+
+}
\ No newline at end of file
@@ -6,7 +6,7 @@
 namespace classical {
 
 	Bond::Bond(int atom1, int atom2, double distance, double equilibriumDistance, double springConstant) 
-		: atom1(atom1), atom2(atom2), distance(distance), 
+		: atom1(atom1), atom2(atom2), graphIndex(-1), distance(distance), 
 		equilibriumDistance(equilibriumDistance), springConstant(springConstant) {
 
 	}
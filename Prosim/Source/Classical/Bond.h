@@ -14,6 +14,8 @@ namespace classical {
 
 		int atom1;
 		int atom2;
+		/* Index of the bond in the molecule's BondGraph. */
+		int graphIndex;
 		double distance;
 		double equilibriumDistance;
 		double springConstant;
@@ -0,0 +1,122 @@
+#include "BondGraph.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "Geometry.h"
+
+namespace classical {
+
+	BondGraph::BondGraph()
+		: m_nAtoms(0), m_offsets(1, 0) {
+
+	}
+
+	void BondGraph::Build(int natoms, const std::vector<int> &bondedPairs) {
+		std::vector<std::pair<int, int>> bonds;
+
+		for (int k = 0; k + 1 < (int)bondedPairs.size(); k += 2) {
+			int i = bondedPairs[k];
+			int j = bondedPairs[k + 1];
+
+			if (i != j) bonds.push_back(std::make_pair(std::min(i, j), std::max(i, j)));
+		}
+
+		std::sort(bonds.begin(), bonds.end());
+		bonds.erase(std::unique(bonds.begin(), bonds.end()), bonds.end());
+
+		int nbonds = bonds.size();
+
+		m_nAtoms = natoms;
+		m_offsets.assign(natoms + 1, 0);
+		m_neighbors.resize(2 * nbonds);
+		m_edgeBonds.resize(2 * nbonds);
+		m_bondAtoms.resize(2 * nbonds);
+		m_lengths.assign(nbonds, 0.0);
+
+		for (auto &bond : bonds) {
+			m_offsets[bond.first + 1]++;
+			m_offsets[bond.second + 1]++;
+		}
+
+		for (int i = 0; i < natoms; i++) {
+			m_offsets[i + 1] += m_offsets[i];
+		}
+
+		/* A neighbor j < i arrives with bond (j, i), which sorts before every bond (i, k), so walking the bonds in order
+		   fills each row in ascending order. */
+		std::vector<int> fill(m_offsets.begin(), m_offsets.end() - 1);
+
+		for (int b = 0; b < nbonds; b++) {
+			int i = bonds[b].first;
+			int j = bonds[b].second;
+
+			m_bondAtoms[2 * b] = i;
+			m_bondAtoms[2 * b + 1] = j;
+
+			m_neighbors[fill[i]] = j;
+			m_edgeBonds[fill[i]++] = b;
+			m_neighbors[fill[j]] = i;
+			m_edgeBonds[fill[j]++] = b;
+		}
+	}
+
+	void BondGraph::UpdateLengths(const ParticleStore &particles, const PeriodicBox &box) {
+		int nbonds = GetNBonds();
+
+		for (int b = 0; b < nbonds; b++) {
+			int i = m_bondAtoms[2 * b];
+			int j = m_bondAtoms[2 * b + 1];
+
+			double x = particles.position[0][j] - particles.position[0][i];
+			double y = particles.position[1][j] - particles.position[1][i];
+			double z = particles.position[2][j] - particles.position[2][i];
+
+			box.ApplyMinimumImage(x, y, z);
+
+			m_lengths[b] = sqrt(x * x + y * y + z * z);
+		}
+	}
+
+	void BondGraph::FindComponents(std::vector<int> &offsets, std::vector<int> &atoms) const {
+		std::vector<bool> visited(m_nAtoms, false);
+
+		offsets.assign(1, 0);
+		atoms.clear();
+
+		/* Breadth-first search over the bonds; atoms doubles as the queue. */
+		for (int i = 0; i < m_nAtoms; i++) {
+			if (visited[i]) continue;
+
+			visited[i] = true;
+			atoms.push_back(i);
+
+			for (int n = offsets.back(); n < (int)atoms.size(); n++) {
+				int atom = atoms[n];
+
+				for (int edge = m_offsets[atom]; edge < m_offsets[atom + 1]; edge++) {
+					int neighbor = m_neighbors[edge];
+
+					if (visited[neighbor]) continue;
+
+					visited[neighbor] = true;
+					atoms.push_back(neighbor);
+				}
+			}
+
+			offsets.push_back(atoms.size());
+		}
+	}
+
+	int BondGraph::FindBond(int i, int j) const {
+		if (i < 0 || i >= m_nAtoms) return -1;
+
+		std::vector<int>::const_iterator begin = m_neighbors.begin() + m_offsets[i];
+		std::vector<int>::const_iterator end = m_neighbors.begin() + m_offsets[i + 1];
+		std::vector<int>::const_iterator it = std::lower_bound(begin, end, j);
+
+		return (it != end && *it == j) ? m_edgeBonds[it - m_neighbors.begin()] : -1;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include "ParticleStore.h"
+#include "PeriodicBox.h"
+
+namespace classical {
+
+	/* Adjacency of the bonded atoms in compressed sparse row form, built once from the topology. Every bond is stored
+	   as two directed edges, one in each atom's ascending neighbor list, which share one bond index and one cached
+	   length. Bonded terms keep the bond indices of their edges so they read lengths without any lookup. */
+	class BondGraph {
+	public:
+		BondGraph();
+
+		/* bondedPairs holds flattened (i, j) pairs in any order; duplicates and self pairs are dropped. Bonds are
+		   numbered in ascending (min(i, j), max(i, j)) order. The lengths are left at zero until UpdateLengths. */
+		void Build(int natoms, const std::vector<int> &bondedPairs);
+
+		/* Recomputes the length of every bond from the current positions, between nearest images in a periodic box. */
+		void UpdateLengths(const ParticleStore &particles, const PeriodicBox &box = PeriodicBox());
+
+		/* Splits the atoms into molecules, the connected components of the graph. The atoms of molecule m are
+		   atoms[offsets[m]] ... atoms[offsets[m + 1] - 1], in breadth-first order from the lowest index. */
+		void FindComponents(std::vector<int> &offsets, std::vector<int> &atoms) const;
+
+		/* Index of the bond between i and j, or -1 if they are not bonded. */
+		int FindBond(int i, int j) const;
+
+		inline int GetNAtoms() const { return m_nAtoms; }
+		inline int GetNBonds() const { return m_lengths.size(); }
+
+		/* The edges of atom i are GetOffsets()[i] ... GetOffsets()[i + 1] - 1. */
+		inline const std::vector<int> &GetOffsets() const { return m_offsets; }
+		inline int GetDegree(int i) const { return m_offsets[i + 1] - m_offsets[i]; }
+		inline int GetNeighbor(int edge) const { return m_neighbors[edge]; }
+		inline int GetEdgeBond(int edge) const { return m_edgeBonds[edge]; }
+
+		/* Atoms of bond b, atom1 < atom2. */
+		inline int GetBondAtom1(int bond) const { return m_bondAtoms[2 * bond]; }
+		inline int GetBondAtom2(int bond) const { return m_bondAtoms[2 * bond + 1]; }
+		inline double GetLength(int bond) const { return m_lengths[bond]; }
+	private:
+		int m_nAtoms;
+
+		std::vector<int> m_offsets;
+		std::vector<int> m_neighbors;
+		std::vector<int> m_edgeBonds;
+		std::vector<int> m_bondAtoms;
+		std::vector<double> m_lengths;
+	};
+
+}
\ No newline at end of file
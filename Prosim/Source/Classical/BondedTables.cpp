@@ -0,0 +1,326 @@
+#include "BondedTables.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace classical {
+
+	/* Term order after sorting by the first atom. std::sort makes the same moves for the same sequence of comparisons,
+	   so this reproduces the order the vectors of per-term objects were sorted into. */
+	static std::vector<int> GetFirstAtomOrder(const std::vector<int> &atom1) {
+		std::vector<int> order(atom1.size());
+		std::iota(order.begin(), order.end(), 0);
+
+		std::sort(order.begin(), order.end(), [&](int a, int b) { return atom1[a] < atom1[b]; });
+
+		return order;
+	}
+
+	static bool IsColorUsed(const std::vector<std::vector<int>> &atomColors, const std::vector<const std::vector<int> *> &atoms, int n, int color) {
+		for (int a = 0; a < (int)atoms.size(); a++) {
+			const std::vector<int> &used = atomColors[(*atoms[a])[n]];
+
+			if (std::find(used.begin(), used.end(), color) != used.end()) return true;
+		}
+
+		return false;
+	}
+
+	/* Greedy coloring of the terms, each given the lowest color not yet used at any of its atoms. Returns the term order grouped
+	   by color, keeping the previous order within every color, and sets colorOffsets to the start of each color. */
+	static std::vector<int> GetColorOrder(const std::vector<const std::vector<int> *> &atoms, int natoms, std::vector<int> &colorOffsets) {
+		int nterms = atoms[0]->size();
+
+		std::vector<int> colors(nterms);
+		std::vector<std::vector<int>> atomColors(natoms);
+		int ncolors = 0;
+
+		for (int n = 0; n < nterms; n++) {
+			int color = 0;
+
+			while (IsColorUsed(atomColors, atoms, n, color)) {
+				color++;
+			}
+
+			for (int a = 0; a < (int)atoms.size(); a++) {
+				atomColors[(*atoms[a])[n]].push_back(color);
+			}
+
+			colors[n] = color;
+			ncolors = std::max(ncolors, color + 1);
+		}
+
+		colorOffsets.assign(ncolors + 1, 0);
+
+		for (int n = 0; n < nterms; n++) {
+			colorOffsets[colors[n] + 1]++;
+		}
+
+		std::partial_sum(colorOffsets.begin(), colorOffsets.end(), colorOffsets.begin());
+
+		std::vector<int> order(nterms);
+		std::vector<int> next(colorOffsets.begin(), colorOffsets.end() - 1);
+
+		for (int n = 0; n < nterms; n++) {
+			order[next[colors[n]]++] = n;
+		}
+
+		return order;
+	}
+
+	template <typename T>
+	static void Gather(std::vector<T> &values, const std::vector<int> &order) {
+		std::vector<T> gathered(order.size());
+
+		for (int n = 0; n < (int)order.size(); n++) {
+			gathered[n] = values[order[n]];
+		}
+
+		values.swap(gathered);
+	}
+
+	int BondTable::Add(const Bond &bond) {
+		atom1.push_back(bond.atom1);
+		atom2.push_back(bond.atom2);
+		graphIndex.push_back(bond.graphIndex);
+		distance.push_back(bond.distance);
+		equilibriumDistance.push_back(bond.equilibriumDistance);
+		springConstant.push_back(bond.springConstant);
+		colorOffsets.clear();
+
+		return GetSize() - 1;
+	}
+
+	void BondTable::Clear() {
+		atom1.clear();
+		atom2.clear();
+		graphIndex.clear();
+		distance.clear();
+		equilibriumDistance.clear();
+		springConstant.clear();
+		colorOffsets.clear();
+	}
+
+	void BondTable::SortByFirstAtom() {
+		Reorder(GetFirstAtomOrder(atom1));
+		colorOffsets.clear();
+	}
+
+	void BondTable::ColorByAtoms(int natoms) {
+		Reorder(GetColorOrder({ &atom1, &atom2 }, natoms, colorOffsets));
+	}
+
+	void BondTable::Select(const std::vector<int> &terms) {
+		Reorder(terms);
+		colorOffsets.clear();
+	}
+
+	void BondTable::Reorder(const std::vector<int> &order) {
+		Gather(atom1, order);
+		Gather(atom2, order);
+		Gather(graphIndex, order);
+		Gather(distance, order);
+		Gather(equilibriumDistance, order);
+		Gather(springConstant, order);
+	}
+
+	Bond BondTable::GetTerm(int n) const {
+		Bond bond(atom1[n], atom2[n], distance[n], equilibriumDistance[n], springConstant[n]);
+		bond.graphIndex = graphIndex[n];
+		bond.CalculateEnergy();
+		bond.CalculateGradientMagnitude();
+
+		return bond;
+	}
+
+	int AngleTable::Add(const Angle &angle) {
+		atom1.push_back(angle.atom1);
+		atom2.push_back(angle.atom2);
+		atom3.push_back(angle.atom3);
+		bond12.push_back(angle.bond12);
+		bond23.push_back(angle.bond23);
+		degrees.push_back(angle.degrees);
+		equilibriumDegrees.push_back(angle.equilibriumDegrees);
+		springConstant.push_back(angle.springConstant);
+		colorOffsets.clear();
+
+		return GetSize() - 1;
+	}
+
+	void AngleTable::Clear() {
+		atom1.clear();
+		atom2.clear();
+		atom3.clear();
+		bond12.clear();
+		bond23.clear();
+		degrees.clear();
+		equilibriumDegrees.clear();
+		springConstant.clear();
+		colorOffsets.clear();
+	}
+
+	void AngleTable::SortByFirstAtom() {
+		Reorder(GetFirstAtomOrder(atom1));
+		colorOffsets.clear();
+	}
+
+	void AngleTable::ColorByAtoms(int natoms) {
+		Reorder(GetColorOrder({ &atom1, &atom2, &atom3 }, natoms, colorOffsets));
+	}
+
+	void AngleTable::Select(const std::vector<int> &terms) {
+		Reorder(terms);
+		colorOffsets.clear();
+	}
+
+	void AngleTable::Reorder(const std::vector<int> &order) {
+		Gather(atom1, order);
+		Gather(atom2, order);
+		Gather(atom3, order);
+		Gather(bond12, order);
+		Gather(bond23, order);
+		Gather(degrees, order);
+		Gather(equilibriumDegrees, order);
+		Gather(springConstant, order);
+	}
+
+	Angle AngleTable::GetTerm(int n) const {
+		Angle angle(atom1[n], atom2[n], atom3[n], degrees[n], equilibriumDegrees[n], springConstant[n]);
+		angle.bond12 = bond12[n];
+		angle.bond23 = bond23[n];
+		angle.CalculateEnergy();
+		angle.CalculateGradientMagnitude();
+
+		return angle;
+	}
+
+	int TorsionTable::Add(const Torsion &torsion) {
+		atom1.push_back(torsion.atom1);
+		atom2.push_back(torsion.atom2);
+		atom3.push_back(torsion.atom3);
+		atom4.push_back(torsion.atom4);
+		bond12.push_back(torsion.bond12);
+		bond23.push_back(torsion.bond23);
+		bond34.push_back(torsion.bond34);
+		degrees.push_back(torsion.degrees);
+		halfBarrierHeight.push_back(torsion.halfBarrierHeight);
+		barrierOffset.push_back(torsion.barrierOffset);
+		barrierFrequency.push_back(torsion.barrierFrequency);
+		paths.push_back(torsion.paths);
+		colorOffsets.clear();
+
+		return GetSize() - 1;
+	}
+
+	void TorsionTable::Clear() {
+		atom1.clear();
+		atom2.clear();
+		atom3.clear();
+		atom4.clear();
+		bond12.clear();
+		bond23.clear();
+		bond34.clear();
+		degrees.clear();
+		halfBarrierHeight.clear();
+		barrierOffset.clear();
+		barrierFrequency.clear();
+		paths.clear();
+		colorOffsets.clear();
+	}
+
+	void TorsionTable::SortByFirstAtom() {
+		Reorder(GetFirstAtomOrder(atom1));
+		colorOffsets.clear();
+	}
+
+	void TorsionTable::ColorByAtoms(int natoms) {
+		Reorder(GetColorOrder({ &atom1, &atom2, &atom3, &atom4 }, natoms, colorOffsets));
+	}
+
+	void TorsionTable::Reorder(const std::vector<int> &order) {
+		Gather(atom1, order);
+		Gather(atom2, order);
+		Gather(atom3, order);
+		Gather(atom4, order);
+		Gather(bond12, order);
+		Gather(bond23, order);
+		Gather(bond34, order);
+		Gather(degrees, order);
+		Gather(halfBarrierHeight, order);
+		Gather(barrierOffset, order);
+		Gather(barrierFrequency, order);
+		Gather(paths, order);
+	}
+
+	Torsion TorsionTable::GetTerm(int n) const {
+		Torsion torsion(atom1[n], atom2[n], atom3[n], atom4[n], degrees[n], halfBarrierHeight[n], barrierOffset[n], barrierFrequency[n], paths[n]);
+		torsion.bond12 = bond12[n];
+		torsion.bond23 = bond23[n];
+		torsion.bond34 = bond34[n];
+		torsion.CalculateEnergy();
+		torsion.CalculateGradientMagnitude();
+
+		return torsion;
+	}
+
+	int OutOfPlaneTable::Add(const OutOfPlane &outOfPlane) {
+		atom1.push_back(outOfPlane.atom1);
+		atom2.push_back(outOfPlane.atom2);
+		atom3.push_back(outOfPlane.atom3);
+		atom4.push_back(outOfPlane.atom4);
+		bond31.push_back(outOfPlane.bond31);
+		bond32.push_back(outOfPlane.bond32);
+		bond34.push_back(outOfPlane.bond34);
+		degrees.push_back(outOfPlane.degrees);
+		halfBarrierHeight.push_back(outOfPlane.halfBarrierHeight);
+		colorOffsets.clear();
+
+		return GetSize() - 1;
+	}
+
+	void OutOfPlaneTable::Clear() {
+		atom1.clear();
+		atom2.clear();
+		atom3.clear();
+		atom4.clear();
+		bond31.clear();
+		bond32.clear();
+		bond34.clear();
+		degrees.clear();
+		halfBarrierHeight.clear();
+		colorOffsets.clear();
+	}
+
+	void OutOfPlaneTable::SortByFirstAtom() {
+		Reorder(GetFirstAtomOrder(atom1));
+		colorOffsets.clear();
+	}
+
+	void OutOfPlaneTable::ColorByAtoms(int natoms) {
+		Reorder(GetColorOrder({ &atom1, &atom2, &atom3, &atom4 }, natoms, colorOffsets));
+	}
+
+	void OutOfPlaneTable::Reorder(const std::vector<int> &order) {
+		Gather(atom1, order);
+		Gather(atom2, order);
+		Gather(atom3, order);
+		Gather(atom4, order);
+		Gather(bond31, order);
+		Gather(bond32, order);
+		Gather(bond34, order);
+		Gather(degrees, order);
+		Gather(halfBarrierHeight, order);
+	}
+
+	OutOfPlane OutOfPlaneTable::GetTerm(int n) const {
+		OutOfPlane outOfPlane(atom1[n], atom2[n], atom3[n], atom4[n], degrees[n], halfBarrierHeight[n]);
+		outOfPlane.bond31 = bond31[n];
+		outOfPlane.bond32 = bond32[n];
+		outOfPlane.bond34 = bond34[n];
+		outOfPlane.CalculateEnergy();
+		outOfPlane.CalculateGradientMagnitude();
+
+		return outOfPlane;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+
+#include "Angle.h"
+#include "Bond.h"
+#include "OutOfPlane.h"
+#include "Torsion.h"
+
+namespace classical {
+
+	/* Structure-of-arrays tables of the bonded terms. Every index, parameter and internal coordinate is a contiguous
+	   array with one entry per term, so the energy and gradient functions stream over them linearly. The Bond, Angle,
+	   Torsion and OutOfPlane structs are only used to add terms and as per-term views for printing and debugging. */
+	struct BondTable {
+		/* Appends a term and returns its index. */
+		int Add(const Bond &bond);
+		void Clear();
+		/* Orders the terms by their first atom, in the same order sorting the per-term objects did. */
+		void SortByFirstAtom();
+		/* Groups the terms into colors whose terms share no atom, for the parallel energy and gradient passes. Adding or
+		   sorting terms drops the coloring. */
+		void ColorByAtoms(int natoms);
+		/* Keeps only the given terms, in the given order. Drops the coloring. */
+		void Select(const std::vector<int> &terms);
+
+		/* Copy of term n with its energy and gradient magnitude evaluated. */
+		Bond GetTerm(int n) const;
+
+		inline int GetSize() const { return atom1.size(); }
+
+		std::vector<int> atom1;
+		std::vector<int> atom2;
+		std::vector<int> graphIndex;
+		std::vector<double> distance;
+		std::vector<double> equilibriumDistance;
+		std::vector<double> springConstant;
+		/* Terms colorOffsets[c] to colorOffsets[c + 1] - 1 have color c; empty while the terms are not colored. */
+		std::vector<int> colorOffsets;
+	private:
+		void Reorder(const std::vector<int> &order);
+	};
+
+	struct AngleTable {
+		int Add(const Angle &angle);
+		void Clear();
+		void SortByFirstAtom();
+		void ColorByAtoms(int natoms);
+		void Select(const std::vector<int> &terms);
+
+		Angle GetTerm(int n) const;
+
+		inline int GetSize() const { return atom1.size(); }
+
+		std::vector<int> atom1;
+		std::vector<int> atom2;
+		std::vector<int> atom3;
+		std::vector<int> bond12;
+		std::vector<int> bond23;
+		std::vector<double> degrees;
+		std::vector<double> equilibriumDegrees;
+		std::vector<double> springConstant;
+		std::vector<int> colorOffsets;
+	private:
+		void Reorder(const std::vector<int> &order);
+	};
+
+	struct TorsionTable {
+		int Add(const Torsion &torsion);
+		void Clear();
+		void SortByFirstAtom();
+		void ColorByAtoms(int natoms);
+
+		Torsion GetTerm(int n) const;
+
+		inline int GetSize() const { return atom1.size(); }
+
+		std::vector<int> atom1;
+		std::vector<int> atom2;
+		std::vector<int> atom3;
+		std::vector<int> atom4;
+		std::vector<int> bond12;
+		std::vector<int> bond23;
+		std::vector<int> bond34;
+		std::vector<double> degrees;
+		std::vector<double> halfBarrierHeight;
+		std::vector<double> barrierOffset;
+		std::vector<int> barrierFrequency;
+		std::vector<int> paths;
+		std::vector<int> colorOffsets;
+	private:
+		void Reorder(const std::vector<int> &order);
+	};
+
+	struct OutOfPlaneTable {
+		int Add(const OutOfPlane &outOfPlane);
+		void Clear();
+		void SortByFirstAtom();
+		void ColorByAtoms(int natoms);
+
+		OutOfPlane GetTerm(int n) const;
+
+		inline int GetSize() const { return atom1.size(); }
+
+		std::vector<int> atom1;
+		std::vector<int> atom2;
+		std::vector<int> atom3;
+		std::vector<int> atom4;
+		std::vector<int> bond31;
+		std::vector<int> bond32;
+		std::vector<int> bond34;
+		std::vector<double> degrees;
+		std::vector<double> halfBarrierHeight;
+		std::vector<int> colorOffsets;
+	private:
+		void Reorder(const std::vector<int> &order);
+	};
+
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "CellList.h"
+
+#include <algorithm>
+#include <math.h>
+
+namespace classical {
+
+	/* Upper bound on the number of cells per atom, so a few atoms far from the rest cannot blow up the grid. */
+	static const int s_maxCellsPerAtom = 2;
+
+	CellList::CellList()
+		: m_cutoff(0.0), m_lower() {
+		m_nCells[0] = m_nCells[1] = m_nCells[2] = 1;
+		m_cellSize[0] = m_cellSize[1] = m_cellSize[2] = 0.0;
+	}
+
+	void CellList::Build(const ParticleStore &particles, double cutoff, const PeriodicBox &box) {
+		int natoms = particles.GetSize();
+
+		m_cutoff = cutoff;
+		m_box = box;
+
+		if (box.IsPeriodic()) {
+			BuildPeriodicGrid(natoms);
+		} else {
+			BuildGrid(particles);
+		}
+
+		m_head.assign(GetNCells(), -1);
+		m_next.assign(natoms, -1);
+
+		for (int i = natoms - 1; i >= 0; i--) {
+			int cell = GetCellIndex(particles, i);
+
+			m_next[i] = m_head[cell];
+			m_head[cell] = i;
+		}
+	}
+
+	void CellList::BuildGrid(const ParticleStore &particles) {
+		int natoms = particles.GetSize();
+		double cutoff = m_cutoff;
+
+		math::Vec3 lower(INFINITY);
+		math::Vec3 upper(-INFINITY);
+
+		for (int j = 0; j < 3; j++) {
+			for (double coordinate : particles.position[j]) {
+				if (!isfinite(coordinate)) continue;
+
+				lower[j] = std::min(lower[j], (float)coordinate);
+				upper[j] = std::max(upper[j], (float)coordinate);
+			}
+		}
+
+		m_lower = lower;
+		m_nCells[0] = m_nCells[1] = m_nCells[2] = 1;
+		double cellSize = INFINITY;
+
+		if (cutoff > 0.0 && natoms > 1 && lower.x <= upper.x && lower.y <= upper.y && lower.z <= upper.z) {
+			double maxCells = (double)s_maxCellsPerAtom * natoms;
+
+			cellSize = cutoff;
+
+			for (;;) {
+				double totalCells = 1.0;
+
+				for (int j = 0; j < 3; j++) {
+					double nCells = std::max(1.0, std::min(maxCells, floor((upper[j] - lower[j]) / cellSize)));
+					m_nCells[j] = (int)nCells;
+					totalCells *= nCells;
+				}
+
+				if (totalCells <= maxCells) break;
+
+				cellSize *= 1.25;
+			}
+
+			/* Stretch the cells so the grid exactly spans the atoms; this only ever makes them larger than the cutoff. */
+			double extent = 0.0;
+
+			for (int j = 0; j < 3; j++) {
+				extent = std::max(extent, (double)(upper[j] - lower[j]) / m_nCells[j]);
+			}
+
+			cellSize = std::max(cellSize, extent);
+		}
+
+		m_cellSize[0] = m_cellSize[1] = m_cellSize[2] = cellSize;
+	}
+
+	void CellList::BuildPeriodicGrid(int natoms) {
+		m_nCells[0] = m_nCells[1] = m_nCells[2] = 1;
+
+		for (int j = 0; j < 3; j++) {
+			m_lower[j] = m_box.GetCorner(j);
+		}
+
+		if (m_cutoff > 0.0 && natoms > 1) {
+			double maxCells = (double)s_maxCellsPerAtom * natoms;
+			double cellSize = m_cutoff;
+
+			for (;;) {
+				double totalCells = 1.0;
+
+				for (int j = 0; j < 3; j++) {
+					double nCells = std::max(1.0, std::min(maxCells, floor(m_box.GetLength(j) / cellSize)));
+					m_nCells[j] = (int)nCells;
+					totalCells *= nCells;
+				}
+
+				if (totalCells <= maxCells) break;
+
+				cellSize *= 1.25;
+			}
+		}
+
+		/* The cells tile the box exactly, so each is at least the cutoff wide. */
+		for (int j = 0; j < 3; j++) {
+			m_cellSize[j] = m_box.GetLength(j) / m_nCells[j];
+		}
+	}
+
+	int CellList::GetCellIndex(const ParticleStore &particles, int i) const {
+		int index[3];
+
+		for (int j = 0; j < 3; j++) {
+			if (m_nCells[j] == 1) {
+				index[j] = 0;
+				continue;
+			}
+
+			/* Written so that a non-finite coordinate lands in the first cell instead of indexing out of range. */
+			double offset = (particles.position[j][i] - m_lower[j]) / m_cellSize[j];
+
+			/* Periodic images of an atom share its cell. */
+			if (m_box.IsPeriodic()) {
+				offset -= floor(offset / m_nCells[j]) * m_nCells[j];
+			}
+
+			index[j] = offset > 0.0 ? (int)std::min(offset, m_nCells[j] - 1.0) : 0;
+		}
+
+		return (index[0] * m_nCells[1] + index[1]) * m_nCells[2] + index[2];
+	}
+
+}
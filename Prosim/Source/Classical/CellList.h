@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+
+#include "ParticleStore.h"
+#include "PeriodicBox.h"
+
+#include "Math/PSMath.h"
+
+namespace classical {
+
+	/* Linked-cell spatial binning of atoms. Cells are at least one cutoff wide, so every pair closer than the cutoff
+	   lies either in the same cell or in one of the 26 surrounding cells. A cutoff <= 0 disables the cutoff and places
+	   every atom in a single cell, which degenerates to the plain all-pairs loop. In a periodic box the grid spans the
+	   box, the neighbor cells wrap around its faces and distances are taken between nearest images. */
+	class CellList {
+	public:
+		CellList();
+
+		void Build(const ParticleStore &particles, double cutoff, const PeriodicBox &box = PeriodicBox());
+
+		/* Calls function(i, j, r2) once for every pair i < j with squared distance r2 below the squared cutoff. */
+		template <typename Function>
+		void ForEachPair(const ParticleStore &particles, Function function) const;
+
+		/* The pairs of ForEachPair whose first cell is cell; distinct cells visit disjoint pairs, so they can be split
+		   between threads. */
+		template <typename Function>
+		void ForEachPairInCell(const ParticleStore &particles, int cell, Function function) const;
+
+		inline double GetCutoff() const { return m_cutoff; }
+		inline double GetCellSize(int j) const { return m_cellSize[j]; }
+		inline int GetNCells() const { return m_nCells[0] * m_nCells[1] * m_nCells[2]; }
+	private:
+		/* Sizes the grid to span the atoms, or in a periodic box to tile the box. */
+		void BuildGrid(const ParticleStore &particles);
+		void BuildPeriodicGrid(int natoms);
+		int GetCellIndex(const ParticleStore &particles, int i) const;
+
+		/* Whether a neighbor cell offset of -1, 0 or 1 along a periodic axis of n cells reaches a cell no smaller offset
+		   has, so that no cell pair is visited twice when there are fewer than three cells. */
+		static inline bool IsDistinctOffset(int offset, int n) { return offset == 0 || n >= 3 || (n == 2 && offset == 1); }
+	private:
+		double m_cutoff;
+		double m_cellSize[3];
+		math::Vec3 m_lower;
+		int m_nCells[3];
+		PeriodicBox m_box;
+
+		/* First atom in each cell (-1 when empty) and the next atom in the same cell (-1 at the end of a chain). */
+		std::vector<int> m_head;
+		std::vector<int> m_next;
+	};
+
+	template <typename Function>
+	void CellList::ForEachPair(const ParticleStore &particles, Function function) const {
+		int nCells = GetNCells();
+
+		for (int cell = 0; cell < nCells; cell++) {
+			ForEachPairInCell(particles, cell, function);
+		}
+	}
+
+	template <typename Function>
+	void CellList::ForEachPairInCell(const ParticleStore &particles, int cell, Function function) const {
+		double cutoff2 = m_cutoff > 0.0 ? m_cutoff * m_cutoff : INFINITY;
+		bool periodic = m_box.IsPeriodic();
+
+		const double *x = particles.position[0].data();
+		const double *y = particles.position[1].data();
+		const double *z = particles.position[2].data();
+
+		int cx = cell / (m_nCells[1] * m_nCells[2]);
+		int cy = cell / m_nCells[2] % m_nCells[1];
+		int cz = cell % m_nCells[2];
+
+		for (int dx = -1; dx <= 1; dx++) {
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dz = -1; dz <= 1; dz++) {
+					int nx = cx + dx;
+					int ny = cy + dy;
+					int nz = cz + dz;
+
+					if (periodic) {
+						if (!IsDistinctOffset(dx, m_nCells[0]) || !IsDistinctOffset(dy, m_nCells[1]) || !IsDistinctOffset(dz, m_nCells[2])) continue;
+
+						nx = (nx + m_nCells[0]) % m_nCells[0];
+						ny = (ny + m_nCells[1]) % m_nCells[1];
+						nz = (nz + m_nCells[2]) % m_nCells[2];
+					}
+					else if (nx < 0 || ny < 0 || nz < 0 || nx >= m_nCells[0] || ny >= m_nCells[1] || nz >= m_nCells[2]) continue;
+
+					int neighborCell = (nx * m_nCells[1] + ny) * m_nCells[2] + nz;
+
+					/* Visit each unordered pair of cells once. */
+					if (neighborCell < cell) continue;
+
+					for (int i = m_head[cell]; i != -1; i = m_next[i]) {
+						for (int j = (neighborCell == cell ? m_next[i] : m_head[neighborCell]); j != -1; j = m_next[j]) {
+							double a = x[i] - x[j];
+							double b = y[i] - y[j];
+							double c = z[i] - z[j];
+
+							m_box.ApplyMinimumImage(a, b, c);
+
+							double r2 = a * a + b * b + c * c;
+
+							if (r2 >= cutoff2) continue;
+
+							if (i < j) {
+								function(i, j, r2);
+							}
+							else {
+								function(j, i, r2);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+}
@@ -0,0 +1,480 @@
+#include "Constraints.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "Constants.h"
+
+namespace classical {
+
+	ConstraintType ResolveConstraintType(const String &name) {
+		if (name.find("none") != String::npos) {
+			return ConstraintType::None;
+		}
+		else if (name.find("h-bonds") != String::npos) {
+			return ConstraintType::HBonds;
+		}
+
+		std::cout << "Unknown constraint type: " << name << std::endl;
+		std::cout << "Use 'none' or 'h-bonds'" << std::endl;
+		return ConstraintType::None;
+	}
+
+	String GetConstraintTypeName(ConstraintType type) {
+		switch (type) {
+		case ConstraintType::HBonds: return "h-bonds";
+		default: return "none";
+		}
+	}
+
+	ConstraintSet::ConstraintSet()
+		: m_type(ConstraintType::None), m_tolerance(1e-8), m_maxIterations(1000) {
+
+	}
+
+	/* TIP3P geometry for waters without force field parameters. */
+	static const double s_defaultWaterDistanceOH = 0.9572;
+	static const double s_defaultWaterDegreesHOH = 104.52;
+
+	static inline double GetDp(const double *u, const double *v) {
+		return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+	}
+
+	static inline void GetCp(double *cp, const double *u, const double *v) {
+		cp[0] = u[1] * v[2] - u[2] * v[1];
+		cp[1] = u[2] * v[0] - u[0] * v[2];
+		cp[2] = u[0] * v[1] - u[1] * v[0];
+	}
+
+	static inline void Normalize(double *u) {
+		double inverseLength = 1.0 / sqrt(GetDp(u, u));
+
+		u[0] *= inverseLength;
+		u[1] *= inverseLength;
+		u[2] *= inverseLength;
+	}
+
+	void ConstraintSet::Build(ConstraintType type, bool rigidWater, const std::vector<Atom *> &atoms, const BondTable &bonds, const AngleTable &angles, const BondGraph &bondGraph, const ParticleStore &particles) {
+		Clear();
+
+		m_type = type;
+
+		if (rigidWater) {
+			FindWaters(atoms, bonds, angles, bondGraph);
+		}
+
+		if (type != ConstraintType::HBonds) return;
+
+		std::vector<bool> inWater(atoms.size(), false);
+
+		for (int n = 0; n < (int)m_waters.size(); n++) {
+			inWater[m_waters[n]] = true;
+		}
+
+		for (int n = 0; n < bonds.GetSize(); n++) {
+			int i = bonds.atom1[n];
+			int j = bonds.atom2[n];
+
+			if (atoms[i]->element != "H" && atoms[j]->element != "H") continue;
+			if (inWater[i] && inWater[j]) continue;
+
+			/* Bonds without force field parameters keep their current length. */
+			double distance = bonds.equilibriumDistance[n];
+
+			if (distance <= 0.0) {
+				double a = particles.position[0][i] - particles.position[0][j];
+				double b = particles.position[1][i] - particles.position[1][j];
+				double c = particles.position[2][i] - particles.position[2][j];
+
+				distance = sqrt(a * a + b * b + c * c);
+			}
+
+			m_atom1.push_back(i);
+			m_atom2.push_back(j);
+			m_distance.push_back(distance);
+		}
+	}
+
+	void ConstraintSet::FindWaters(const std::vector<Atom *> &atoms, const BondTable &bonds, const AngleTable &angles, const BondGraph &bondGraph) {
+		int natoms = atoms.size();
+		const std::vector<int> &offsets = bondGraph.GetOffsets();
+
+		/* Index of the water every atom belongs to, -1 for all other atoms. */
+		std::vector<int> water(natoms, -1);
+
+		for (int i = 0; i < natoms; i++) {
+			if (atoms[i]->element != "O" || bondGraph.GetDegree(i) != 2) continue;
+
+			int h1 = bondGraph.GetNeighbor(offsets[i]);
+			int h2 = bondGraph.GetNeighbor(offsets[i] + 1);
+
+			if (atoms[h1]->element != "H" || atoms[h2]->element != "H" || bondGraph.GetDegree(h1) != 1 || bondGraph.GetDegree(h2) != 1) continue;
+
+			water[i] = water[h1] = water[h2] = m_waters.size() / 3;
+
+			m_waters.push_back(i);
+			m_waters.push_back(h1);
+			m_waters.push_back(h2);
+		}
+
+		int nwaters = GetNWaters();
+
+		std::vector<double> distanceOH(nwaters, s_defaultWaterDistanceOH);
+		std::vector<double> degreesHOH(nwaters, s_defaultWaterDegreesHOH);
+
+		for (int n = 0; n < bonds.GetSize(); n++) {
+			int w = water[bonds.atom1[n]];
+
+			if (w >= 0 && bonds.equilibriumDistance[n] > 0.0) {
+				distanceOH[w] = bonds.equilibriumDistance[n];
+			}
+		}
+
+		for (int n = 0; n < angles.GetSize(); n++) {
+			int w = water[angles.atom2[n]];
+
+			if (w >= 0 && angles.equilibriumDegrees[n] > 0.0) {
+				degreesHOH[w] = angles.equilibriumDegrees[n];
+			}
+		}
+
+		for (int w = 0; w < nwaters; w++) {
+			m_waterDistanceOH.push_back(distanceOH[w]);
+			m_waterDistanceHH.push_back(2.0 * distanceOH[w] * sin(0.5 * DEGREES_TO_RADIANS * degreesHOH[w]));
+		}
+	}
+
+	void ConstraintSet::Clear() {
+		m_type = ConstraintType::None;
+		m_atom1.clear();
+		m_atom2.clear();
+		m_distance.clear();
+		m_waters.clear();
+		m_waterDistanceOH.clear();
+		m_waterDistanceHH.clear();
+
+		for (int d = 0; d < 3; d++) {
+			m_reference[d].clear();
+		}
+	}
+
+	void ConstraintSet::SetReference(const ParticleStore &particles) {
+		if (!GetNConstraints()) return;
+
+		for (int d = 0; d < 3; d++) {
+			m_reference[d] = particles.position[d];
+		}
+	}
+
+	bool ConstraintSet::ApplyPositions(ParticleStore &particles, double deltaTime) {
+		if (!GetNConstraints()) return true;
+
+		if ((int)m_reference[0].size() != particles.GetSize()) {
+			SetReference(particles);
+		}
+
+		double inverseTime = deltaTime > 0.0 ? 1.0 / deltaTime : 0.0;
+
+		if (!ApplySettlePositions(particles, inverseTime)) return false;
+
+		int nconstraints = GetNDistances();
+
+		if (!nconstraints) return true;
+
+		double *x = particles.position[0].data();
+		double *y = particles.position[1].data();
+		double *z = particles.position[2].data();
+		const double *mass = particles.mass.data();
+
+		for (int iteration = 0; iteration < m_maxIterations; iteration++) {
+			bool converged = true;
+
+			for (int n = 0; n < nconstraints; n++) {
+				int i = m_atom1[n];
+				int j = m_atom2[n];
+
+				double a = x[i] - x[j];
+				double b = y[i] - y[j];
+				double c = z[i] - z[j];
+				double distance2 = m_distance[n] * m_distance[n];
+				double difference = distance2 - (a * a + b * b + c * c);
+
+				if (fabs(difference) <= 2.0 * m_tolerance * distance2) continue;
+
+				converged = false;
+
+				double referenceA = m_reference[0][i] - m_reference[0][j];
+				double referenceB = m_reference[1][i] - m_reference[1][j];
+				double referenceC = m_reference[2][i] - m_reference[2][j];
+				double inverseMassI = 1.0 / mass[i];
+				double inverseMassJ = 1.0 / mass[j];
+
+				/* First order Lagrange multiplier of the constraint along the reference bond vector. */
+				double g = difference / (2.0 * (a * referenceA + b * referenceB + c * referenceC) * (inverseMassI + inverseMassJ));
+				double shift[3] = { g * referenceA, g * referenceB, g * referenceC };
+
+				for (int d = 0; d < 3; d++) {
+					particles.position[d][i] += shift[d] * inverseMassI;
+					particles.position[d][j] -= shift[d] * inverseMassJ;
+					particles.velocity[d][i] += shift[d] * inverseMassI * inverseTime;
+					particles.velocity[d][j] -= shift[d] * inverseMassJ * inverseTime;
+				}
+			}
+
+			if (converged) return true;
+		}
+
+		std::cout << "SHAKE did not converge in " << m_maxIterations << " iterations" << std::endl;
+		return false;
+	}
+
+	bool ConstraintSet::ApplyVelocities(ParticleStore &particles) {
+		ApplySettleVelocities(particles);
+
+		int nconstraints = GetNDistances();
+
+		if (!nconstraints) return true;
+
+		const double *x = particles.position[0].data();
+		const double *y = particles.position[1].data();
+		const double *z = particles.position[2].data();
+		const double *mass = particles.mass.data();
+
+		for (int iteration = 0; iteration < m_maxIterations; iteration++) {
+			bool converged = true;
+
+			for (int n = 0; n < nconstraints; n++) {
+				int i = m_atom1[n];
+				int j = m_atom2[n];
+
+				double r[3] = { x[i] - x[j], y[i] - y[j], z[i] - z[j] };
+				double dotProduct = 0.0;
+
+				for (int d = 0; d < 3; d++) {
+					dotProduct += r[d] * (particles.velocity[d][i] - particles.velocity[d][j]);
+				}
+
+				double distance2 = m_distance[n] * m_distance[n];
+
+				/* r . v_ij relative to d^2 is a rate of relative length change in 1 / ps. */
+				if (fabs(dotProduct) <= m_tolerance * distance2) continue;
+
+				converged = false;
+
+				double inverseMassI = 1.0 / mass[i];
+				double inverseMassJ = 1.0 / mass[j];
+				double k = dotProduct / (distance2 * (inverseMassI + inverseMassJ));
+
+				for (int d = 0; d < 3; d++) {
+					particles.velocity[d][i] -= k * r[d] * inverseMassI;
+					particles.velocity[d][j] += k * r[d] * inverseMassJ;
+				}
+			}
+
+			if (converged) return true;
+		}
+
+		std::cout << "RATTLE did not converge in " << m_maxIterations << " iterations" << std::endl;
+		return false;
+	}
+
+	/* SETTLE (Miyamoto and Kollman, J. Comput. Chem. 13, 952 (1992)): the rigid water is placed with its center of mass
+	   at that of the unconstrained positions and rotated out of the reference orientation in closed form. */
+	bool ConstraintSet::ApplySettlePositions(ParticleStore &particles, double inverseTime) {
+		int nwaters = GetNWaters();
+
+		for (int w = 0; w < nwaters; w++) {
+			int atom[3] = { m_waters[3 * w], m_waters[3 * w + 1], m_waters[3 * w + 2] };
+
+			double massO = particles.mass[atom[0]];
+			double massH = particles.mass[atom[1]];
+			double totalMass = massO + 2.0 * massH;
+
+			/* Canonical triangle with the center of mass at the origin: O at (0, ra), the hydrogens at (-+rc, -rb). */
+			double rc = 0.5 * m_waterDistanceHH[w];
+			double height = sqrt(m_waterDistanceOH[w] * m_waterDistanceOH[w] - rc * rc);
+			double ra = 2.0 * massH * height / totalMass;
+			double rb = height - ra;
+
+			/* Reference hydrogen positions and unconstrained positions, all relative to the reference oxygen. */
+			double b0[3];
+			double c0[3];
+			double a1[3];
+			double b1[3];
+			double c1[3];
+			double centerOfMass[3];
+
+			for (int d = 0; d < 3; d++) {
+				double origin = m_reference[d][atom[0]];
+
+				b0[d] = m_reference[d][atom[1]] - origin;
+				c0[d] = m_reference[d][atom[2]] - origin;
+				a1[d] = particles.position[d][atom[0]] - origin;
+				b1[d] = particles.position[d][atom[1]] - origin;
+				c1[d] = particles.position[d][atom[2]] - origin;
+				centerOfMass[d] = (massO * a1[d] + massH * (b1[d] + c1[d])) / totalMass;
+				a1[d] -= centerOfMass[d];
+				b1[d] -= centerOfMass[d];
+				c1[d] -= centerOfMass[d];
+			}
+
+			/* Frame with z normal to the reference plane and x normal to z and the new oxygen. */
+			double axisX[3];
+			double axisY[3];
+			double axisZ[3];
+			GetCp(axisZ, b0, c0);
+			GetCp(axisX, a1, axisZ);
+			GetCp(axisY, axisZ, axisX);
+			Normalize(axisX);
+			Normalize(axisY);
+			Normalize(axisZ);
+
+			double xb0 = GetDp(axisX, b0);
+			double yb0 = GetDp(axisY, b0);
+			double xc0 = GetDp(axisX, c0);
+			double yc0 = GetDp(axisY, c0);
+			double za1 = GetDp(axisZ, a1);
+			double xb1 = GetDp(axisX, b1);
+			double yb1 = GetDp(axisY, b1);
+			double zb1 = GetDp(axisZ, b1);
+			double xc1 = GetDp(axisX, c1);
+			double yc1 = GetDp(axisY, c1);
+			double zc1 = GetDp(axisZ, c1);
+
+			double sinPhi = za1 / ra;
+			double cosPhi2 = 1.0 - sinPhi * sinPhi;
+
+			if (cosPhi2 <= 0.0) {
+				std::cout << "SETTLE failed for the water of atom " << atom[0] << std::endl;
+				return false;
+			}
+
+			double cosPhi = sqrt(cosPhi2);
+			double sinPsi = (zb1 - zc1) / (2.0 * rc * cosPhi);
+			double cosPsi = sqrt(std::max(0.0, 1.0 - sinPsi * sinPsi));
+
+			double ya2 = ra * cosPhi;
+			double xb2 = -rc * cosPsi;
+			double yb2 = -rb * cosPhi - rc * sinPsi * sinPhi;
+			double yc2 = -rb * cosPhi + rc * sinPsi * sinPhi;
+
+			/* Rotation about z that takes the reference into the unconstrained orientation. */
+			double alpha = xb2 * (xb0 - xc0) + yb0 * yb2 + yc0 * yc2;
+			double beta = xb2 * (yc0 - yb0) + xb0 * yb2 + xc0 * yc2;
+			double gamma = xb0 * yb1 - xb1 * yb0 + xc0 * yc1 - xc1 * yc0;
+			double alphaBeta2 = alpha * alpha + beta * beta;
+			double sinTheta = (alpha * gamma - beta * sqrt(std::max(0.0, alphaBeta2 - gamma * gamma))) / alphaBeta2;
+			double cosTheta = sqrt(std::max(0.0, 1.0 - sinTheta * sinTheta));
+
+			double local[3][3] = {
+				{ -ya2 * sinTheta, ya2 * cosTheta, za1 },
+				{ xb2 * cosTheta - yb2 * sinTheta, xb2 * sinTheta + yb2 * cosTheta, zb1 },
+				{ -xb2 * cosTheta - yc2 * sinTheta, -xb2 * sinTheta + yc2 * cosTheta, zc1 }
+			};
+
+			for (int k = 0; k < 3; k++) {
+				int i = atom[k];
+
+				for (int d = 0; d < 3; d++) {
+					double position = m_reference[d][atom[0]] + centerOfMass[d] + axisX[d] * local[k][0] + axisY[d] * local[k][1] + axisZ[d] * local[k][2];
+
+					particles.velocity[d][i] += (position - particles.position[d][i]) * inverseTime;
+					particles.position[d][i] = position;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/* Removes the relative velocities along the three sides of every rigid water with one 3 x 3 solve for the impulses. */
+	void ConstraintSet::ApplySettleVelocities(ParticleStore &particles) {
+		int nwaters = GetNWaters();
+
+		for (int w = 0; w < nwaters; w++) {
+			int atom[3] = { m_waters[3 * w], m_waters[3 * w + 1], m_waters[3 * w + 2] };
+
+			/* Sides k = (first[k], second[k]) with unit vectors from first to second. */
+			static const int first[3] = { 0, 0, 1 };
+			static const int second[3] = { 1, 2, 2 };
+
+			double inverseMass[3];
+			double side[3][3];
+			double relativeVelocity[3];
+
+			for (int k = 0; k < 3; k++) {
+				inverseMass[k] = 1.0 / particles.mass[atom[k]];
+			}
+
+			for (int k = 0; k < 3; k++) {
+				int p = atom[first[k]];
+				int q = atom[second[k]];
+
+				for (int d = 0; d < 3; d++) {
+					side[k][d] = particles.position[d][q] - particles.position[d][p];
+				}
+
+				Normalize(side[k]);
+
+				relativeVelocity[k] = 0.0;
+
+				for (int d = 0; d < 3; d++) {
+					relativeVelocity[k] += side[k][d] * (particles.velocity[d][q] - particles.velocity[d][p]);
+				}
+			}
+
+			/* An impulse t_j along side j adds t_j e_j / m to its first atom and -t_j e_j / m to its second; matrix[k][j]
+			   is the resulting change of the relative velocity along side k. */
+			double matrix[3][3];
+
+			for (int k = 0; k < 3; k++) {
+				for (int j = 0; j < 3; j++) {
+					double coupling = 0.0;
+
+					if (second[k] == first[j]) coupling += inverseMass[second[k]];
+					if (second[k] == second[j]) coupling -= inverseMass[second[k]];
+					if (first[k] == first[j]) coupling -= inverseMass[first[k]];
+					if (first[k] == second[j]) coupling += inverseMass[first[k]];
+
+					matrix[k][j] = coupling * GetDp(side[k], side[j]);
+				}
+			}
+
+			/* Cramer's rule for matrix t = -relativeVelocity. */
+			double cofactor[3];
+			GetCp(cofactor, matrix[1], matrix[2]);
+
+			double determinant = GetDp(matrix[0], cofactor);
+
+			if (!determinant) continue;
+
+			double impulse[3];
+
+			for (int j = 0; j < 3; j++) {
+				double replaced[3][3];
+
+				for (int k = 0; k < 3; k++) {
+					for (int l = 0; l < 3; l++) {
+						replaced[k][l] = l == j ? -relativeVelocity[k] : matrix[k][l];
+					}
+				}
+
+				GetCp(cofactor, replaced[1], replaced[2]);
+				impulse[j] = GetDp(replaced[0], cofactor) / determinant;
+			}
+
+			for (int j = 0; j < 3; j++) {
+				int p = first[j];
+				int q = second[j];
+
+				for (int d = 0; d < 3; d++) {
+					particles.velocity[d][atom[p]] += impulse[j] * side[j][d] * inverseMass[p];
+					particles.velocity[d][atom[q]] -= impulse[j] * side[j][d] * inverseMass[q];
+				}
+			}
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include "Atom.h"
+#include "BondGraph.h"
+#include "BondedTables.h"
+#include "ParticleStore.h"
+
+namespace classical {
+
+	/* Which distances are held fixed during molecular dynamics. HBonds constrains every bond to a hydrogen to its
+	   equilibrium length. */
+	enum class ConstraintType {
+		None,
+		HBonds
+	};
+
+	/* Maps "none" or "h-bonds" to a constraint type; anything else is reported and falls back to none. */
+	ConstraintType ResolveConstraintType(const String &name);
+	String GetConstraintTypeName(ConstraintType type);
+
+	/* Fixed interatomic distances. Positions are moved onto the constraints with SHAKE and velocities are made
+	   tangential to them with RATTLE; both iterate until every constraint holds to the relative tolerance. Rigid
+	   waters are instead solved in closed form with SETTLE, for positions and velocities alike. */
+	class ConstraintSet {
+	public:
+		ConstraintSet();
+
+		/* With rigidWater, every oxygen bonded to exactly two hydrogens and nothing else becomes a rigid water with the
+		   equilibrium O-H length and H-O-H angle of its bonded terms, and is left out of the distance constraints. */
+		void Build(ConstraintType type, bool rigidWater, const std::vector<Atom *> &atoms, const BondTable &bonds, const AngleTable &angles, const BondGraph &bondGraph, const ParticleStore &particles);
+		void Clear();
+
+		/* Copies the positions that the next ApplyPositions corrects along, normally those before the unconstrained drift. */
+		void SetReference(const ParticleStore &particles);
+		/* SHAKE: moves the positions onto the constraints along the reference bond vectors. With deltaTime > 0 the
+		   displacements divided by deltaTime are added to the velocities, which keeps v consistent with the drift. */
+		bool ApplyPositions(ParticleStore &particles, double deltaTime);
+		/* RATTLE: removes the velocity components along the constraints. */
+		bool ApplyVelocities(ParticleStore &particles);
+
+		/* Number of removed degrees of freedom: one per distance and three per rigid water. */
+		inline int GetNConstraints() const { return m_atom1.size() + 3 * GetNWaters(); }
+		inline int GetNDistances() const { return m_atom1.size(); }
+		inline int GetNWaters() const { return m_waters.size() / 3; }
+		/* Flattened (oxygen, hydrogen, hydrogen) triples of the rigid waters. */
+		inline const std::vector<int> &GetWaters() const { return m_waters; }
+		inline ConstraintType GetType() const { return m_type; }
+		inline double GetTolerance() const { return m_tolerance; }
+		inline void SetTolerance(double tolerance) { m_tolerance = tolerance; }
+		inline int GetMaxIterations() const { return m_maxIterations; }
+		inline void SetMaxIterations(int maxIterations) { m_maxIterations = maxIterations; }
+	private:
+		void FindWaters(const std::vector<Atom *> &atoms, const BondTable &bonds, const AngleTable &angles, const BondGraph &bondGraph);
+		bool ApplySettlePositions(ParticleStore &particles, double inverseTime);
+		void ApplySettleVelocities(ParticleStore &particles);
+	private:
+		ConstraintType m_type;
+		double m_tolerance;
+		int m_maxIterations;
+
+		std::vector<int> m_atom1;
+		std::vector<int> m_atom2;
+		std::vector<double> m_distance;
+		std::vector<int> m_waters;
+		std::vector<double> m_waterDistanceOH;
+		std::vector<double> m_waterDistanceHH;
+		std::vector<double> m_reference[3];
+	};
+
+}
\ No newline at end of file
@@ -5,6 +5,7 @@
 
 #include "Constants.h"
 #include "Geometry.h"
+#include "Topology.h"
 
 #include "Utils/IterationTools.h"
 
@@ -81,13 +82,14 @@ namespace classical {
 	NonBondedEnergyGPUCalculator::~NonBondedEnergyGPUCalculator() {
 		clReleaseKernel(kernel); //Release kernel.
 		clReleaseProgram(program); //Release the program object.
-		clReleaseMemObject(kCombinationMatrixMem); //Release mem object.
-		clReleaseMemObject(kNonIntsMem);
-		clReleaseMemObject(kNonIntsSizeMem);
+		clReleaseMemObject(kNAtomsMem); //Release mem object.
+		clReleaseMemObject(kExclusionOffsetsMem);
+		clReleaseMemObject(kExclusionPartnersMem);
 		clReleaseMemObject(kPositionsMem);
 		clReleaseMemObject(kChargesMem);
-		clReleaseMemObject(kVdwRadiiMem);
-		clReleaseMemObject(kVdwAttractionMagnitudesMem);
+		clReleaseMemObject(kTypeIdsMem);
+		clReleaseMemObject(kVdwPairsMem);
+		clReleaseMemObject(kNTypesMem);
 		clReleaseMemObject(kDielectricMem);
 		clReleaseMemObject(kCeuToKCalMem);
 		clReleaseMemObject(keElstMem);
@@ -96,46 +98,54 @@ namespace classical {
 		clReleaseContext(context); //Release context.
 	}
 
-	math::Vec2 NonBondedEnergyGPUCalculator::GetENonBonded(const std::vector<Atom *> &atoms, std::vector<int> &nonInts, double dielectric) {
+	math::Vec2 NonBondedEnergyGPUCalculator::GetENonBonded(const ParticleStore &particles, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale) {
 		float eVDW = 0.0;
 		float eElst = 0.0;
 
-		int natoms = atoms.size();
+		int natoms = particles.GetSize();
 
-		utils::IterationMatrix matrix(utils::CombinationsNR(natoms, 2), 2);
+		/* The kernel recovers (i, j) from its global id, so no pair index table is built or uploaded. */
+		long long npairs = utils::CombinationsNR(natoms, 2);
 
-		utils::CombinationKN(matrix, 2, natoms);
-
-		int kNonIntsSize = nonInts.size();
+		/* The kernel skips every excluded pair, 1-4 pairs included; the scaled 1-4 terms are added on the host. */
+		std::vector<int> kExclusionPartners = exclusions.GetPartners();
+		kExclusionPartners.push_back(-1);
 
 		std::vector<math::Vec3> kPositions;
 		std::vector<float> kCharges;
-		std::vector<float> kVdwRadii;
-		std::vector<float> kVdwAttractionMagnitudes;
 
 		for (int n = 0; n < natoms; n++) {
-			kPositions.push_back(atoms[n]->position);
-			kCharges.push_back((float)atoms[n]->charge);
-			kVdwRadii.push_back((float)atoms[n]->vdwRadius);
-			kVdwAttractionMagnitudes.push_back((float)atoms[n]->vdwAttractionMagnitude);
+			kPositions.push_back(particles.GetPosition(n));
+			kCharges.push_back((float)particles.charge[n]);
+		}
+
+		/* The type pair table of the CPU passes, nbfix overrides included, so energy and gradient agree. */
+		int nTypes = particles.GetNTypes();
+		std::vector<float> kVdwPairs;
+
+		for (const VanDerWaalsPair &vdwPair : particles.vdwPairTable) {
+			kVdwPairs.push_back((float)vdwPair.radius);
+			kVdwPairs.push_back((float)vdwPair.attractionMagnitude);
 		}
 
 		float kCeuToKCal = CEU_TO_KCAL;
 
-		kCombinationMatrixMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-			(matrix.GetDataWritable().size()) * sizeof(int), (void *)&matrix.GetDataWritable()[0], NULL);
-		kNonIntsMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-			(nonInts.size()) * sizeof(int), (void *)&nonInts[0], NULL);
-		kNonIntsSizeMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-			(sizeof(int)), &kNonIntsSize, NULL);
+		kNAtomsMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			(sizeof(int)), &natoms, NULL);
+		kExclusionOffsetsMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			(exclusions.GetOffsets().size()) * sizeof(int), (void *)&exclusions.GetOffsets()[0], NULL);
+		kExclusionPartnersMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			(kExclusionPartners.size()) * sizeof(int), (void *)&kExclusionPartners[0], NULL);
 		kPositionsMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
 			(natoms * sizeof(math::Vec3)), &kPositions[0], NULL);
 		kChargesMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
 			(natoms * sizeof(float)), &kCharges[0], NULL);
-		kVdwRadiiMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-			(natoms * sizeof(float)), &kVdwRadii[0], NULL);
-		kVdwAttractionMagnitudesMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-			(natoms * sizeof(float)), &kVdwAttractionMagnitudes[0], NULL);
+		kTypeIdsMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			(natoms * sizeof(int)), (void *)&particles.typeId[0], NULL);
+		kVdwPairsMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			(kVdwPairs.size() * sizeof(float)), &kVdwPairs[0], NULL);
+		kNTypesMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			(sizeof(int)), &nTypes, NULL);
 		kDielectricMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
 			(sizeof(float)), &dielectric, NULL);
 		kCeuToKCalMem = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
@@ -145,19 +155,20 @@ namespace classical {
 		keElstMem = clCreateBuffer(context, CL_MEM_READ_WRITE,
 			sizeof(float), NULL, NULL);
 
-		clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&kCombinationMatrixMem);
-		clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&kNonIntsMem);
-		clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&kNonIntsSizeMem);
+		clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&kNAtomsMem);
+		clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&kExclusionOffsetsMem);
+		clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&kExclusionPartnersMem);
 		clSetKernelArg(kernel, 3, sizeof(cl_mem), (void *)&kPositionsMem);
 		clSetKernelArg(kernel, 4, sizeof(cl_mem), (void *)&kChargesMem);
-		clSetKernelArg(kernel, 5, sizeof(cl_mem), (void *)&kVdwRadiiMem);
-		clSetKernelArg(kernel, 6, sizeof(cl_mem), (void *)&kVdwAttractionMagnitudesMem);
-		clSetKernelArg(kernel, 7, sizeof(cl_mem), (void *)&kDielectricMem);
-		clSetKernelArg(kernel, 8, sizeof(cl_mem), (void *)&kCeuToKCalMem);
-		clSetKernelArg(kernel, 9, sizeof(cl_mem), (void *)&keVDWMem);
-		clSetKernelArg(kernel, 10, sizeof(cl_mem), (void *)&keElstMem);
-
-		size_t global_work_size[1] = { matrix.GetRows() / 2 };
+		clSetKernelArg(kernel, 5, sizeof(cl_mem), (void *)&kTypeIdsMem);
+		clSetKernelArg(kernel, 6, sizeof(cl_mem), (void *)&kVdwPairsMem);
+		clSetKernelArg(kernel, 7, sizeof(cl_mem), (void *)&kNTypesMem);
+		clSetKernelArg(kernel, 8, sizeof(cl_mem), (void *)&kDielectricMem);
+		clSetKernelArg(kernel, 9, sizeof(cl_mem), (void *)&kCeuToKCalMem);
+		clSetKernelArg(kernel, 10, sizeof(cl_mem), (void *)&keVDWMem);
+		clSetKernelArg(kernel, 11, sizeof(cl_mem), (void *)&keElstMem);
+
+		size_t global_work_size[1] = { (size_t)npairs };
 		clEnqueueNDRangeKernel(commandQueue, kernel, 1, NULL,
 			global_work_size, NULL, 0, NULL, NULL);
 
@@ -166,7 +177,9 @@ namespace classical {
 		clEnqueueReadBuffer(commandQueue, keElstMem, CL_TRUE, 0,
 			sizeof(float), &eElst, 0, NULL, NULL);
 
-		return math::Vec2(eVDW, eElst);
+		math::Vec2 nonBonded14Energy = GetENonBonded14(particles, exclusions, dielectric, vdw14Scale, elst14Scale);
+
+		return math::Vec2(eVDW + nonBonded14Energy.x, eElst + nonBonded14Energy.y);
 	}
 
 	double GetEBond(double rij, double req, double kb) {
@@ -186,8 +199,9 @@ namespace classical {
 	}
 
 	double GetEVDWIJ(double rij, double epsij, double roij) {
-		double r6ij = pow((roij / rij), 6);
-		return epsij * (pow(r6ij, 2) - 2.0 * r6ij);
+		double r2ij = (roij / rij) * (roij / rij);
+		double r6ij = r2ij * r2ij * r2ij;
+		return epsij * (r6ij * r6ij - 2.0 * r6ij);
 	}
 
 	double GetEElstIJ(double rij, double qi, double qj, double epsilon) {
@@ -219,124 +233,132 @@ namespace classical {
 		return 0.5 * KINETIC_TO_KCAL * eKinI;
 	}
 
-	double GetEBonds(const std::vector<Bond *> &bonds) {
+	double GetEBonds(const BondTable &bonds) {
 		double eBonds = 0.0;
+		int nbonds = bonds.GetSize();
 
-		for (Bond *bond : bonds) {
-			bond->CalculateEnergy();
-			eBonds += bond->energy;
+		for (int n = 0; n < nbonds; n++) {
+			eBonds += GetEBond(bonds.distance[n], bonds.equilibriumDistance[n], bonds.springConstant[n]);
 		}
 
 		return eBonds;
 	}
 
-	double GetEAngles(const std::vector<Angle *> &angles) {
+	double GetEAngles(const AngleTable &angles) {
 		double eAngles = 0.0;
+		int nangles = angles.GetSize();
 
-		for (Angle *angle : angles) {
-			angle->CalculateEnergy();
-			eAngles += angle->energy;
+		for (int n = 0; n < nangles; n++) {
+			eAngles += GetEAngle(angles.degrees[n], angles.equilibriumDegrees[n], angles.springConstant[n]);
 		}
 
 		return eAngles;
 	}
 
-	double GetETorsions(const std::vector<Torsion *> &torsions) {
+	double GetETorsions(const TorsionTable &torsions) {
 		double eTorsions = 0.0;
+		int ntorsions = torsions.GetSize();
 
-		for (Torsion *torsion : torsions) {
-			torsion->CalculateEnergy();
-			eTorsions += torsion->energy;
+		for (int n = 0; n < ntorsions; n++) {
+			eTorsions += GetETorsion(torsions.degrees[n], torsions.halfBarrierHeight[n], torsions.barrierOffset[n], torsions.barrierFrequency[n], torsions.paths[n]);
 		}
 
 		return eTorsions;
 	}
 
-	double GetEOutOfPlanes(const std::vector<OutOfPlane *> &outOfPlanes) {
+	double GetEOutOfPlanes(const OutOfPlaneTable &outOfPlanes) {
 		double eOutOfPlanes = 0.0;
+		int noutOfPlanes = outOfPlanes.GetSize();
 
-		for (OutOfPlane *outOfPlane : outOfPlanes) {
-			outOfPlane->CalculateEnergy();
-			eOutOfPlanes += outOfPlane->energy;
+		for (int n = 0; n < noutOfPlanes; n++) {
+			eOutOfPlanes += GetEOutOfPlane(outOfPlanes.degrees[n], outOfPlanes.halfBarrierHeight[n]);
 		}
 
 		return eOutOfPlanes;
 	}
 
-	math::Vec2 GetENonBonded(const std::vector<Atom *> &atoms, std::vector<int> &nonInts, double dielectric) {
-		float eVDW = 0.0;
-		float eElst = 0.0;
+	math::Vec2 GetENonBonded(const ParticleStore &particles, const NeighborList &neighborList, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale) {
+		double eVDW = 0.0;
+		double eElst = 0.0;
 
-		int natoms = atoms.size();
+		const double *charge = particles.charge.data();
 
-		utils::IterationMatrix matrix(utils::CombinationsNR(natoms, 2), 2);
+		neighborList.ForEachPair(particles, [&](int i, int j, double r2) {
+			if (exclusions.IsExcluded(i, j)) return;
 
-		utils::CombinationKN(matrix, 2, natoms);
+			double distance = sqrt(r2);
+			const VanDerWaalsPair &vdwPair = particles.GetVanDerWaalsPair(i, j);
+			eElst += GetEElstIJ(distance, charge[i], charge[j], dielectric);
+			eVDW += GetEVDWIJ(distance, vdwPair.attractionMagnitude, vdwPair.radius);
+		});
 
-#ifdef PS_OPTIMIZED
-#pragma omp parallel for
-#endif
-		for (int n = 0; n < utils::CombinationsNR(natoms, 2); n++) {
-			int i = matrix(n, 0);
-			int j = matrix(n, 1);
+		math::Vec2 nonBonded14Energy = GetENonBonded14(particles, exclusions, dielectric, vdw14Scale, elst14Scale);
 
-			for (int k = 0; k < nonInts.size(); k += 2) {
-				if (nonInts[k] == i && nonInts[k + 1] == j) {
-					continue;
-				}
-			}
+		return math::Vec2(eVDW + nonBonded14Energy.x, eElst + nonBonded14Energy.y);
+	}
+
+	math::Vec2 GetENonBonded14(const ParticleStore &particles, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale) {
+		double eVDW = 0.0;
+		double eElst = 0.0;
+
+		/* 1-4 pairs are always evaluated, independent of the cutoff. */
+		const std::vector<int> &pairs14 = exclusions.GetPairs14();
 
-			Atom *atom1 = atoms[i];
-			Atom *atom2 = atoms[j];
+		for (int n = 0; n < (int)pairs14.size(); n += 2) {
+			int i = pairs14[n];
+			int j = pairs14[n + 1];
 
-			double distance = GetRij(atom1->position, atom2->position);
-			double vdwAttractionMagnitudeIJ = sqrt(atom1->vdwAttractionMagnitude) * sqrt(atom2->vdwAttractionMagnitude);
-			double vdwRadiusIJ = atom1->vdwRadius + atom2->vdwRadius;
-			eElst += GetEElstIJ(distance, atom1->charge, atom2->charge, dielectric);
-			eVDW += GetEVDWIJ(distance, vdwAttractionMagnitudeIJ, vdwRadiusIJ);
+			double a = particles.position[0][i] - particles.position[0][j];
+			double b = particles.position[1][i] - particles.position[1][j];
+			double c = particles.position[2][i] - particles.position[2][j];
+
+			double distance = sqrt(a * a + b * b + c * c);
+			const VanDerWaalsPair &vdwPair = particles.GetVanDerWaalsPair(i, j);
+			eElst += elst14Scale * GetEElstIJ(distance, particles.charge[i], particles.charge[j], dielectric);
+			eVDW += vdw14Scale * GetEVDWIJ(distance, vdwPair.attractionMagnitude, vdwPair.radius);
 		}
 
 		return math::Vec2(eVDW, eElst);
 	}
 
-	double GetEBound(const std::vector<Atom *> &atoms, double kBox, double boundary, const math::Vec3 &origin, const String &boundType) {
+	double GetEBound(const ParticleStore &particles, double kBox, double boundary, const math::Vec3 &origin, const String &boundType) {
 		double eBound = 0.0;
 
-		for (Atom *atom : atoms) {
-			eBound += GetEBoundI(kBox, boundary, atom->position, origin, boundType);
+		for (int i = 0; i < particles.GetSize(); i++) {
+			eBound += GetEBoundI(kBox, boundary, particles.GetPosition(i), origin, boundType);
 		}
 
 		return eBound;
 	}
 
-	double GetEKinetic(const std::vector<Atom *> &atoms, const String &kineticType) {
+	double GetEKinetic(const ParticleStore &particles, const String &kineticType) {
 		if (kineticType == "noKinetic") {
 			return 0.0;
 		}
 
 		double eKinetic = 0.0;
 		if (kineticType == "leapfrog") {
-			for (Atom *atom : atoms) {
-				math::Vec3 velocity(atom->velocity.x + atom->previousVelocity.x, 
-					atom->velocity.y + atom->previousVelocity.y,
-					atom->velocity.z + atom->previousVelocity.z);
-
-				velocity.Multiply(0.5);
+			for (int j = 0; j < 3; j++) {
+				for (int i = 0; i < particles.GetSize(); i++) {
+					double velocity = 0.5 * (particles.velocity[j][i] + particles.previousVelocity[j][i]);
 
-				eKinetic += GetEKineticI(atom->mass, velocity);
+					eKinetic += particles.mass[i] * velocity * velocity;
+				}
 			}
 		}
 		else {
-			for (Atom *atom : atoms) {
-				eKinetic += GetEKineticI(atom->mass, atom->velocity);
+			for (int j = 0; j < 3; j++) {
+				for (int i = 0; i < particles.GetSize(); i++) {
+					eKinetic += particles.mass[i] * particles.velocity[j][i] * particles.velocity[j][i];
+				}
 			}
 		}
 
-		return eKinetic;
+		return 0.5 * KINETIC_TO_KCAL * eKinetic;
 	}
 
-	double GetTemperature(double eKinetic, int natoms) {
-		return (2.0 / 3.0) * eKinetic / (BOLTZMANN_CONSTANT * natoms);
+	double GetTemperature(double eKinetic, int degreesOfFreedom) {
+		return 2.0 * eKinetic / (BOLTZMANN_CONSTANT * degreesOfFreedom);
 	}
 
 }
\ No newline at end of file
@@ -2,11 +2,10 @@
 
 #include <CL/cl.h>
 
-#include "Angle.h"
-#include "Atom.h"
-#include "Bond.h"
-#include "OutOfPlane.h"
-#include "Torsion.h"
+#include "BondedTables.h"
+#include "ExclusionTable.h"
+#include "NeighborList.h"
+#include "ParticleStore.h"
 
 #include "Math/PSMath.h"
 #include "Utils/String.h"
@@ -18,17 +17,18 @@ namespace classical {
 		NonBondedEnergyGPUCalculator();
 		~NonBondedEnergyGPUCalculator();
 
-		math::Vec2 GetENonBonded(const std::vector<Atom *> &atoms, std::vector<int> &nonInts, double dielectric);
+		math::Vec2 GetENonBonded(const ParticleStore &particles, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale);
 	private:
 		cl_kernel kernel;
 		cl_program program;
-		cl_mem kCombinationMatrixMem;
-		cl_mem kNonIntsMem;
-		cl_mem kNonIntsSizeMem;
+		cl_mem kNAtomsMem;
+		cl_mem kExclusionOffsetsMem;
+		cl_mem kExclusionPartnersMem;
 		cl_mem kPositionsMem;
 		cl_mem kChargesMem;
-		cl_mem kVdwRadiiMem;
-		cl_mem kVdwAttractionMagnitudesMem;
+		cl_mem kTypeIdsMem;
+		cl_mem kVdwPairsMem;
+		cl_mem kNTypesMem;
 		cl_mem kDielectricMem;
 		cl_mem kCeuToKCalMem;
 		cl_mem keVDWMem;
@@ -45,13 +45,15 @@ namespace classical {
 	double GetEElstIJ(double rij, double qi, double qj, double epsilon);
 	double GetEBoundI(double kBox, double bound, const math::Vec3 &position, const math::Vec3 &origin, const String &boundType);
 	double GetEKineticI(double mass, const math::Vec3 &velocity);
-	double GetEBonds(const std::vector<Bond *> &bonds);
-	double GetEAngles(const std::vector<Angle *> &angles);
-	double GetETorsions(const std::vector<Torsion *> &torsions);
-	double GetEOutOfPlanes(const std::vector<OutOfPlane *> &outOfPlanes);
-	math::Vec2 GetENonBonded(const std::vector<Atom *> &atoms, std::vector<int> &nonInts, double dielectric);
-	double GetEBound(const std::vector<Atom *> &atoms, double kBox, double boundary, const math::Vec3 &origin, const String &boundType);
-	double GetEKinetic(const std::vector<Atom *> &atoms, const String &kineticType = "none");
-	double GetTemperature(double eKinetic, int natoms);
+	double GetEBonds(const BondTable &bonds);
+	double GetEAngles(const AngleTable &angles);
+	double GetETorsions(const TorsionTable &torsions);
+	double GetEOutOfPlanes(const OutOfPlaneTable &outOfPlanes);
+	math::Vec2 GetENonBonded(const ParticleStore &particles, const NeighborList &neighborList, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale);
+	math::Vec2 GetENonBonded14(const ParticleStore &particles, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale);
+	double GetEBound(const ParticleStore &particles, double kBox, double boundary, const math::Vec3 &origin, const String &boundType);
+	double GetEKinetic(const ParticleStore &particles, const String &kineticType = "none");
+	/* Temperature of a kinetic energy shared by degreesOfFreedom quadratic terms, 3 per atom less one per constraint. */
+	double GetTemperature(double eKinetic, int degreesOfFreedom);
 
 }
\ No newline at end of file
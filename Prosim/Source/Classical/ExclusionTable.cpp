@@ -0,0 +1,103 @@
+#include "ExclusionTable.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace classical {
+
+	ExclusionTable::ExclusionTable()
+		: m_nAtoms(0), m_offsets(1, 0), m_lowerOffsets(1, 0) {
+
+	}
+
+	void ExclusionTable::Build(int natoms, const std::vector<int> &excludedPairs, const std::vector<int> &pairs14) {
+		/* (i, j, is14) with i < j; sorting puts the excluded entry of a pair ahead of its 1-4 entry. */
+		std::vector<std::tuple<int, int, char>> entries;
+
+		for (int k = 0; k + 1 < (int)excludedPairs.size(); k += 2) {
+			int i = excludedPairs[k];
+			int j = excludedPairs[k + 1];
+
+			if (i != j) entries.push_back(std::make_tuple(std::min(i, j), std::max(i, j), 0));
+		}
+
+		for (int k = 0; k + 1 < (int)pairs14.size(); k += 2) {
+			int i = pairs14[k];
+			int j = pairs14[k + 1];
+
+			if (i != j) entries.push_back(std::make_tuple(std::min(i, j), std::max(i, j), 1));
+		}
+
+		std::sort(entries.begin(), entries.end());
+
+		m_nAtoms = natoms;
+		m_offsets.assign(natoms + 1, 0);
+		m_partners.clear();
+		m_is14.clear();
+		m_pairs14.clear();
+
+		for (int n = 0; n < (int)entries.size(); n++) {
+			int i = std::get<0>(entries[n]);
+			int j = std::get<1>(entries[n]);
+			char is14 = std::get<2>(entries[n]);
+
+			if (n > 0 && std::get<0>(entries[n - 1]) == i && std::get<1>(entries[n - 1]) == j) continue;
+
+			m_offsets[i + 1]++;
+			m_partners.push_back(j);
+			m_is14.push_back(is14);
+
+			if (is14) {
+				m_pairs14.push_back(i);
+				m_pairs14.push_back(j);
+			}
+		}
+
+		for (int i = 0; i < natoms; i++) {
+			m_offsets[i + 1] += m_offsets[i];
+		}
+
+		/* Transpose; walking i in ascending order keeps every lower row sorted. */
+		m_lowerOffsets.assign(natoms + 1, 0);
+		m_lowerPartners.resize(m_partners.size());
+
+		for (int j : m_partners) {
+			m_lowerOffsets[j + 1]++;
+		}
+
+		for (int i = 0; i < natoms; i++) {
+			m_lowerOffsets[i + 1] += m_lowerOffsets[i];
+		}
+
+		std::vector<int> fill(m_lowerOffsets.begin(), m_lowerOffsets.end() - 1);
+
+		for (int i = 0; i < natoms; i++) {
+			for (int n = m_offsets[i]; n < m_offsets[i + 1]; n++) {
+				m_lowerPartners[fill[m_partners[n]]++] = i;
+			}
+		}
+	}
+
+	bool ExclusionTable::IsExcluded(int i, int j) const {
+		return Find(i, j) != -1;
+	}
+
+	bool ExclusionTable::Is14(int i, int j) const {
+		int n = Find(i, j);
+
+		return n != -1 && m_is14[n];
+	}
+
+	int ExclusionTable::Find(int i, int j) const {
+		if (i > j) std::swap(i, j);
+
+		if (i < 0 || i >= m_nAtoms) return -1;
+
+		std::vector<int>::const_iterator begin = m_partners.begin() + m_offsets[i];
+		std::vector<int>::const_iterator end = m_partners.begin() + m_offsets[i + 1];
+		std::vector<int>::const_iterator it = std::lower_bound(begin, end, j);
+
+		return (it != end && *it == j) ? (int)(it - m_partners.begin()) : -1;
+	}
+
+}
\ No newline at end of file
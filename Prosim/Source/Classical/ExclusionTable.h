@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+namespace classical {
+
+	/* Per-atom sorted exclusion lists in compressed sparse row form, built once from the topology. Only partners j > i
+	   are stored, so a lookup is a search through the handful of atoms within three bonds of i, independent of the
+	   system size. 1-2 and 1-3 pairs are excluded outright; 1-4 pairs are also kept out of the pair loop but listed
+	   separately so they can be evaluated with scaled parameters. */
+	class ExclusionTable {
+	public:
+		ExclusionTable();
+
+		/* Both vectors hold flattened (i, j) pairs in any order; duplicates are merged and a pair that is both 1-3 and
+		   1-4 (as in small rings) is excluded. */
+		void Build(int natoms, const std::vector<int> &excludedPairs, const std::vector<int> &pairs14);
+
+		/* True for every 1-2, 1-3 and 1-4 pair, i.e. every pair the non-bonded pair loop has to skip. */
+		bool IsExcluded(int i, int j) const;
+		bool Is14(int i, int j) const;
+
+		inline int GetNAtoms() const { return m_nAtoms; }
+		inline int GetNExclusions() const { return m_partners.size(); }
+		inline int GetNPairs14() const { return m_pairs14.size() / 2; }
+
+		/* Partners j > i of atom i are GetPartners()[GetOffsets()[i]] ... GetPartners()[GetOffsets()[i + 1] - 1]. */
+		inline const std::vector<int> &GetOffsets() const { return m_offsets; }
+		inline const std::vector<int> &GetPartners() const { return m_partners; }
+		/* The same exclusions seen from the other atom: partners j < i of atom i, ascending. */
+		inline const std::vector<int> &GetLowerOffsets() const { return m_lowerOffsets; }
+		inline const std::vector<int> &GetLowerPartners() const { return m_lowerPartners; }
+		/* Flattened (i, j) 1-4 pairs with i < j. */
+		inline const std::vector<int> &GetPairs14() const { return m_pairs14; }
+	private:
+		int Find(int i, int j) const;
+	private:
+		int m_nAtoms;
+
+		std::vector<int> m_offsets;
+		std::vector<int> m_partners;
+		std::vector<int> m_lowerOffsets;
+		std::vector<int> m_lowerPartners;
+		std::vector<char> m_is14;
+		std::vector<int> m_pairs14;
+	};
+
+}
\ No newline at end of file
@@ -2,14 +2,14 @@
 
 namespace classical {
 
-	String GetCoordsXYZString(const std::vector<Atom *> &atoms, const String &comment, int totalChars, int decimalChars) {
+	String GetCoordsXYZString(const std::vector<Atom *> &atoms, const std::vector<double> *positions, const String &comment, int totalChars, int decimalChars) {
 		String string = utils::StringWithFormat("%i\n%s\n", atoms.size(), comment.c_str());
 
-		for (Atom *atom : atoms) {
-			string.append(utils::StringWithFormat("%-2s", atom->element.c_str()));
+		for (int i = 0; i < (int)atoms.size(); i++) {
+			string.append(utils::StringWithFormat("%-2s", atoms[i]->element.c_str()));
 
 			for (int j = 0; j < 3; j++) {
-				string.append(utils::StringWithFormat(" %*.*f", totalChars, decimalChars, atom->position[j]));
+				string.append(utils::StringWithFormat(" %*.*f", totalChars, decimalChars, positions[j][i]));
 			}
 
 			string.append("\n");
@@ -8,6 +8,7 @@
 
 namespace classical {
 
-	String GetCoordsXYZString(const std::vector<Atom *> &atoms, const String &comment, int totalChars = 12, int decimalChars = 6);
+	/* positions holds the x, y and z components of every atom, as in ParticleStore. */
+	String GetCoordsXYZString(const std::vector<Atom *> &atoms, const std::vector<double> *positions, const String &comment, int totalChars = 12, int decimalChars = 6);
 
 }
\ No newline at end of file
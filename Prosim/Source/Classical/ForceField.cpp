@@ -1,5 +1,7 @@
 #include "ForceField.h"
 
+#include <math.h>
+
 #include <algorithm>
 #include <fstream>
 #include <sstream>
@@ -532,8 +534,27 @@ namespace classical {
 		{ {"NB", "CW", "CC", "CT"}, 1.1 }
 	};
 
+	VanDerWaalsPair::VanDerWaalsPair()
+		: attractionMagnitude(0.0), radius(0.0), c12(0.0), c6(0.0) {
+
+	}
+
+	VanDerWaalsPair::VanDerWaalsPair(double radius, double attractionMagnitude)
+		: attractionMagnitude(attractionMagnitude), radius(radius) {
+
+		double radius6 = radius * radius * radius * radius * radius * radius;
+
+		c12 = attractionMagnitude * radius6 * radius6;
+		c6 = 2.0 * attractionMagnitude * radius6;
+	}
+
+	VanDerWaalsPair CombineVanDerWaalsParameters(double radius1, double attractionMagnitude1, double radius2, double attractionMagnitude2) {
+		return VanDerWaalsPair(radius1 + radius2, sqrt(attractionMagnitude1) * sqrt(attractionMagnitude2));
+	}
+
 	ForceField::ForceField() {
 		SetDefaultParameters();
+		CompileParameters();
 	}
 
 	ForceField::ForceField(const String &filePath) {
@@ -558,8 +579,9 @@ namespace classical {
 			std::cout << "Could not open force field file " << filePath << std::endl;
 			std::cout << "Ignoring force field file and setting default force field parameters" << std::endl;
 			SetDefaultParameters();
-			return;
 		}
+
+		CompileParameters();
 	}
 
 	std::ostream& operator<<(std::ostream &stream, const ForceField &forceField) {
@@ -589,6 +611,14 @@ namespace classical {
 
 		stream << "\t]" << std::endl;
 
+		stream << "\tVan Der Waals pair parameters: [" << std::endl;
+
+		for (const auto& elem : forceField.m_vanDerWaalsPairParameters) {
+			stream << "\t\t(" << elem.first.first << ", " << elem.first.second << "): (" << elem.second.first << ", " << elem.second.second << ")" << std::endl;
+		}
+
+		stream << "\t]" << std::endl;
+
 		stream << "\tBond length parameters: [" << std::endl;
 
 		for (const auto& elem : forceField.m_bondLengthParameters) {
@@ -663,6 +693,7 @@ namespace classical {
 		m_atomicMasses = s_defaultAtomicMasses;
 		m_covalentRadii = s_defaultCovalentRadii;
 		m_vanDerWaalsParameters = s_defaultVanDerWaalsParameters;
+		m_vanDerWaalsPairParameters.clear();
 		m_bondLengthParameters = s_defaultBondLengthParameters;
 		m_bondAngleParameters = s_defaultBondAngleParameters;
 		m_torsion23Parameters = s_defaultTorsion23Parameters;
@@ -685,6 +716,10 @@ namespace classical {
 			m_vanDerWaalsParameters.insert(std::make_pair(tokens[1], std::make_pair(utils::ToDouble(tokens[2]), utils::ToDouble(tokens[3]))));
 		}
 
+		if (tokens[0] == "nbfix" && tokens.size() >= 5) {
+			m_vanDerWaalsPairParameters.insert(std::make_pair(std::make_pair(tokens[1], tokens[2]), std::make_pair(utils::ToDouble(tokens[3]), utils::ToDouble(tokens[4]))));
+		}
+
 		if (tokens[0] == "bond" && tokens.size() >= 4) {
 			m_bondLengthParameters.insert(std::make_pair(std::make_pair(tokens[1], tokens[2]), 
 				std::make_pair(utils::ToDouble(tokens[3]), utils::ToDouble(tokens[4]))));
@@ -730,4 +765,155 @@ namespace classical {
 		}
 	}
 
+
+	void ForceField::CompileParameters() {
+		m_typeIds.clear();
+		m_typeNames.clear();
+
+		auto intern = [this](const String &type) {
+			if (m_typeIds.insert(std::make_pair(type, (int)m_typeNames.size())).second) {
+				m_typeNames.push_back(type);
+			}
+		};
+
+		for (const auto &elem : m_vanDerWaalsParameters) {
+			intern(elem.first);
+		}
+
+		m_nVanDerWaalsTypes = m_typeNames.size();
+
+		for (const auto &elem : m_bondLengthParameters) {
+			intern(elem.first.first);
+			intern(elem.first.second);
+		}
+
+		for (const auto &elem : m_bondAngleParameters) {
+			intern(std::get<0>(elem.first));
+			intern(std::get<1>(elem.first));
+			intern(std::get<2>(elem.first));
+		}
+
+		for (const auto &elem : m_torsion23Parameters) {
+			intern(elem.first.first);
+			intern(elem.first.second);
+		}
+
+		for (const auto &elem : m_torsion1234Parameters) {
+			intern(std::get<0>(elem.first));
+			intern(std::get<1>(elem.first));
+			intern(std::get<2>(elem.first));
+			intern(std::get<3>(elem.first));
+		}
+
+		for (const auto &elem : m_outOfPlane34Parameters) {
+			intern(elem.first.first);
+			intern(elem.first.second);
+		}
+
+		for (const auto &elem : m_outOfPlane234Parameters) {
+			intern(std::get<0>(elem.first));
+			intern(std::get<1>(elem.first));
+			intern(std::get<2>(elem.first));
+		}
+
+		for (const auto &elem : m_outOfPlane1234Parameters) {
+			intern(std::get<0>(elem.first));
+			intern(std::get<1>(elem.first));
+			intern(std::get<2>(elem.first));
+			intern(std::get<3>(elem.first));
+		}
+
+		int nTypes = m_nVanDerWaalsTypes;
+
+		m_vanDerWaalsTypeParameters.resize(nTypes);
+
+		for (int i = 0; i < nTypes; i++) {
+			m_vanDerWaalsTypeParameters[i] = m_vanDerWaalsParameters.find(m_typeNames[i])->second;
+		}
+
+		m_vanDerWaalsPairTable.assign(nTypes * nTypes, VanDerWaalsPair());
+
+		for (int i = 0; i < nTypes; i++) {
+			const std::pair<double, double> &parameters1 = m_vanDerWaalsTypeParameters[i];
+
+			for (int j = 0; j < nTypes; j++) {
+				const std::pair<double, double> &parameters2 = m_vanDerWaalsTypeParameters[j];
+
+				m_vanDerWaalsPairTable[i * nTypes + j] = CombineVanDerWaalsParameters(parameters1.first, parameters1.second, parameters2.first, parameters2.second);
+			}
+		}
+
+		for (const auto &elem : m_vanDerWaalsPairParameters) {
+			int i = GetTypeId(elem.first.first);
+			int j = GetTypeId(elem.first.second);
+
+			if (!HasVanDerWaalsParameters(i) || !HasVanDerWaalsParameters(j)) {
+				std::cout << "Ignoring nbfix parameters for unknown atom type pair (" << elem.first.first << ", " << elem.first.second << ")" << std::endl;
+				continue;
+			}
+
+			m_vanDerWaalsPairTable[i * nTypes + j] = VanDerWaalsPair(elem.second.first, elem.second.second);
+			m_vanDerWaalsPairTable[j * nTypes + i] = m_vanDerWaalsPairTable[i * nTypes + j];
+		}
+
+		/* Forward entries are inserted first so that the reverse of another entry never shadows them. */
+		m_bondTable.clear();
+
+		for (const auto &elem : m_bondLengthParameters) {
+			m_bondTable.insert(std::make_pair(GetTypeKey(GetTypeId(elem.first.first), GetTypeId(elem.first.second)), elem.second));
+		}
+
+		for (const auto &elem : m_bondLengthParameters) {
+			m_bondTable.insert(std::make_pair(GetTypeKey(GetTypeId(elem.first.second), GetTypeId(elem.first.first)), elem.second));
+		}
+
+		m_angleTable.clear();
+
+		for (const auto &elem : m_bondAngleParameters) {
+			m_angleTable.insert(std::make_pair(GetTypeKey(GetTypeId(std::get<0>(elem.first)), GetTypeId(std::get<1>(elem.first)), GetTypeId(std::get<2>(elem.first))), elem.second));
+		}
+
+		for (const auto &elem : m_bondAngleParameters) {
+			m_angleTable.insert(std::make_pair(GetTypeKey(GetTypeId(std::get<2>(elem.first)), GetTypeId(std::get<1>(elem.first)), GetTypeId(std::get<0>(elem.first))), elem.second));
+		}
+
+		m_torsion23Table.clear();
+
+		for (const auto &elem : m_torsion23Parameters) {
+			m_torsion23Table.insert(std::make_pair(GetTypeKey(GetTypeId(elem.first.first), GetTypeId(elem.first.second)), elem.second));
+		}
+
+		for (const auto &elem : m_torsion23Parameters) {
+			m_torsion23Table.insert(std::make_pair(GetTypeKey(GetTypeId(elem.first.second), GetTypeId(elem.first.first)), elem.second));
+		}
+
+		m_torsion1234Table.clear();
+
+		for (const auto &elem : m_torsion1234Parameters) {
+			std::vector<std::tuple<double, double, int, int>> &list = m_torsion1234Table[GetTypeKey(GetTypeId(std::get<0>(elem.first)), GetTypeId(std::get<1>(elem.first)), GetTypeId(std::get<2>(elem.first)), GetTypeId(std::get<3>(elem.first)))];
+			list.insert(list.end(), elem.second.begin(), elem.second.end());
+		}
+
+		for (const auto &elem : m_torsion1234Parameters) {
+			std::vector<std::tuple<double, double, int, int>> &list = m_torsion1234Table[GetTypeKey(GetTypeId(std::get<3>(elem.first)), GetTypeId(std::get<2>(elem.first)), GetTypeId(std::get<1>(elem.first)), GetTypeId(std::get<0>(elem.first)))];
+			list.insert(list.end(), elem.second.begin(), elem.second.end());
+		}
+
+		m_outOfPlane34Table.clear();
+		m_outOfPlane234Table.clear();
+		m_outOfPlane1234Table.clear();
+
+		for (const auto &elem : m_outOfPlane34Parameters) {
+			m_outOfPlane34Table.insert(std::make_pair(GetTypeKey(GetTypeId(elem.first.first), GetTypeId(elem.first.second)), elem.second));
+		}
+
+		for (const auto &elem : m_outOfPlane234Parameters) {
+			m_outOfPlane234Table.insert(std::make_pair(GetTypeKey(GetTypeId(std::get<0>(elem.first)), GetTypeId(std::get<1>(elem.first)), GetTypeId(std::get<2>(elem.first))), elem.second));
+		}
+
+		for (const auto &elem : m_outOfPlane1234Parameters) {
+			m_outOfPlane1234Table.insert(std::make_pair(GetTypeKey(GetTypeId(std::get<0>(elem.first)), GetTypeId(std::get<1>(elem.first)), GetTypeId(std::get<2>(elem.first)), GetTypeId(std::get<3>(elem.first))), elem.second));
+		}
+	}
+
 }
\ No newline at end of file
@@ -6,10 +6,27 @@
 #include <iostream>
 #include <map>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 namespace classical {
 
+	/* Lennard-Jones parameters of a pair of atom types: the well depth eps_ij [kcal/mol] and minimum distance ro_ij
+	   [Angstrom], and the coefficients of E = c12 / r^12 - c6 / r^6 with c12 = eps_ij ro_ij^12 and c6 = 2 eps_ij ro_ij^6. */
+	struct VanDerWaalsPair {
+		double attractionMagnitude;
+		double radius;
+		double c12;
+		double c6;
+
+		VanDerWaalsPair();
+		VanDerWaalsPair(double radius, double attractionMagnitude);
+	};
+
+	/* Lorentz-Berthelot combination of two per-type parameters as used by the force field, ro_ij = ro_i/2 + ro_j/2 and
+	   eps_ij = sqrt(eps_i) sqrt(eps_j). */
+	VanDerWaalsPair CombineVanDerWaalsParameters(double radius1, double attractionMagnitude1, double radius2, double attractionMagnitude2);
+
 	class ForceField {
 	public:
 		ForceField();
@@ -30,118 +47,134 @@ namespace classical {
 		}
 
 		inline double GetVanDerWaalsRadius(const String &type) { 
-			if (m_vanDerWaalsParameters.find(type) != m_vanDerWaalsParameters.end()) return m_vanDerWaalsParameters.find(type)->second.first;
+			int typeId = GetTypeId(type);
+
+			if (HasVanDerWaalsParameters(typeId)) return m_vanDerWaalsTypeParameters[typeId].first;
 
 			std::cout << "Could not find Van Der Waals radius for atom type " << type << std::endl;
 			return -1;
 		}
 
 		inline double GetVanDerWaalsAttractionMagnitude(const String &type) { 
-			if (m_vanDerWaalsParameters.find(type) != m_vanDerWaalsParameters.end()) return m_vanDerWaalsParameters.find(type)->second.second;
+			int typeId = GetTypeId(type);
+
+			if (HasVanDerWaalsParameters(typeId)) return m_vanDerWaalsTypeParameters[typeId].second;
 
 			std::cout << "Could not find Van Der Waals attraction magnitude for atom type " << type << std::endl;
 			return -1;
 		}
 
-		inline double GetBondSpringConstant(const String &type1, const String &type2) { 
-			if (m_bondLengthParameters.find(std::make_pair(type1, type2)) != m_bondLengthParameters.end()) {
-				return m_bondLengthParameters.find(std::make_pair(type1, type2))->second.first;
-			}
-			
-			if (m_bondLengthParameters.find(std::make_pair(type2, type1)) != m_bondLengthParameters.end()) {
-				return m_bondLengthParameters.find(std::make_pair(type2, type1))->second.first;
-			}
+		inline double GetBondSpringConstant(int typeId1, int typeId2) { 
+			std::unordered_map<unsigned long long, std::pair<double, double>>::const_iterator it = m_bondTable.find(GetTypeKey(typeId1, typeId2));
+
+			if (it != m_bondTable.end()) return it->second.first;
 
-			std::cout << "Could not find bond spring constant for atom type pair (" << type1 << ", " << type2 << ")" << std::endl;
+			std::cout << "Could not find bond spring constant for atom type pair (" << GetTypeLabel(typeId1) << ", " << GetTypeLabel(typeId2) << ")" << std::endl;
 			return -1;
 		}
 
-		inline double GetBondEquilibriumLength(const String &type1, const String &type2) { 
-			if (m_bondLengthParameters.find(std::make_pair(type1, type2)) != m_bondLengthParameters.end()) {
-				return m_bondLengthParameters.find(std::make_pair(type1, type2))->second.second;
-			}
-			
-			if (m_bondLengthParameters.find(std::make_pair(type2, type1)) != m_bondLengthParameters.end()) {
-				return m_bondLengthParameters.find(std::make_pair(type2, type1))->second.second;
-			}
+		inline double GetBondEquilibriumLength(int typeId1, int typeId2) { 
+			std::unordered_map<unsigned long long, std::pair<double, double>>::const_iterator it = m_bondTable.find(GetTypeKey(typeId1, typeId2));
+
+			if (it != m_bondTable.end()) return it->second.second;
 
-			std::cout << "Could not find bond equilibrium length for atom type pair (" << type1 << ", " << type2  << ")" << std::endl;
+			std::cout << "Could not find bond equilibrium length for atom type pair (" << GetTypeLabel(typeId1) << ", " << GetTypeLabel(typeId2) << ")" << std::endl;
 			return -1;
 		}
 
-		inline double GetAngleSpringConstant(const String &type1, const String &type2, const String &type3) {
-			if (m_bondAngleParameters.find(std::make_tuple(type1, type2, type3)) != m_bondAngleParameters.end()) {
-				return m_bondAngleParameters.find(std::make_tuple(type1, type2, type3))->second.first;
-			}
+		inline double GetAngleSpringConstant(int typeId1, int typeId2, int typeId3) {
+			std::unordered_map<unsigned long long, std::pair<double, double>>::const_iterator it = m_angleTable.find(GetTypeKey(typeId1, typeId2, typeId3));
 
-			if (m_bondAngleParameters.find(std::make_tuple(type3, type2, type1)) != m_bondAngleParameters.end()) {
-				return m_bondAngleParameters.find(std::make_tuple(type3, type2, type1))->second.first;
-			}
+			if (it != m_angleTable.end()) return it->second.first;
 
-			std::cout << "Could not find angle spring constant for atom type triplet (" << type1 << ", " << type2 << ", " << type3 << ")" << std::endl;
+			std::cout << "Could not find angle spring constant for atom type triplet (" << GetTypeLabel(typeId1) << ", " << GetTypeLabel(typeId2) << ", " << GetTypeLabel(typeId3) << ")" << std::endl;
 			return -1;
 		}
 
-		inline double GetAngleEquilibriumDegrees(const String &type1, const String &type2, const String &type3) {
-			if (m_bondAngleParameters.find(std::make_tuple(type1, type2, type3)) != m_bondAngleParameters.end()) {
-				return m_bondAngleParameters.find(std::make_tuple(type1, type2, type3))->second.second;
-			}
+		inline double GetAngleEquilibriumDegrees(int typeId1, int typeId2, int typeId3) {
+			std::unordered_map<unsigned long long, std::pair<double, double>>::const_iterator it = m_angleTable.find(GetTypeKey(typeId1, typeId2, typeId3));
 
-			if (m_bondAngleParameters.find(std::make_tuple(type3, type2, type1)) != m_bondAngleParameters.end()) {
-				return m_bondAngleParameters.find(std::make_tuple(type3, type2, type1))->second.second;
-			}
+			if (it != m_angleTable.end()) return it->second.second;
 
-			std::cout << "Could not find angle equilibrium degrees for atom type triplet (" << type1 << ", " << type2 << ", " << type3 << ")" << std::endl;
+			std::cout << "Could not find angle equilibrium degrees for atom type triplet (" << GetTypeLabel(typeId1) << ", " << GetTypeLabel(typeId2) << ", " << GetTypeLabel(typeId3) << ")" << std::endl;
 			return -1;
 		}
 
-		std::vector<std::tuple<double, double, int, int>> GetTorsionParameters(const String &type1, const String &type2, const String &type3, const String &type4) {
+		std::vector<std::tuple<double, double, int, int>> GetTorsionParameters(int typeId1, int typeId2, int typeId3, int typeId4) {
 			std::vector<std::tuple<double, double, int, int>> torsionParameters;
 
-			if (m_torsion23Parameters.find(std::make_pair(type2, type3)) != m_torsion23Parameters.end()) {
-				torsionParameters.push_back(m_torsion23Parameters.find(std::make_pair(type2, type3))->second);
-			} else if (m_torsion23Parameters.find(std::make_pair(type3, type2)) != m_torsion23Parameters.end()) {
-				torsionParameters.push_back(m_torsion23Parameters.find(std::make_pair(type3, type2))->second);
+			std::unordered_map<unsigned long long, std::tuple<double, double, int, int>>::const_iterator found23 = m_torsion23Table.find(GetTypeKey(typeId2, typeId3));
+
+			if (found23 != m_torsion23Table.end()) {
+				torsionParameters.push_back(found23->second);
 			}
 			else {
-				std::cout << "Could not find torsion parameters for atom central atom pair (" << type2 << ", " << type3 << ")" << std::endl;
+				std::cout << "Could not find torsion parameters for atom central atom pair (" << GetTypeLabel(typeId2) << ", " << GetTypeLabel(typeId3) << ")" << std::endl;
 			}
 
-			std::map<std::tuple<String, String, String, String>, std::vector<std::tuple<double, double, int, int>>>::iterator foundTorsion1234Iterator = 
-				m_torsion1234Parameters.find(std::make_tuple(type1, type2, type3, type4));
+			std::unordered_map<unsigned long long, std::vector<std::tuple<double, double, int, int>>>::const_iterator found1234 = m_torsion1234Table.find(GetTypeKey(typeId1, typeId2, typeId3, typeId4));
 
-			if (foundTorsion1234Iterator != m_torsion1234Parameters.end()) {
-				torsionParameters.insert(torsionParameters.end(), foundTorsion1234Iterator->second.begin(), foundTorsion1234Iterator->second.end());
-			}
-
-			foundTorsion1234Iterator = m_torsion1234Parameters.find(std::make_tuple(type4, type3, type2, type1));
-
-			if (foundTorsion1234Iterator != m_torsion1234Parameters.end()) {
-				torsionParameters.insert(torsionParameters.end(), foundTorsion1234Iterator->second.begin(), foundTorsion1234Iterator->second.end());
+			if (found1234 != m_torsion1234Table.end()) {
+				torsionParameters.insert(torsionParameters.end(), found1234->second.begin(), found1234->second.end());
 			}
 
 			return torsionParameters;
 		}
 
-		inline double GetOutOfPlaneHeightBarrier(const String &type1, const String &type2, const String &type3, const String &type4) {
-			if (m_outOfPlane1234Parameters.find(std::make_tuple(type1, type2, type3, type4)) != m_outOfPlane1234Parameters.end()) {
-				return m_outOfPlane1234Parameters.find(std::make_tuple(type1, type2, type3, type4))->second;
-			}
+		inline double GetOutOfPlaneHeightBarrier(int typeId1, int typeId2, int typeId3, int typeId4) {
+			std::unordered_map<unsigned long long, double>::const_iterator it = m_outOfPlane1234Table.find(GetTypeKey(typeId1, typeId2, typeId3, typeId4));
 
-			if (m_outOfPlane234Parameters.find(std::make_tuple(type2, type3, type4)) != m_outOfPlane234Parameters.end()) {
-				return m_outOfPlane234Parameters.find(std::make_tuple(type2, type3, type4))->second;
-			}
+			if (it != m_outOfPlane1234Table.end()) return it->second;
 
-			if (m_outOfPlane34Parameters.find(std::make_pair(type3, type4)) != m_outOfPlane34Parameters.end()) {
-				return m_outOfPlane34Parameters.find(std::make_pair(type3, type4))->second;
-			}
+			it = m_outOfPlane234Table.find(GetTypeKey(typeId2, typeId3, typeId4));
+
+			if (it != m_outOfPlane234Table.end()) return it->second;
+
+			it = m_outOfPlane34Table.find(GetTypeKey(typeId3, typeId4));
+
+			if (it != m_outOfPlane34Table.end()) return it->second;
 
 			return 0.0;
 		}
 
+		inline double GetBondSpringConstant(const String &type1, const String &type2) { return GetBondSpringConstant(GetTypeId(type1), GetTypeId(type2)); }
+		inline double GetBondEquilibriumLength(const String &type1, const String &type2) { return GetBondEquilibriumLength(GetTypeId(type1), GetTypeId(type2)); }
+
+		inline double GetAngleSpringConstant(const String &type1, const String &type2, const String &type3) {
+			return GetAngleSpringConstant(GetTypeId(type1), GetTypeId(type2), GetTypeId(type3));
+		}
+
+		inline double GetAngleEquilibriumDegrees(const String &type1, const String &type2, const String &type3) {
+			return GetAngleEquilibriumDegrees(GetTypeId(type1), GetTypeId(type2), GetTypeId(type3));
+		}
+
+		std::vector<std::tuple<double, double, int, int>> GetTorsionParameters(const String &type1, const String &type2, const String &type3, const String &type4) {
+			return GetTorsionParameters(GetTypeId(type1), GetTypeId(type2), GetTypeId(type3), GetTypeId(type4));
+		}
+
+		inline double GetOutOfPlaneHeightBarrier(const String &type1, const String &type2, const String &type3, const String &type4) {
+			return GetOutOfPlaneHeightBarrier(GetTypeId(type1), GetTypeId(type2), GetTypeId(type3), GetTypeId(type4));
+		}
+
+		/* Dense id of an atom type named anywhere in the parameter tables, or -1 if the type is unknown. Types with van
+		   der Waals parameters come first. */
+		inline int GetTypeId(const String &type) const {
+			std::unordered_map<String, int>::const_iterator it = m_typeIds.find(type);
+
+			return it != m_typeIds.end() ? it->second : -1;
+		}
+
+		inline int GetNTypes() const { return m_typeNames.size(); }
+		inline const String &GetTypeName(int typeId) const { return m_typeNames[typeId]; }
+		inline bool HasVanDerWaalsParameters(int typeId) const { return typeId >= 0 && typeId < m_nVanDerWaalsTypes; }
+
+		/* Combined or overridden (nbfix) parameters of two type ids with van der Waals parameters. */
+		inline const VanDerWaalsPair &GetVanDerWaalsPair(int typeId1, int typeId2) const { return m_vanDerWaalsPairTable[typeId1 * m_nVanDerWaalsTypes + typeId2]; }
+
 		inline const std::map<String, double> &GetAtomicMasses() const { return m_atomicMasses; }
 		inline const std::map<String, double> &GetElementsRadii() const { return m_covalentRadii; }
 		inline const std::map<String, std::pair<double, double>> &GetVanDerWaalsParameters() const { return m_vanDerWaalsParameters; }
+		inline const std::map<std::pair<String, String>, std::pair<double, double>> &GetVanDerWaalsPairParameters() const { return m_vanDerWaalsPairParameters; }
 		inline const std::map<std::pair<String, String>, std::pair<double, double>> &GetBondLengthParameters() const { return m_bondLengthParameters; }
 		inline const std::map<std::tuple<String, String, String>, std::pair<double, double>> &GetBondAngleParameters() const { return m_bondAngleParameters; }
 		inline const std::map<std::pair<String, String>, std::tuple<double, double, int, int>> &GetTorsion23Parameters() const { return m_torsion23Parameters; }
@@ -154,6 +187,15 @@ namespace classical {
 	private:
 		void SetDefaultParameters();
 		void ResolveTokens(const std::vector<String> &tokens);
+		/* Interns every atom type and compiles the parameter maps into the id keyed tables below. */
+		void CompileParameters();
+
+		inline String GetTypeLabel(int typeId) const { return typeId >= 0 ? m_typeNames[typeId] : String("unknown"); }
+
+		/* Packs up to four type ids into one key, 16 bits each; unused slots are zero. */
+		static inline unsigned long long GetTypeKey(int typeId1, int typeId2, int typeId3 = -1, int typeId4 = -1) {
+			return ((unsigned long long)(typeId1 + 1) << 48) | ((unsigned long long)(typeId2 + 1) << 32) | ((unsigned long long)(typeId3 + 1) << 16) | (unsigned long long)(typeId4 + 1);
+		}
 	private:
 		/* String: atomic symbol, Double: atomic mass. */
 		std::map<String, double> m_atomicMasses;
@@ -161,6 +203,8 @@ namespace classical {
 		std::map<String, double> m_covalentRadii;
 		/* String: atom type, Double 1: Van Der Waals radius ro/2 [Angstrom], Double 2: Van Der Waals attraction magnitude eps [kcal/mol]. */
 		std::map<String, std::pair<double, double>> m_vanDerWaalsParameters;
+		/* String 1: atom type, String 2: atom type, Double 1: pair minimum distance ro_ij [Angstrom], Double 2: pair attraction magnitude eps_ij [kcal/mol]; replaces the combination rule (nbfix). */
+		std::map<std::pair<String, String>, std::pair<double, double>> m_vanDerWaalsPairParameters;
 		/* String 1: atom type, String 2: atom type, Double 1: bond spring constant k_b [kcal/(mol*A^2)], Double 2: bond equilibrium length r_eq [Angstrom]. */
 		std::map<std::pair<String, String>, std::pair<double, double>> m_bondLengthParameters;
 		/* String 1: atom type, String 2: atom type, String 3: atom type, Double 1: angle spring constant k_a [kcal/(mol*rad^2)], Double 2: bond equilibrium angle a_eq [degrees]. */
@@ -175,6 +219,26 @@ namespace classical {
 		std::map<std::tuple<String, String, String>, double> m_outOfPlane234Parameters;
 		/* String 1: atom type, String 2: atom type, String 3: atom type, String 4: atom type, Double: rotation barrier height vn/2 [kcal/mol]. */
 		std::map<std::tuple<String, String, String, String>, double> m_outOfPlane1234Parameters;
+
+		/* Atom types in order of their id. */
+		std::unordered_map<String, int> m_typeIds;
+		std::vector<String> m_typeNames;
+
+		/* Per-type parameters and the row-major table of pair parameters of the first m_nVanDerWaalsTypes ids. */
+		int m_nVanDerWaalsTypes;
+		std::vector<std::pair<double, double>> m_vanDerWaalsTypeParameters;
+		std::vector<VanDerWaalsPair> m_vanDerWaalsPairTable;
+
+		/* The bonded parameters keyed by packed type ids. Bonds, angles and torsions are stored in both directions, an
+		   entry read in the queried direction taking precedence over the reverse of another; the torsion1234 lists hold
+		   the forward parameters followed by those of the reversed quadruplet. */
+		std::unordered_map<unsigned long long, std::pair<double, double>> m_bondTable;
+		std::unordered_map<unsigned long long, std::pair<double, double>> m_angleTable;
+		std::unordered_map<unsigned long long, std::tuple<double, double, int, int>> m_torsion23Table;
+		std::unordered_map<unsigned long long, std::vector<std::tuple<double, double, int, int>>> m_torsion1234Table;
+		std::unordered_map<unsigned long long, double> m_outOfPlane34Table;
+		std::unordered_map<unsigned long long, double> m_outOfPlane234Table;
+		std::unordered_map<unsigned long long, double> m_outOfPlane1234Table;
 	};
 
 }
\ No newline at end of file
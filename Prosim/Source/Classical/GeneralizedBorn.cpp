@@ -0,0 +1,260 @@
+#include "GeneralizedBorn.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <iostream>
+
+#include "Constants.h"
+
+namespace classical {
+
+	/* Dielectric offset of the intrinsic radii and the OBC II coefficients of the Born radius. */
+	static const double s_dielectricOffset = 0.09;
+	static const double s_alpha = 1.0;
+	static const double s_beta = 0.8;
+	static const double s_gamma = 4.85;
+
+	ImplicitSolventModel ResolveImplicitSolventModel(const String &name) {
+		if (name.find("none") != String::npos) {
+			return ImplicitSolventModel::None;
+		}
+		else if (name.find("gb-obc") != String::npos) {
+			return ImplicitSolventModel::OBC;
+		}
+
+		std::cout << "Unknown implicit solvent model: " << name << std::endl;
+		std::cout << "Use 'none' or 'gb-obc'" << std::endl;
+		return ImplicitSolventModel::None;
+	}
+
+	String GetImplicitSolventModelName(ImplicitSolventModel model) {
+		switch (model) {
+		case ImplicitSolventModel::OBC: return "gb-obc";
+		default: return "none";
+		}
+	}
+
+	static double GetBondiRadius(const String &element) {
+		if (element == "H") return 1.2;
+		if (element == "C") return 1.7;
+		if (element == "N") return 1.55;
+		if (element == "O") return 1.52;
+		if (element == "F") return 1.47;
+		if (element == "P") return 1.8;
+		if (element == "S") return 1.8;
+		return 1.5;
+	}
+
+	static double GetScreeningFactor(const String &element) {
+		if (element == "H") return 0.85;
+		if (element == "C") return 0.72;
+		if (element == "N") return 0.79;
+		if (element == "O") return 0.85;
+		if (element == "F") return 0.88;
+		if (element == "P") return 0.86;
+		if (element == "S") return 0.96;
+		return 0.8;
+	}
+
+	/* Part of the descreening integral of an atom of radius offsetRadius due to a sphere of radius scaledRadius at
+	   distance r (Hawkins, Cramer and Truhlar, J. Phys. Chem. 100, 19824 (1996)), and its derivative by r. */
+	static inline double GetDescreening(double r, double offsetRadius, double scaledRadius) {
+		if (offsetRadius >= r + scaledRadius) return 0.0;
+
+		double l = 1.0 / fmax(offsetRadius, fabs(r - scaledRadius));
+		double u = 1.0 / (r + scaledRadius);
+		double l2 = l * l;
+		double u2 = u * u;
+		double rInverse = 1.0 / r;
+
+		double term = l - u + 0.25 * r * (u2 - l2) + 0.5 * rInverse * log(u / l) + 0.25 * scaledRadius * scaledRadius * rInverse * (l2 - u2);
+
+		/* The atom lies inside the screening sphere. */
+		if (offsetRadius < scaledRadius - r) {
+			term += 2.0 * (1.0 / offsetRadius - l);
+		}
+
+		return term;
+	}
+
+	static inline double GetDescreeningDerivative(double r, double offsetRadius, double scaledRadius) {
+		if (offsetRadius >= r + scaledRadius) return 0.0;
+
+		double l = 1.0 / fmax(offsetRadius, fabs(r - scaledRadius));
+		double u = 1.0 / (r + scaledRadius);
+		double r2Inverse = 1.0 / (r * r);
+
+		return -0.25 * (1.0 + scaledRadius * scaledRadius * r2Inverse) * (l * l - u * u) - 0.5 * log(u / l) * r2Inverse;
+	}
+
+	/* Calls function(j, a, b, c, r2) for every partner j of atom i within the cutoff, from both halves of its row, with
+	   (a, b, c) the separation of i from j. */
+	template <typename Function>
+	static inline void ForEachRowPartner(const ParticleStore &particles, const NeighborList &neighborList, int i, Function function) {
+		const double *x = particles.position[0].data();
+		const double *y = particles.position[1].data();
+		const double *z = particles.position[2].data();
+		double cutoff2 = neighborList.GetCutoff() > 0.0 ? neighborList.GetCutoff() * neighborList.GetCutoff() : DBL_MAX;
+
+		const int *rows[2] = { neighborList.GetNeighbors(i), neighborList.GetLowerNeighbors(i) };
+		int counts[2] = { neighborList.GetNNeighbors(i), neighborList.GetNLowerNeighbors(i) };
+
+		for (int h = 0; h < 2; h++) {
+			for (int n = 0; n < counts[h]; n++) {
+				int j = rows[h][n];
+
+				double a = x[i] - x[j];
+				double b = y[i] - y[j];
+				double c = z[i] - z[j];
+				double r2 = a * a + b * b + c * c;
+
+				if (r2 < cutoff2) {
+					function(j, a, b, c, r2);
+				}
+			}
+		}
+	}
+
+	GeneralizedBorn::GeneralizedBorn() {
+
+	}
+
+	void GeneralizedBorn::Setup(const std::vector<Atom *> &atoms, const ParticleStore &particles) {
+		int natoms = particles.GetSize();
+
+		m_radii.resize(natoms);
+		m_offsetRadii.resize(natoms);
+		m_scaledRadii.resize(natoms);
+
+		for (int i = 0; i < natoms; i++) {
+			m_radii[i] = particles.radius[i] > s_dielectricOffset ? particles.radius[i] : GetBondiRadius(atoms[i]->element);
+			m_offsetRadii[i] = m_radii[i] - s_dielectricOffset;
+			m_scaledRadii[i] = GetScreeningFactor(atoms[i]->element) * m_offsetRadii[i];
+		}
+
+		m_bornRadii.assign(natoms, 0.0);
+		m_bornChain.assign(natoms, 0.0);
+		m_bornForces.assign(natoms, 0.0);
+		m_rowEnergies.assign(natoms, 0.0);
+	}
+
+	double GeneralizedBorn::CalculateEnergy(const ParticleStore &particles, const NeighborList &neighborList, double soluteDielectric, double solventDielectric) {
+		double prefactor = -CEU_TO_KCAL * (1.0 / soluteDielectric - 1.0 / solventDielectric);
+
+		CalculateBornRadii(particles, neighborList);
+
+		return CalculatePairSum(nullptr, particles, neighborList, prefactor);
+	}
+
+	double GeneralizedBorn::CalculateEnergyAndGradient(std::vector<math::Vec3> &gSolvation, const ParticleStore &particles, const NeighborList &neighborList, double soluteDielectric, double solventDielectric) {
+		int natoms = particles.GetSize();
+		double prefactor = -CEU_TO_KCAL * (1.0 / soluteDielectric - 1.0 / solventDielectric);
+
+		CalculateBornRadii(particles, neighborList);
+
+		double energy = CalculatePairSum(&gSolvation, particles, neighborList, prefactor);
+
+		/* dE / dI_i; the Born radii only depend on the positions through the descreening sums. */
+		for (int i = 0; i < natoms; i++) {
+			m_bornForces[i] *= m_bornRadii[i] * m_bornRadii[i] * m_bornChain[i];
+		}
+
+		/* Every pair changes the descreening sums of both its atoms. */
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int i = 0; i < natoms; i++) {
+			double gI[3] = { 0.0, 0.0, 0.0 };
+
+			ForEachRowPartner(particles, neighborList, i, [&](int j, double a, double b, double c, double r2) {
+				double r = sqrt(r2);
+				double dEdr = m_bornForces[i] * GetDescreeningDerivative(r, m_offsetRadii[i], m_scaledRadii[j]) + m_bornForces[j] * GetDescreeningDerivative(r, m_offsetRadii[j], m_scaledRadii[i]);
+				double scale = dEdr / r;
+
+				gI[0] += scale * a;
+				gI[1] += scale * b;
+				gI[2] += scale * c;
+			});
+
+			gSolvation[i] += math::Vec3(gI[0], gI[1], gI[2]);
+		}
+
+		return energy;
+	}
+
+	void GeneralizedBorn::CalculateBornRadii(const ParticleStore &particles, const NeighborList &neighborList) {
+		int natoms = particles.GetSize();
+
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int i = 0; i < natoms; i++) {
+			double offsetRadius = m_offsetRadii[i];
+			double sum = 0.0;
+
+			ForEachRowPartner(particles, neighborList, i, [&](int j, double, double, double, double r2) {
+				sum += GetDescreening(sqrt(r2), offsetRadius, m_scaledRadii[j]);
+			});
+
+			double psi = 0.5 * sum * offsetRadius;
+			double t = tanh(s_alpha * psi - s_beta * psi * psi + s_gamma * psi * psi * psi);
+
+			m_bornRadii[i] = 1.0 / (1.0 / offsetRadius - t / m_radii[i]);
+			m_bornChain[i] = 0.5 * offsetRadius * (s_alpha - 2.0 * s_beta * psi + 3.0 * s_gamma * psi * psi) * (1.0 - t * t) / m_radii[i];
+		}
+	}
+
+	double GeneralizedBorn::CalculatePairSum(std::vector<math::Vec3> *gSolvation, const ParticleStore &particles, const NeighborList &neighborList, double prefactor) {
+		int natoms = particles.GetSize();
+		const double *charge = particles.charge.data();
+
+		/* With a cutoff every term, the self terms included, is shifted by its value at the cutoff. The energy is then
+		   nearly continuous, and for charges that are neutral on the scale of the cutoff close to the full sum. */
+		double cutoffInverse = neighborList.GetCutoff() > 0.0 ? 1.0 / neighborList.GetCutoff() : 0.0;
+
+#pragma omp parallel for schedule(dynamic, 16)
+		for (int i = 0; i < natoms; i++) {
+			double bornRadius = m_bornRadii[i];
+			double qi = prefactor * charge[i];
+			double gI[3] = { 0.0, 0.0, 0.0 };
+
+			/* The self term, i = j. */
+			double e = 0.5 * qi * charge[i] * (1.0 / bornRadius - cutoffInverse);
+			double dEdB = -0.5 * qi * charge[i] / (bornRadius * bornRadius);
+
+			ForEachRowPartner(particles, neighborList, i, [&](int j, double a, double b, double c, double r2) {
+				double bornProduct = bornRadius * m_bornRadii[j];
+				double d = r2 / (4.0 * bornProduct);
+				double expTerm = exp(-d);
+				double f2 = r2 + bornProduct * expTerm;
+				double fInverse = 1.0 / sqrt(f2);
+				double qq = qi * charge[j];
+				double g = qq * fInverse;
+
+				/* Each pair is evaluated from both of its atoms. */
+				e += 0.5 * (g - qq * cutoffInverse);
+				dEdB -= 0.5 * g * expTerm * (1.0 + d) / f2 * m_bornRadii[j];
+
+				double scale = -g * (1.0 - 0.25 * expTerm) / f2;
+
+				gI[0] += scale * a;
+				gI[1] += scale * b;
+				gI[2] += scale * c;
+			});
+
+			m_rowEnergies[i] = e;
+			m_bornForces[i] = dEdB;
+
+			if (gSolvation) {
+				(*gSolvation)[i] += math::Vec3(gI[0], gI[1], gI[2]);
+			}
+		}
+
+		/* Row sums are added in atom order, so the energy does not depend on the schedule. */
+		double energy = 0.0;
+
+		for (int i = 0; i < natoms; i++) {
+			energy += m_rowEnergies[i];
+		}
+
+		return energy;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include "Atom.h"
+#include "NeighborList.h"
+#include "ParticleStore.h"
+
+#include "Math/PSMath.h"
+#include "Utils/String.h"
+
+namespace classical {
+
+	enum class ImplicitSolventModel {
+		None,
+		OBC
+	};
+
+	/* Maps "none" or "gb-obc" to a solvent model; anything else is reported and falls back to none. */
+	ImplicitSolventModel ResolveImplicitSolventModel(const String &name);
+	String GetImplicitSolventModelName(ImplicitSolventModel model);
+
+	/* Generalized Born implicit solvent with the effective Born radii of Onufriev, Bashford and Case (OBC II, Proteins 55,
+	   383 (2004)). The polar solvation energy is
+	   -0.5 k (1 / eps_solute - 1 / eps_solvent) sum_ij q_i q_j / sqrt(r_ij^2 + B_i B_j exp(-r_ij^2 / (4 B_i B_j))),
+	   including i = j. The descreening integrals behind the Born radii B_i and the pair sum are taken over the neighbor
+	   list within its cutoff, so the cost is linear in the number of atoms. Every atom owns its full neighbor row, so
+	   the result does not depend on the thread schedule. */
+	class GeneralizedBorn {
+	public:
+		GeneralizedBorn();
+
+		/* Takes the intrinsic radius of every atom from the input (the PQR radius column), or a Bondi radius by element
+		   where the input has none, and the HCT screening factor by element. */
+		void Setup(const std::vector<Atom *> &atoms, const ParticleStore &particles);
+
+		double CalculateEnergy(const ParticleStore &particles, const NeighborList &neighborList, double soluteDielectric, double solventDielectric);
+		/* Returns the energy and adds its gradient to gSolvation. */
+		double CalculateEnergyAndGradient(std::vector<math::Vec3> &gSolvation, const ParticleStore &particles, const NeighborList &neighborList, double soluteDielectric, double solventDielectric);
+
+		/* Born radii of the last calculation, in A. */
+		inline const std::vector<double> &GetBornRadii() const { return m_bornRadii; }
+	private:
+		void CalculateBornRadii(const ParticleStore &particles, const NeighborList &neighborList);
+		/* Pair sum over the Born radii; with gSolvation also its direct gradient and dE/dB_i into m_bornForces. */
+		double CalculatePairSum(std::vector<math::Vec3> *gSolvation, const ParticleStore &particles, const NeighborList &neighborList, double prefactor);
+	private:
+		std::vector<double> m_radii;
+		/* Intrinsic radii less the dielectric offset, and the screened radii the descreening integrals see. */
+		std::vector<double> m_offsetRadii;
+		std::vector<double> m_scaledRadii;
+
+		std::vector<double> m_bornRadii;
+		/* dB_i / dI_i over B_i^2, where I_i is the descreening sum of atom i. */
+		std::vector<double> m_bornChain;
+		/* dE / dB_i. */
+		std::vector<double> m_bornForces;
+		std::vector<double> m_rowEnergies;
+	};
+
+}
\ No newline at end of file
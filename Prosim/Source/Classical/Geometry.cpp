@@ -82,7 +82,7 @@ namespace classical {
 	}
 
 	double GetVolume(double bound, const String &boundType) {
-		if (boundType == "cube") {
+		if (boundType == "cube" || boundType == "periodic") {
 			return 8.0 * pow(bound, 3);
 		}
 		else if (boundType == "sphere") {
@@ -90,7 +90,7 @@ namespace classical {
 		}
 		else {
 			std::cout << "Unknown boundary type: " << boundType << std::endl;
-			std::cout << "Use 'cube' or 'sphere'" << std::endl;
+			std::cout << "Use 'cube', 'sphere' or 'periodic'" << std::endl;
 			return -1;
 		}
 	}
@@ -2,10 +2,12 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include "Constants.h"
+#include "Energy.h"
 #include "Geometry.h"
-
-#include "Utils/IterationTools.h"
+#include "Topology.h"
 
 namespace classical {
 
@@ -27,28 +29,25 @@ namespace classical {
 
 	double GetGMagnitudeVDWIJ(double rij, double epsij, double roij) {
 		double rrelij = roij / rij;
-		return -12.0 * (epsij / roij) * (pow(rrelij, 13) - pow(rrelij, 7));
+		double rrel2ij = rrelij * rrelij;
+		double rrel6ij = rrel2ij * rrel2ij * rrel2ij;
+		return -12.0 * (epsij / rij) * (rrel6ij * rrel6ij - rrel6ij);
 	}
 
 	double GetGMagnitudeElstIJ(double rij, double qi, double qj, double epsilon) {
-		return -CEU_TO_KCAL * qi * qj / (epsilon * pow(rij, 2));
+		return -CEU_TO_KCAL * qi * qj / (epsilon * rij * rij);
 	}
 
 	math::Vec3 GetGMagnitudeBoundI(double kBox, double bound, const math::Vec3 &position, const math::Vec3 &origin, const String &boundType) {
 		math::Vec3 gBoundI;
 
 		if (boundType == "cube") {
-			double sign = (position.x - origin.x) <= 0 ? 1.0 : -1.0;
-			double scale = abs(position.x - origin.x);
-			gBoundI.x = (-2.0 * sign * scale * kBox * (abs(position.x) - bound));
-
-			sign = (position.y - origin.y) <= 0 ? 1.0 : -1.0;
-			scale = abs(position.y - origin.y);
-			gBoundI.x = (-2.0 * sign * scale * kBox * (abs(position.y) - bound));
-
-			sign = (position.z - origin.z) <= 0 ? 1.0 : -1.0;
-			scale = abs(position.z - origin.z);
-			gBoundI.x = (-2.0 * sign * scale * kBox * (abs(position.z) - bound));
+			for (int j = 0; j < 3; j++) {
+				double rjo = position[j] - origin[j];
+				double scale = (double)(abs(rjo) >= bound);
+				double sign = rjo < 0 ? -1.0 : 1.0;
+				gBoundI[j] = sign * 2.0 * scale * kBox * (abs(rjo) - bound);
+			}
 		}
 		else if (boundType == "sphere") {
 			double rio = GetRij(position, origin);
@@ -60,209 +59,396 @@ namespace classical {
 		return gBoundI;
 	}
 
-	std::pair<math::Vec3, math::Vec3> GetGDirectionInteraction(const math::Vec3 &position1, const math::Vec3 &position2, double r12) {
-		math::Vec3 gDir1 = GetUij(position2, position1, r12);
-		math::Vec3 gDir2 = math::Vec3(gDir1) * -1.0;
-		return std::make_pair(gDir1, gDir2);
+	/* Unit vector from atom i to the nearest image of atom j, whose distance is rij, in double precision. */
+	static inline void GetBondedUij(double *u, const ParticleStore &particles, const PeriodicBox &box, int i, int j, double rij) {
+		double inverseDistance = 1.0 / rij;
+
+		u[0] = particles.position[0][j] - particles.position[0][i];
+		u[1] = particles.position[1][j] - particles.position[1][i];
+		u[2] = particles.position[2][j] - particles.position[2][i];
+
+		box.ApplyMinimumImage(u[0], u[1], u[2]);
+
+		u[0] *= inverseDistance;
+		u[1] *= inverseDistance;
+		u[2] *= inverseDistance;
 	}
 
-	std::tuple<math::Vec3, math::Vec3, math::Vec3> GetGDirectionAngle(const math::Vec3 &position1, const math::Vec3 &position2, const math::Vec3 &position3, double r21, double r23) {
-		math::Vec3 u21 = GetUij(position2, position1, r21);
-		math::Vec3 u23 = GetUij(position2, position3, r23);
-		math::Vec3 cp = GetUcp(u21, u23);
-		math::Vec3 gDir1 = GetUcp(u21, cp) / r21;
-		math::Vec3 gDir3 = GetUcp(cp, u23) / r23;
-		math::Vec3 gDir2 = (math::Vec3(gDir1) + math::Vec3(gDir3)) * -1.0;
-		return std::make_tuple(gDir1, gDir2, gDir3);
+	static inline double GetBondedDp(const double *u, const double *v) {
+		return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
 	}
 
-	std::tuple<math::Vec3, math::Vec3, math::Vec3, math::Vec3> GetGDirectionTorsion(const math::Vec3 &position1, const math::Vec3 &position2, const math::Vec3 &position3, const math::Vec3 &position4, double r12, double r23, double r34) {
-		math::Vec3 u21 = GetUij(position2, position1, r12);
-		math::Vec3 u34 = GetUij(position3, position4, r34);
-		math::Vec3 u23 = GetUij(position2, position3, r23);
-		math::Vec3 u32 = math::Vec3(u23) * -1.0;
-		double a123 = GetAijk(position1, position2, position3, r12, r23);
-		double a432 = GetAijk(position4, position3, position2, r34, r23);
-		double s123 = sin(DEGREES_TO_RADIANS * a123);
-		double s432 = sin(DEGREES_TO_RADIANS * a432);
-		double c123 = cos(DEGREES_TO_RADIANS * a123);
-		double c432 = cos(DEGREES_TO_RADIANS * a432);
-		math::Vec3 gDir1 = GetUcp(u21, u23) / (r12 * s123);
-		math::Vec3 gDir4 = GetUcp(u34, u32) / (r34 * s432);
-		math::Vec3 gDir2 = math::Vec3(gDir1) * (r12 / r23 * c123 - 1.0) - math::Vec3(gDir4) * (r34 / r23 * c432);
-		math::Vec3 gDir3 = math::Vec3(gDir4) * (r34 / r23 * c432 - 1.0) - math::Vec3(gDir1) * (r12 / r23 * c123);
-		return std::make_tuple(gDir1, gDir2, gDir3, gDir4);
+	static inline void GetBondedCp(double *cp, const double *u, const double *v) {
+		cp[0] = u[1] * v[2] - u[2] * v[1];
+		cp[1] = u[2] * v[0] - u[0] * v[2];
+		cp[2] = u[0] * v[1] - u[1] * v[0];
 	}
 
-	std::tuple<math::Vec3, math::Vec3, math::Vec3, math::Vec3> GetGDirectionOutOfPlane(const math::Vec3 &position1, const math::Vec3 &position2, const math::Vec3 &position3, const math::Vec3 &position4, double degrees, double r31, double r32, double r34) {
-		math::Vec3 u31 = GetUij(position3, position1, r31);
-		math::Vec3 u32 = GetUij(position3, position2, r32);
-		math::Vec3 u34 = GetUij(position3, position4, r34);
-		math::Vec3 cp3234 = GetCp(u32, u34);
-		math::Vec3 cp3431 = GetCp(u34, u31);
-		math::Vec3 cp3132 = GetCp(u31, u32);
-		double a132 = GetAijk(position1, position3, position2);
-		double s132 = sin(DEGREES_TO_RADIANS * a132);
-		double c132 = cos(DEGREES_TO_RADIANS * a132);
-		double cOOP = cos(DEGREES_TO_RADIANS * degrees);
-		double tOOP = tan(DEGREES_TO_RADIANS * degrees);
-		math::Vec3 gDir1 = ((math::Vec3(u31) - math::Vec3(u32) * c132)) * (1.0 / r31) * (math::Vec3(cp3234) / (cOOP * s132) - (pow(tOOP / s132, 2)));
-		math::Vec3 gDir2 = ((math::Vec3(cp3431) / (cOOP * s132) - (pow(tOOP / s132, 2)) - (math::Vec3(u32) - math::Vec3(u31) * c132)) * (1.0 / r32));
-		math::Vec3 gDir4 = ((cp3132 / (cOOP * s132) - (u34 * tOOP)) * (1.0 / r34));
-		math::Vec3 gDir3 = (math::Vec3(gDir1) + math::Vec3(gDir2) + math::Vec3(gDir4)) * -1.0;
-		return std::make_tuple(gDir1, gDir2, gDir3, gDir4);
+	static inline void AddBondedGradient(std::vector<math::Vec3> &gradient, int i, const double *direction, double magnitude) {
+		gradient[i] += math::Vec3(direction[0] * magnitude, direction[1] * magnitude, direction[2] * magnitude);
 	}
 
-	void CalculateGBonds(std::vector<math::Vec3> &gBonds, const std::vector<Bond *> &bonds, const std::vector<Atom *> &atoms) {
-		std::fill(gBonds.begin(), gBonds.end(), 0);
+	/* Runs kernel(n), which adds the gradient of term n and returns its energy, for every term. The terms of one color share no atom,
+	   so each color is split over the threads without conflicting writes; every atom then receives its contributions in color order and
+	   the energies are summed in term order, which keeps the result independent of the number of threads. */
+	template <typename Kernel>
+	static double AccumulateBondedTerms(int nterms, const std::vector<int> &colorOffsets, Kernel kernel) {
+		std::vector<double> energies(nterms);
+
+		if (colorOffsets.empty()) {
+			for (int n = 0; n < nterms; n++) {
+				energies[n] = kernel(n);
+			}
+		} else {
+			int ncolors = colorOffsets.size() - 1;
+
+#pragma omp parallel
+			for (int c = 0; c < ncolors; c++) {
+#pragma omp for schedule(static)
+				for (int n = colorOffsets[c]; n < colorOffsets[c + 1]; n++) {
+					energies[n] = kernel(n);
+				}
+			}
+		}
+
+		double energy = 0.0;
 
-		for (Bond *bond : bonds) {
-			bond->CalculateGradientMagnitude();
-			math::Vec3 p1 = atoms[bond->atom1]->position;
-			math::Vec3 p2 = atoms[bond->atom2]->position;
-			std::tuple<math::Vec3, math::Vec3> directions = GetGDirectionInteraction(p1, p2, bond->distance);
-			math::Vec3 dir1 = std::get<0>(directions);
-			math::Vec3 dir2 = std::get<1>(directions);
-			gBonds[bond->atom1] += dir1 * bond->gradientMagnitude;
-			gBonds[bond->atom2] += dir2 * bond->gradientMagnitude;
+		for (int n = 0; n < nterms; n++) {
+			energy += energies[n];
 		}
+
+		return energy;
+	}
+
+	void CalculateEGBonds(std::vector<math::Vec3> &gBonds, double &eBonds, BondTable &bonds, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box) {
+		std::fill(gBonds.begin(), gBonds.end(), 0);
+
+		eBonds = AccumulateBondedTerms(bonds.GetSize(), bonds.colorOffsets, [&](int n) {
+			int atom1 = bonds.atom1[n];
+			int atom2 = bonds.atom2[n];
+			double r12 = bondGraph.GetLength(bonds.graphIndex[n]);
+
+			bonds.distance[n] = r12;
+			double energy = GetEBond(r12, bonds.equilibriumDistance[n], bonds.springConstant[n]);
+
+			/* The gradient direction of atom 1 is the unit vector from atom 2 to atom 1. */
+			double u21[3];
+			GetBondedUij(u21, particles, box, atom2, atom1, r12);
+
+			double gradientMagnitude = GetGMagnitudeBond(r12, bonds.equilibriumDistance[n], bonds.springConstant[n]);
+
+			AddBondedGradient(gBonds, atom1, u21, gradientMagnitude);
+			AddBondedGradient(gBonds, atom2, u21, -gradientMagnitude);
+
+			return energy;
+		});
 	}
 
-	void CalculateGAngles(std::vector<math::Vec3> &gAngles, const std::vector<Angle *> &angles, const std::vector<Atom *> atoms, std::map<int, std::map<int, double>> &bondGraph) {
+	void CalculateEGAngles(std::vector<math::Vec3> &gAngles, double &eAngles, AngleTable &angles, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box) {
 		std::fill(gAngles.begin(), gAngles.end(), 0);
 
-		for (Angle *angle : angles) {
-			angle->CalculateGradientMagnitude();
-			math::Vec3 p1 = atoms[angle->atom1]->position;
-			math::Vec3 p2 = atoms[angle->atom2]->position;
-			math::Vec3 p3 = atoms[angle->atom3]->position;
-			double r12 = bondGraph[angle->atom1][angle->atom2];
-			double r23 = bondGraph[angle->atom2][angle->atom3];
-			std::tuple<math::Vec3, math::Vec3, math::Vec3> directions = GetGDirectionAngle(p1, p2, p3, r12, r23);
-			math::Vec3 dir1 = std::get<0>(directions);
-			math::Vec3 dir2 = std::get<1>(directions);
-			math::Vec3 dir3 = std::get<2>(directions);
-			gAngles[angle->atom1] += dir1 * angle->gradientMagnitude;
-			gAngles[angle->atom2] += dir2 * angle->gradientMagnitude;
-			gAngles[angle->atom3] += dir3 * angle->gradientMagnitude;
-		}
+		eAngles = AccumulateBondedTerms(angles.GetSize(), angles.colorOffsets, [&](int n) {
+			int atom1 = angles.atom1[n];
+			int atom2 = angles.atom2[n];
+			int atom3 = angles.atom3[n];
+			double r12 = bondGraph.GetLength(angles.bond12[n]);
+			double r23 = bondGraph.GetLength(angles.bond23[n]);
+
+			double u21[3];
+			double u23[3];
+			GetBondedUij(u21, particles, box, atom2, atom1, r12);
+			GetBondedUij(u23, particles, box, atom2, atom3, r23);
+
+			double c123 = std::max(-1.0, std::min(1.0, GetBondedDp(u21, u23)));
+			double s123 = sqrt(1.0 - c123 * c123);
+			double degrees = RADIANS_TO_DEGREES * acos(c123);
+
+			angles.degrees[n] = degrees;
+			double energy = GetEAngle(degrees, angles.equilibriumDegrees[n], angles.springConstant[n]);
+
+			/* Collinear atoms have no defined bending direction. */
+			if (!s123) return energy;
+
+			/* d(theta)/d(r1) = (u21 cos(theta) - u23) / (r12 sin(theta)) and likewise for atom 3. */
+			double gradientMagnitude = GetGMagnitudeAngle(degrees, angles.equilibriumDegrees[n], angles.springConstant[n]);
+			double scale1 = gradientMagnitude / (r12 * s123);
+			double scale3 = gradientMagnitude / (r23 * s123);
+
+			double dir1[3];
+			double dir2[3];
+			double dir3[3];
+
+			for (int d = 0; d < 3; d++) {
+				dir1[d] = (u21[d] * c123 - u23[d]) * scale1;
+				dir3[d] = (u23[d] * c123 - u21[d]) * scale3;
+				dir2[d] = -dir1[d] - dir3[d];
+			}
+
+			AddBondedGradient(gAngles, atom1, dir1, 1.0);
+			AddBondedGradient(gAngles, atom2, dir2, 1.0);
+			AddBondedGradient(gAngles, atom3, dir3, 1.0);
+
+			return energy;
+		});
 	}
 
-	void CalculateGTorsions(std::vector<math::Vec3> &gTorsions, const std::vector<Torsion *> &torsions, const std::vector<Atom *> atoms, std::map<int, std::map<int, double>> &bondGraph) {
+	void CalculateEGTorsions(std::vector<math::Vec3> &gTorsions, double &eTorsions, TorsionTable &torsions, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box) {
 		std::fill(gTorsions.begin(), gTorsions.end(), 0);
 
-		for (Torsion *torsion : torsions) {
-			torsion->CalculateGradientMagnitude();
-			math::Vec3 p1 = atoms[torsion->atom1]->position;
-			math::Vec3 p2 = atoms[torsion->atom2]->position;
-			math::Vec3 p3 = atoms[torsion->atom3]->position;
-			math::Vec3 p4 = atoms[torsion->atom4]->position;
-			double r12 = bondGraph[torsion->atom1][torsion->atom2];
-			double r23 = bondGraph[torsion->atom2][torsion->atom3];
-			double r34 = bondGraph[torsion->atom3][torsion->atom4];
-			std::tuple<math::Vec3, math::Vec3, math::Vec3, math::Vec3> directions = GetGDirectionTorsion(p1, p2, p3, p4, r12, r23, r34);
-			math::Vec3 dir1 = std::get<0>(directions);
-			math::Vec3 dir2 = std::get<1>(directions);
-			math::Vec3 dir3 = std::get<2>(directions);
-			math::Vec3 dir4 = std::get<3>(directions);
-			gTorsions[torsion->atom1] += dir1 * torsion->gradientMagnitude;
-			gTorsions[torsion->atom2] += dir2 * torsion->gradientMagnitude;
-			gTorsions[torsion->atom3] += dir3 * torsion->gradientMagnitude;
-			gTorsions[torsion->atom4] += dir4 * torsion->gradientMagnitude;
-		}
+		eTorsions = AccumulateBondedTerms(torsions.GetSize(), torsions.colorOffsets, [&](int n) {
+			int atom1 = torsions.atom1[n];
+			int atom2 = torsions.atom2[n];
+			int atom3 = torsions.atom3[n];
+			int atom4 = torsions.atom4[n];
+			double r12 = bondGraph.GetLength(torsions.bond12[n]);
+			double r23 = bondGraph.GetLength(torsions.bond23[n]);
+			double r34 = bondGraph.GetLength(torsions.bond34[n]);
+
+			double u21[3];
+			double u23[3];
+			double u34[3];
+			GetBondedUij(u21, particles, box, atom2, atom1, r12);
+			GetBondedUij(u23, particles, box, atom2, atom3, r23);
+			GetBondedUij(u34, particles, box, atom3, atom4, r34);
+
+			/* Cosines and sines of the bond angles 1-2-3 and 4-3-2, with u32 = -u23. */
+			double c123 = std::max(-1.0, std::min(1.0, GetBondedDp(u21, u23)));
+			double c432 = std::max(-1.0, std::min(1.0, -GetBondedDp(u34, u23)));
+			double s123 = sqrt(1.0 - c123 * c123);
+			double s432 = sqrt(1.0 - c432 * c432);
+
+			/* Plane normals n123 = u21 x u23 and n234 = u23 x u34, unnormalized; the dihedral follows GetTijkl. */
+			double n123[3];
+			double n234[3];
+			GetBondedCp(n123, u21, u23);
+			GetBondedCp(n234, u23, u34);
+
+			double cosine = 0.0;
+
+			if (s123 && s432) {
+				cosine = std::max(-1.0, std::min(1.0, -GetBondedDp(n123, n234) / (s123 * s432)));
+			}
+
+			double sign = (GetBondedDp(n123, u34) <= 0.0 ? 1.0 : -1.0);
+			double degrees = RADIANS_TO_DEGREES * sign * acos(cosine);
+
+			torsions.degrees[n] = degrees;
+			double energy = GetETorsion(degrees, torsions.halfBarrierHeight[n], torsions.barrierOffset[n], torsions.barrierFrequency[n], torsions.paths[n]);
+
+			/* A torsion over a linear bond angle has no defined dihedral and no gradient. */
+			if (!s123 || !s432) return energy;
+
+			double gradientMagnitude = GetGMagnitudeTorsion(degrees, torsions.halfBarrierHeight[n], torsions.barrierOffset[n], torsions.barrierFrequency[n], torsions.paths[n]);
+			double scale1 = gradientMagnitude / (r12 * s123 * s123);
+			double scale4 = gradientMagnitude / (r34 * s432 * s432);
+			double scale21 = r12 / r23 * c123;
+			double scale34 = r34 / r23 * c432;
+
+			/* Atoms 1 and 4 move along the normals of their planes; atoms 2 and 3 balance them, so the four directions sum to zero. */
+			double dir1[3];
+			double dir2[3];
+			double dir3[3];
+			double dir4[3];
+
+			for (int d = 0; d < 3; d++) {
+				dir1[d] = n123[d] * scale1;
+				dir4[d] = n234[d] * scale4;
+				dir2[d] = dir1[d] * (scale21 - 1.0) - dir4[d] * scale34;
+				dir3[d] = dir4[d] * (scale34 - 1.0) - dir1[d] * scale21;
+			}
+
+			AddBondedGradient(gTorsions, atom1, dir1, 1.0);
+			AddBondedGradient(gTorsions, atom2, dir2, 1.0);
+			AddBondedGradient(gTorsions, atom3, dir3, 1.0);
+			AddBondedGradient(gTorsions, atom4, dir4, 1.0);
+
+			return energy;
+		});
 	}
 
-	void CalculateGOutOfPlanes(std::vector<math::Vec3> &gOutOfPlanes, const std::vector<OutOfPlane *> &outOfPlanes, const std::vector<Atom *> atoms, std::map<int, std::map<int, double>> &bondGraph) {
+	void CalculateEGOutOfPlanes(std::vector<math::Vec3> &gOutOfPlanes, double &eOutOfPlanes, OutOfPlaneTable &outOfPlanes, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box) {
 		std::fill(gOutOfPlanes.begin(), gOutOfPlanes.end(), 0);
 
-		for (OutOfPlane *outOfPlane : outOfPlanes) {
-			outOfPlane->CalculateGradientMagnitude();
-			math::Vec3 p1 = atoms[outOfPlane->atom1]->position;
-			math::Vec3 p2 = atoms[outOfPlane->atom2]->position;
-			math::Vec3 p3 = atoms[outOfPlane->atom3]->position;
-			math::Vec3 p4 = atoms[outOfPlane->atom4]->position;
-			double r31 = bondGraph[outOfPlane->atom3][outOfPlane->atom1];
-			double r32 = bondGraph[outOfPlane->atom3][outOfPlane->atom2];
-			double r34 = bondGraph[outOfPlane->atom3][outOfPlane->atom4];
-			std::tuple<math::Vec3, math::Vec3, math::Vec3, math::Vec3> directions = GetGDirectionOutOfPlane(p1, p2, p3, p4, outOfPlane->degrees, r31, r32, r34);
-			math::Vec3 dir1 = std::get<0>(directions);
-			math::Vec3 dir2 = std::get<1>(directions);
-			math::Vec3 dir3 = std::get<2>(directions);
-			math::Vec3 dir4 = std::get<3>(directions);
-			gOutOfPlanes[outOfPlane->atom1] += dir1 * outOfPlane->gradientMagnitude;
-			gOutOfPlanes[outOfPlane->atom2] += dir2 * outOfPlane->gradientMagnitude;
-			gOutOfPlanes[outOfPlane->atom3] += dir3 * outOfPlane->gradientMagnitude;
-			gOutOfPlanes[outOfPlane->atom4] += dir4 * outOfPlane->gradientMagnitude;
-		}
+		eOutOfPlanes = AccumulateBondedTerms(outOfPlanes.GetSize(), outOfPlanes.colorOffsets, [&](int n) {
+			int atom1 = outOfPlanes.atom1[n];
+			int atom2 = outOfPlanes.atom2[n];
+			int atom3 = outOfPlanes.atom3[n];
+			int atom4 = outOfPlanes.atom4[n];
+			double r31 = bondGraph.GetLength(outOfPlanes.bond31[n]);
+			double r32 = bondGraph.GetLength(outOfPlanes.bond32[n]);
+			double r34 = bondGraph.GetLength(outOfPlanes.bond34[n]);
+
+			double u31[3];
+			double u32[3];
+			double u34[3];
+			GetBondedUij(u31, particles, box, atom3, atom1, r31);
+			GetBondedUij(u32, particles, box, atom3, atom2, r32);
+			GetBondedUij(u34, particles, box, atom3, atom4, r34);
+
+			double c132 = std::max(-1.0, std::min(1.0, GetBondedDp(u31, u32)));
+			double s132 = sqrt(1.0 - c132 * c132);
+
+			/* The angle of bond 3-4 with the plane 1-3-2, as in GetOijkl. */
+			double n132[3];
+			GetBondedCp(n132, u31, u32);
+
+			double sine = 0.0;
+
+			if (s132) {
+				sine = std::max(-1.0, std::min(1.0, GetBondedDp(n132, u34) / s132));
+			}
+
+			double degrees = RADIANS_TO_DEGREES * asin(sine);
+
+			outOfPlanes.degrees[n] = degrees;
+			double energy = GetEOutOfPlane(degrees, outOfPlanes.halfBarrierHeight[n]);
+
+			double cOOP = sqrt(1.0 - sine * sine);
+
+			if (!s132 || !cOOP) return energy;
+
+			/* Wilson's out-of-plane bending directions. */
+			double n234[3];
+			double n341[3];
+			GetBondedCp(n234, u32, u34);
+			GetBondedCp(n341, u34, u31);
+
+			double tOOP = sine / cOOP;
+			double normalScale = 1.0 / (cOOP * s132);
+			double planeScale = tOOP / (s132 * s132);
+
+			double gradientMagnitude = GetGMagnitudeOutOfPlane(degrees, outOfPlanes.halfBarrierHeight[n]);
+			double scale1 = gradientMagnitude / r31;
+			double scale2 = gradientMagnitude / r32;
+			double scale4 = gradientMagnitude / r34;
+
+			double dir1[3];
+			double dir2[3];
+			double dir3[3];
+			double dir4[3];
+
+			for (int d = 0; d < 3; d++) {
+				dir1[d] = (n234[d] * normalScale - (u31[d] - u32[d] * c132) * planeScale) * scale1;
+				dir2[d] = (n341[d] * normalScale - (u32[d] - u31[d] * c132) * planeScale) * scale2;
+				dir4[d] = (n132[d] * normalScale - u34[d] * tOOP) * scale4;
+				dir3[d] = -dir1[d] - dir2[d] - dir4[d];
+			}
+
+			AddBondedGradient(gOutOfPlanes, atom1, dir1, 1.0);
+			AddBondedGradient(gOutOfPlanes, atom2, dir2, 1.0);
+			AddBondedGradient(gOutOfPlanes, atom3, dir3, 1.0);
+			AddBondedGradient(gOutOfPlanes, atom4, dir4, 1.0);
+
+			return energy;
+		});
+	}
+
+	/* Adds the energies, gradients and virial of one pair, with (a, b, c) = position i - position j. */
+	static inline void AccumulateEGNonBondedIJ(std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, double &eVDW, double &eElst, double &virial,
+		const ParticleStore &particles, int i, int j, double a, double b, double c, double r2, double dielectric, double vdwScale, double elstScale) {
+
+		double distance = sqrt(r2);
+		double inverseDistance = 1.0 / distance;
+
+		const VanDerWaalsPair &vdwPair = particles.GetVanDerWaalsPair(i, j);
+
+		/* Same terms as GetEVDWIJ/GetGMagnitudeVDWIJ and GetEElstIJ/GetGMagnitudeElstIJ, sharing the powers of r. */
+		double inverseR2 = inverseDistance * inverseDistance;
+		double inverseR6 = inverseR2 * inverseR2 * inverseR2;
+		double inverseR12 = inverseR6 * inverseR6;
+
+		double eVDWIJ = vdwScale * (vdwPair.c12 * inverseR12 - vdwPair.c6 * inverseR6);
+		double gVDWMagnitude = vdwScale * (-12.0 * vdwPair.c12 * inverseR12 + 6.0 * vdwPair.c6 * inverseR6) * inverseDistance;
+
+		double eElstIJ = elstScale * CEU_TO_KCAL * particles.charge[i] * particles.charge[j] * inverseDistance / dielectric;
+		double gElstMagnitude = -eElstIJ * inverseDistance;
 
+		eVDW += eVDWIJ;
+		eElst += eElstIJ;
+		virial -= (gVDWMagnitude + gElstMagnitude) * distance;
+
+		/* The gradient direction of atom i is the unit vector from j to i. */
+		math::Vec3 direction(a * inverseDistance, b * inverseDistance, c * inverseDistance);
+
+		gVDW[i] += direction * gVDWMagnitude;
+		gVDW[j] += direction * -gVDWMagnitude;
+		gElst[i] += direction * gElstMagnitude;
+		gElst[j] += direction * -gElstMagnitude;
 	}
 
-	void CalculateGNonBonded(std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, const std::vector<Atom *> &atoms, const std::vector<std::pair<int, int>> &nonInts, double dielectric) {
+	void CalculateEGNonBonded(std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, double &eVDW, double &eElst, double &virial, const ParticleStore &particles, const NeighborList &neighborList, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale, const NonBondedSettings &settings, NonBondedWorkspace *workspace) {
 		std::fill(gVDW.begin(), gVDW.end(), 0);
 		std::fill(gElst.begin(), gElst.end(), 0);
 
-		int natoms = atoms.size();
+		eVDW = 0.0;
+		eElst = 0.0;
+		virial = 0.0;
+
+		NonBondedWorkspace localWorkspace;
+		NonBondedWorkspace &usedWorkspace = workspace ? *workspace : localWorkspace;
 
-		utils::IterationMatrix matrix(utils::CombinationsNR(natoms, 2), 2);
+		double ewaldCoefficient = 0.0;
+
+		if (settings.electrostatics == ElectrostaticsMethod::PME) {
+			ewaldCoefficient = GetEwaldCoefficient(GetEwaldRealSpaceCutoff(settings, neighborList), settings.ewaldTolerance);
+		}
 
-		utils::CombinationKN(matrix, 2, natoms);
+		AccumulateEGNonBondedPairs(settings, usedWorkspace, gVDW, gElst, eVDW, eElst, virial, particles, neighborList, exclusions, dielectric, ewaldCoefficient);
 
-#ifdef PS_OPTIMIZED
-#pragma omp parallel for
-#endif
-		for (int n = 0; n < utils::CombinationsNR(natoms, 2); n++) {
-			int i = matrix(n, 0);
-			int j = matrix(n, 1);
+		if (settings.electrostatics == ElectrostaticsMethod::PME) {
+			usedWorkspace.pme.Setup(settings.box, settings.pmeGridSpacing, settings.pmeOrder);
+
+			eElst += usedWorkspace.pme.CalculateReciprocal(gElst, virial, particles, ewaldCoefficient, dielectric);
+			eElst += CalculateEwaldCorrections(gElst, virial, particles, exclusions, ewaldCoefficient, dielectric, settings.box);
+		}
+
+		CalculateEGNonBonded14(gVDW, gElst, eVDW, eElst, virial, particles, exclusions, dielectric, vdw14Scale, elst14Scale, settings.box);
+	}
 
-			if (std::find(nonInts.begin(), nonInts.end(), std::make_pair(i, j)) != nonInts.end()) continue;
+	void CalculateEGNonBonded14(std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, double &eVDW, double &eElst, double &virial, const ParticleStore &particles, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale, const PeriodicBox &box) {
+		const double *x = particles.position[0].data();
+		const double *y = particles.position[1].data();
+		const double *z = particles.position[2].data();
 
-			Atom *atom1 = atoms[i];
-			Atom *atom2 = atoms[j];
+		/* 1-4 pairs are always evaluated, independent of the cutoff, and keep their scaled plain Coulomb term. */
+		const std::vector<int> &pairs14 = exclusions.GetPairs14();
 
-			double distance = GetRij(atom1->position, atom2->position);
-			std::tuple<math::Vec3, math::Vec3> directions = GetGDirectionInteraction(atom1->position, atom2->position, distance);
-			math::Vec3 dir1 = std::get<0>(directions);
-			math::Vec3 dir2 = std::get<1>(directions);
+		for (int n = 0; n < (int)pairs14.size(); n += 2) {
+			int i = pairs14[n];
+			int j = pairs14[n + 1];
 
-			double vdwAttractionMagnitudeIJ = sqrt(atom1->vdwAttractionMagnitude) * sqrt(atom2->vdwAttractionMagnitude);
-			double vdwRadiusIJ = atom1->vdwRadius + atom2->vdwRadius;
+			double a = x[i] - x[j];
+			double b = y[i] - y[j];
+			double c = z[i] - z[j];
 
-			double gElstMagnitude = GetGMagnitudeElstIJ(distance, atom1->charge, atom2->charge, dielectric);
-			double gVDWMagnitude = GetGMagnitudeVDWIJ(distance, vdwAttractionMagnitudeIJ, vdwRadiusIJ);
+			box.ApplyMinimumImage(a, b, c);
 
-			gVDW[i] += math::Vec3(dir1) * gVDWMagnitude;
-			gVDW[j] += math::Vec3(dir2) * gVDWMagnitude;
-			gElst[i] += math::Vec3(dir1) * gElstMagnitude;
-			gElst[j] += math::Vec3(dir2) * gElstMagnitude;
+			AccumulateEGNonBondedIJ(gVDW, gElst, eVDW, eElst, virial, particles, i, j, a, b, c, a * a + b * b + c * c, dielectric, vdw14Scale, elst14Scale);
 		}
 	}
 
-	void CalculateGBound(std::vector<math::Vec3> &gBound, const std::vector<Atom *> &atoms, double kBox, double bound, const math::Vec3 &origin, const String &boundType) {
+	void CalculateGBound(std::vector<math::Vec3> &gBound, const ParticleStore &particles, double kBox, double bound, const math::Vec3 &origin, const String &boundType) {
 		std::fill(gBound.begin(), gBound.end(), 0);
 
-		int i = 0;
-		for (Atom *atom : atoms) {
-			gBound[i] += GetGMagnitudeBoundI(kBox, bound, atom->position, origin, boundType);
-			i++;
+		for (int i = 0; i < particles.GetSize(); i++) {
+			gBound[i] += GetGMagnitudeBoundI(kBox, bound, particles.GetPosition(i), origin, boundType);
 		}
 	}
 
-	double GetVirial(std::vector<math::Vec3> &gTotal, const std::vector<Atom *> &atoms) {
+	double GetVirial(std::vector<math::Vec3> &gradient, const ParticleStore &particles) {
 		double virial = 0.0;
 
-		int i = 0;
-		for (Atom *atom : atoms) {
-			virial += gTotal[i].x;
-			virial += gTotal[i].y;
-			virial += gTotal[i].z;
-			i++;
+		for (int j = 0; j < 3; j++) {
+			for (int i = 0; i < particles.GetSize(); i++) {
+				virial -= particles.position[j][i] * gradient[i][j];
+			}
 		}
 
 		return virial;
 	}
 
-	double GetPressure(const std::vector<Atom *> &atoms, double temperature, double virial, double volume) {
-		return KCAL_A_MOL_TO_PA * (atoms.size() * BOLTZMANN_CONSTANT * temperature + virial / 3) / volume;
+	double GetPressure(const ParticleStore &particles, double temperature, double virial, double volume) {
+		return KCAL_A_MOL_TO_PA * (particles.GetSize() * BOLTZMANN_CONSTANT * temperature + virial / 3) / volume;
 	}
 
 }
\ No newline at end of file
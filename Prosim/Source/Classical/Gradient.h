@@ -1,10 +1,12 @@
 #pragma once
 
-#include "Angle.h"
-#include "Atom.h"
-#include "Bond.h"
-#include "OutOfPlane.h"
-#include "Torsion.h"
+#include "BondGraph.h"
+#include "BondedTables.h"
+#include "ExclusionTable.h"
+#include "NeighborList.h"
+#include "NonBondedKernel.h"
+#include "ParticleStore.h"
+#include "PeriodicBox.h"
 
 #include "Math/PSMath.h"
 #include "Utils/String.h"
@@ -18,17 +20,21 @@ namespace classical {
 	double GetGMagnitudeVDWIJ(double rij, double epsij, double roij);
 	double GetGMagnitudeElstIJ(double rij, double qi, double qj, double epsilon);
 	math::Vec3 GetGMagnitudeBoundI(double kBox, double bound, const math::Vec3 &position, const math::Vec3 &origin, const String &boundType);
-	std::pair<math::Vec3, math::Vec3> GetGDirectionInteraction(const math::Vec3 &position1, const math::Vec3 &position2, double r12 = -1);
-	std::tuple<math::Vec3, math::Vec3, math::Vec3> GetGDirectionAngle(const math::Vec3 &position1, const math::Vec3 &position2, const math::Vec3 &position3, double r21 = -1, double r23 = -1);
-	std::tuple<math::Vec3, math::Vec3, math::Vec3, math::Vec3> GetGDirectionTorsion(const math::Vec3 &position1, const math::Vec3 &position2, const math::Vec3 &position3, const math::Vec3 &position4, double r12 = -1, double r23 = -1, double r34 = -1);
-	std::tuple<math::Vec3, math::Vec3, math::Vec3, math::Vec3> GetGDirectionOutOfPlane(const math::Vec3 &position1, const math::Vec3 &position2, const math::Vec3 &position3, const math::Vec3 &position4, double degrees, double r31 = -1, double r32 = -1, double r34 = -1);
-	void CalculateGBonds(std::vector<math::Vec3> &gBonds, const std::vector<Bond *> &bonds, const std::vector<Atom *> &atoms);
-	void CalculateGAngles(std::vector<math::Vec3> &gAngles, const std::vector<Angle *> &angles, const std::vector<Atom *> atoms, std::map<int, std::map<int, double>> &bondGraph);
-	void CalculateGTorsions(std::vector<math::Vec3> &gTorsions, const std::vector<Torsion *> &torsions, const std::vector<Atom *> atoms, std::map<int, std::map<int, double>> &bondGraph);
-	void CalculateGOutOfPlanes(std::vector<math::Vec3> &gOutOfPlanes, const std::vector<OutOfPlane *> &outOfPlanes, const std::vector<Atom *> atoms, std::map<int, std::map<int, double>> &bondGraph);
-	void CalculateGNonBonded(std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, const std::vector<Atom *> &atoms, const std::vector<std::pair<int, int>> &nonInts, double dielectric);
-	void CalculateGBound(std::vector<math::Vec3> &gBound, const std::vector<Atom *> &atoms, double kBox, double bound, const math::Vec3 &origin, const String &boundType);
-	double GetVirial(std::vector<math::Vec3> &gTotal, const std::vector<Atom *> &atoms);
-	double GetPressure(const std::vector<Atom *> &atoms, double temperature, double virial, double volume);
+	/* Fused bonded passes: the geometry of every term is evaluated once and gives its internal coordinate, which is stored in the table,
+	   its energy and its gradient. The bond lengths are taken from bondGraph and must be current; bond vectors are taken
+	   between nearest images in a periodic box. */
+	void CalculateEGBonds(std::vector<math::Vec3> &gBonds, double &eBonds, BondTable &bonds, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box);
+	void CalculateEGAngles(std::vector<math::Vec3> &gAngles, double &eAngles, AngleTable &angles, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box);
+	void CalculateEGTorsions(std::vector<math::Vec3> &gTorsions, double &eTorsions, TorsionTable &torsions, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box);
+	void CalculateEGOutOfPlanes(std::vector<math::Vec3> &gOutOfPlanes, double &eOutOfPlanes, OutOfPlaneTable &outOfPlanes, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box);
+	/* One pass over the non-bonded pairs producing both energies, both gradients and the pair virial sum(r_ij . f_ij).
+	   With PME the electrostatic terms also include the reciprocal sum and the Ewald corrections. */
+	void CalculateEGNonBonded(std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, double &eVDW, double &eElst, double &virial, const ParticleStore &particles, const NeighborList &neighborList, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale, const NonBondedSettings &settings = NonBondedSettings(), NonBondedWorkspace *workspace = nullptr);
+	/* Adds the energies, gradients and virial of the scaled 1-4 pairs only; CalculateEGNonBonded includes them. */
+	void CalculateEGNonBonded14(std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, double &eVDW, double &eElst, double &virial, const ParticleStore &particles, const ExclusionTable &exclusions, double dielectric, double vdw14Scale, double elst14Scale, const PeriodicBox &box);
+	void CalculateGBound(std::vector<math::Vec3> &gBound, const ParticleStore &particles, double kBox, double bound, const math::Vec3 &origin, const String &boundType);
+	/* Virial sum(r_i . f_i) of a gradient; only meaningful for terms that do not depend on the origin of coordinates. */
+	double GetVirial(std::vector<math::Vec3> &gradient, const ParticleStore &particles);
+	double GetPressure(const ParticleStore &particles, double temperature, double virial, double volume);
 
 }
\ No newline at end of file
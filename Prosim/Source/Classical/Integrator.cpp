@@ -0,0 +1,410 @@
+#include "Integrator.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <iostream>
+
+#include "Constants.h"
+
+#include "Math/Philox.h"
+
+namespace classical {
+
+	/* Philox stream of the Langevin random forces; the initial velocities use stream 0. */
+	static const uint32_t s_langevinStream = 1;
+
+	IntegratorType ResolveIntegratorType(const String &name) {
+		if (name.find("leapfrog") != String::npos) {
+			return IntegratorType::Leapfrog;
+		}
+		else if (name.find("velocity-verlet") != String::npos) {
+			return IntegratorType::VelocityVerlet;
+		}
+		else if (name.find("respa") != String::npos) {
+			return IntegratorType::RESPA;
+		}
+		else if (name.find("langevin") != String::npos) {
+			return IntegratorType::Langevin;
+		}
+		else if (name.find("nose-hoover") != String::npos) {
+			return IntegratorType::NoseHoover;
+		}
+
+		std::cout << "Unknown integrator: " << name << std::endl;
+		std::cout << "Use 'leapfrog', 'velocity-verlet', 'respa', 'langevin' or 'nose-hoover'" << std::endl;
+		return IntegratorType::Leapfrog;
+	}
+
+	String GetIntegratorTypeName(IntegratorType type) {
+		switch (type) {
+		case IntegratorType::VelocityVerlet: return "velocity-verlet";
+		case IntegratorType::RESPA: return "respa";
+		case IntegratorType::Langevin: return "langevin";
+		case IntegratorType::NoseHoover: return "nose-hoover";
+		default: return "leapfrog";
+		}
+	}
+
+	Integrator::Integrator(Molecule *molecule)
+		: m_molecule(molecule) {
+
+	}
+
+	Integrator::~Integrator() {
+
+	}
+
+	void Integrator::PositionsChanged() {
+		UpdateAccelerations();
+	}
+
+	bool Integrator::IsThermostatted() const {
+		return false;
+	}
+
+	void Integrator::UpdateAccelerations() {
+		ParticleStore &particles = m_molecule->m_particles;
+		const std::vector<math::Vec3> &gTotal = m_molecule->m_gTotal;
+		const double *mass = particles.mass.data();
+		int natoms = particles.GetSize();
+
+		for (int j = 0; j < 3; j++) {
+			double *acceleration = particles.acceleration[j].data();
+
+			for (int i = 0; i < natoms; i++) {
+				acceleration[i] = -ACCELERATION_CONVERSION * gTotal[i][j] / mass[i];
+			}
+		}
+	}
+
+	void Integrator::UpdateAccelerationsAndVelocities(double deltaTime) {
+		ParticleStore &particles = m_molecule->m_particles;
+		const std::vector<math::Vec3> &gTotal = m_molecule->m_gTotal;
+		const double *mass = particles.mass.data();
+		int natoms = particles.GetSize();
+
+		for (int j = 0; j < 3; j++) {
+			double *acceleration = particles.acceleration[j].data();
+			double *velocity = particles.velocity[j].data();
+			double *previousVelocity = particles.previousVelocity[j].data();
+
+			for (int i = 0; i < natoms; i++) {
+				acceleration[i] = -ACCELERATION_CONVERSION * gTotal[i][j] / mass[i];
+				previousVelocity[i] = velocity[i];
+				velocity[i] += acceleration[i] * deltaTime;
+			}
+		}
+	}
+
+	void Integrator::UpdateVelocitiesAndPositions(double velocityTime, double positionTime, bool updateInternals) {
+		ParticleStore &particles = m_molecule->m_particles;
+		int natoms = particles.GetSize();
+
+		m_molecule->m_constraints.SetReference(particles);
+
+		for (int j = 0; j < 3; j++) {
+			double *position = particles.position[j].data();
+			double *velocity = particles.velocity[j].data();
+			const double *acceleration = particles.acceleration[j].data();
+
+			for (int i = 0; i < natoms; i++) {
+				velocity[i] += acceleration[i] * velocityTime;
+				position[i] += velocity[i] * positionTime;
+			}
+		}
+
+		m_molecule->m_constraints.ApplyPositions(particles, positionTime);
+
+		if (updateInternals) {
+			m_molecule->UpdateInternals();
+		}
+	}
+
+	void Integrator::ConstrainVelocities() {
+		m_molecule->m_constraints.ApplyVelocities(m_molecule->m_particles);
+	}
+
+	LeapfrogIntegrator::LeapfrogIntegrator(Molecule *molecule)
+		: Integrator(molecule) {
+
+	}
+
+	void LeapfrogIntegrator::Initialize(double timeStep) {
+		/* The velocities run half a step ahead of the positions. */
+		UpdateAccelerationsAndVelocities(0.5 * timeStep);
+	}
+
+	void LeapfrogIntegrator::Step(double timeStep) {
+		UpdateVelocitiesAndPositions(0.0, timeStep);
+		m_molecule->CalculateEnergyAndGradient();
+		UpdateAccelerationsAndVelocities(timeStep);
+		m_molecule->CalculateKineticEnergy("leapfrog");
+	}
+
+	VelocityVerletIntegrator::VelocityVerletIntegrator(Molecule *molecule)
+		: Integrator(molecule) {
+
+	}
+
+	void VelocityVerletIntegrator::Initialize(double) {
+		UpdateAccelerations();
+	}
+
+	void VelocityVerletIntegrator::Step(double timeStep) {
+		/* Half kick and drift, the new forces, then the second half kick with the new accelerations. */
+		UpdateVelocitiesAndPositions(0.5 * timeStep, timeStep);
+		m_molecule->CalculateEnergyAndGradient();
+		UpdateAccelerationsAndVelocities(0.5 * timeStep);
+		ConstrainVelocities();
+		m_molecule->CalculateKineticEnergy();
+	}
+
+	RESPAIntegrator::RESPAIntegrator(Molecule *molecule, int innerSteps)
+		: Integrator(molecule), m_innerSteps(std::max(1, innerSteps)) {
+
+	}
+
+	void RESPAIntegrator::Initialize(double) {
+		m_molecule->CalculateShortRangeGradient();
+		UpdateForceGroupAccelerations(true);
+	}
+
+	void RESPAIntegrator::PositionsChanged() {
+		Initialize(0.0);
+	}
+
+	void RESPAIntegrator::Step(double timeStep) {
+		double innerTime = timeStep / m_innerSteps;
+
+		for (int s = 0; s < m_innerSteps; s++) {
+			bool first = s == 0;
+			bool last = s == m_innerSteps - 1;
+
+			/* The slow half kicks open and close the outer step around the inner velocity Verlet steps. */
+			UpdateVelocities(0.5 * innerTime, first ? 0.5 * timeStep : 0.0);
+			UpdateVelocitiesAndPositions(0.0, innerTime);
+
+			/* The full evaluation already has the bonded and boundary gradients at these positions. */
+			if (last) {
+				m_molecule->CalculateEnergyAndGradient();
+				m_molecule->SumShortRangeGradient();
+			} else {
+				m_molecule->CalculateShortRangeGradient();
+			}
+
+			UpdateForceGroupAccelerations(last);
+			UpdateVelocities(0.5 * innerTime, last ? 0.5 * timeStep : 0.0);
+			ConstrainVelocities();
+		}
+
+		m_molecule->CalculateKineticEnergy();
+	}
+
+	void RESPAIntegrator::UpdateForceGroupAccelerations(bool slow) {
+		ParticleStore &particles = m_molecule->GetParticles();
+		const std::vector<math::Vec3> &gShortRange = m_molecule->GetGShortRange();
+		const std::vector<math::Vec3> &gTotal = m_molecule->GetGTotal();
+		const double *mass = particles.mass.data();
+		int natoms = particles.GetSize();
+
+		for (int j = 0; j < 3; j++) {
+			double *acceleration = particles.acceleration[j].data();
+
+			for (int i = 0; i < natoms; i++) {
+				acceleration[i] = -ACCELERATION_CONVERSION * gShortRange[i][j] / mass[i];
+			}
+
+			if (!slow) continue;
+
+			m_slowAcceleration[j].resize(natoms);
+
+			for (int i = 0; i < natoms; i++) {
+				m_slowAcceleration[j][i] = -ACCELERATION_CONVERSION * (gTotal[i][j] - gShortRange[i][j]) / mass[i];
+			}
+		}
+	}
+
+	void RESPAIntegrator::UpdateVelocities(double fastTime, double slowTime) {
+		ParticleStore &particles = m_molecule->GetParticles();
+		int natoms = particles.GetSize();
+
+		for (int j = 0; j < 3; j++) {
+			double *velocity = particles.velocity[j].data();
+			const double *acceleration = particles.acceleration[j].data();
+			const double *slowAcceleration = m_slowAcceleration[j].data();
+
+			for (int i = 0; i < natoms; i++) {
+				velocity[i] += acceleration[i] * fastTime + slowAcceleration[i] * slowTime;
+			}
+		}
+	}
+
+	LangevinIntegrator::LangevinIntegrator(Molecule *molecule, double temperature, double friction, int seed)
+		: Integrator(molecule), m_temperature(temperature), m_friction(friction), m_seed(seed), m_step(0) {
+
+	}
+
+	void LangevinIntegrator::Initialize(double) {
+		UpdateAccelerations();
+	}
+
+	bool LangevinIntegrator::IsThermostatted() const {
+		return true;
+	}
+
+	void LangevinIntegrator::Step(double timeStep) {
+		/* B and A, O, A and the new forces, B. The first drift leaves the internal coordinates to the second. */
+		UpdateVelocitiesAndPositions(0.5 * timeStep, 0.5 * timeStep, false);
+		UpdateVelocitiesStochastic(timeStep);
+		ConstrainVelocities();
+		UpdateVelocitiesAndPositions(0.0, 0.5 * timeStep);
+		m_molecule->CalculateEnergyAndGradient();
+		UpdateAccelerationsAndVelocities(0.5 * timeStep);
+		ConstrainVelocities();
+		m_molecule->CalculateKineticEnergy();
+
+		m_step++;
+	}
+
+	void LangevinIntegrator::UpdateVelocitiesStochastic(double deltaTime) {
+		ParticleStore &particles = m_molecule->GetParticles();
+		int natoms = particles.GetSize();
+
+		double damping = exp(-m_friction * deltaTime);
+		/* kT / m in (A/ps)^2 per amu. */
+		double noiseBase = sqrt((1.0 - damping * damping) * BOLTZMANN_CONSTANT * m_temperature / KINETIC_TO_KCAL);
+
+#pragma omp parallel for
+		for (int i = 0; i < natoms; i++) {
+			double deviates[4];
+			math::GetNormalDeviates(m_seed, s_langevinStream, m_step, i, deviates);
+
+			double noise = noiseBase / sqrt(particles.mass[i]);
+
+			for (int j = 0; j < 3; j++) {
+				particles.velocity[j][i] = damping * particles.velocity[j][i] + noise * deviates[j];
+			}
+		}
+	}
+
+	NoseHooverIntegrator::NoseHooverIntegrator(Molecule *molecule, double temperature, double timeConstant, int chainLength)
+		: VelocityVerletIntegrator(molecule), m_temperature(temperature), m_timeConstant(timeConstant), m_degreesOfFreedom(0) {
+
+		m_chainPosition.assign(std::max(1, chainLength), 0.0);
+		m_chainVelocity.assign(std::max(1, chainLength), 0.0);
+		m_chainMass.assign(std::max(1, chainLength), 0.0);
+	}
+
+	void NoseHooverIntegrator::Initialize(double timeStep) {
+		VelocityVerletIntegrator::Initialize(timeStep);
+
+		/* The constraints are in place by now. */
+		m_degreesOfFreedom = 3 * m_molecule->GetNAtoms() - m_molecule->GetConstraints().GetNConstraints();
+
+		double kT = BOLTZMANN_CONSTANT * m_temperature;
+		double periodSquare = m_timeConstant * m_timeConstant;
+
+		/* Q_1 = N_f kT tau^2 and Q_k = kT tau^2, in kcal/mol ps^2. */
+		for (int k = 0; k < (int)m_chainMass.size(); k++) {
+			m_chainMass[k] = (k == 0 ? m_degreesOfFreedom : 1) * kT * periodSquare;
+		}
+	}
+
+	void NoseHooverIntegrator::Step(double timeStep) {
+		PropagateChain(0.5 * timeStep);
+		VelocityVerletIntegrator::Step(timeStep);
+		PropagateChain(0.5 * timeStep);
+		m_molecule->CalculateKineticEnergy();
+	}
+
+	bool NoseHooverIntegrator::IsThermostatted() const {
+		return true;
+	}
+
+	double NoseHooverIntegrator::GetChainEnergy() const {
+		double kT = BOLTZMANN_CONSTANT * m_temperature;
+		double energy = 0.0;
+
+		for (int k = 0; k < (int)m_chainMass.size(); k++) {
+			energy += 0.5 * m_chainMass[k] * m_chainVelocity[k] * m_chainVelocity[k];
+			energy += (k == 0 ? m_degreesOfFreedom : 1) * kT * m_chainPosition[k];
+		}
+
+		return energy;
+	}
+
+	void NoseHooverIntegrator::PropagateChain(double deltaTime) {
+		static const double s_yoshidaWeight = 1.0 / (2.0 - cbrt(2.0));
+		static const double s_yoshidaWeights[3] = { s_yoshidaWeight, 1.0 - 2.0 * s_yoshidaWeight, s_yoshidaWeight };
+
+		int chainLength = m_chainMass.size();
+		double kT = BOLTZMANN_CONSTANT * m_temperature;
+
+		m_molecule->CalculateKineticEnergy();
+
+		double eKinetic = m_molecule->GetMemberEKinetic();
+		double velocityScale = 1.0;
+
+		/* Forces G_k on the thermostat velocities. */
+		std::vector<double> force(chainLength);
+
+		force[0] = (2.0 * eKinetic - m_degreesOfFreedom * kT) / m_chainMass[0];
+
+		for (int k = 1; k < chainLength; k++) {
+			force[k] = (m_chainMass[k - 1] * m_chainVelocity[k - 1] * m_chainVelocity[k - 1] - kT) / m_chainMass[k];
+		}
+
+		for (int w = 0; w < 3; w++) {
+			double h = s_yoshidaWeights[w] * deltaTime;
+
+			/* Down the chain, the particle velocities, the thermostat positions and up the chain again. */
+			m_chainVelocity[chainLength - 1] += 0.5 * h * force[chainLength - 1];
+
+			for (int k = chainLength - 2; k >= 0; k--) {
+				double damping = exp(-0.25 * h * m_chainVelocity[k + 1]);
+
+				m_chainVelocity[k] = (m_chainVelocity[k] * damping + 0.5 * h * force[k]) * damping;
+			}
+
+			double scale = exp(-h * m_chainVelocity[0]);
+
+			velocityScale *= scale;
+			eKinetic *= scale * scale;
+
+			for (int k = 0; k < chainLength; k++) {
+				m_chainPosition[k] += h * m_chainVelocity[k];
+			}
+
+			force[0] = (2.0 * eKinetic - m_degreesOfFreedom * kT) / m_chainMass[0];
+
+			for (int k = 0; k < chainLength - 1; k++) {
+				double damping = exp(-0.25 * h * m_chainVelocity[k + 1]);
+
+				m_chainVelocity[k] = (m_chainVelocity[k] * damping + 0.5 * h * force[k]) * damping;
+				force[k + 1] = (m_chainMass[k] * m_chainVelocity[k] * m_chainVelocity[k] - kT) / m_chainMass[k + 1];
+			}
+
+			m_chainVelocity[chainLength - 1] += 0.5 * h * force[chainLength - 1];
+		}
+
+		ParticleStore &particles = m_molecule->GetParticles();
+
+		for (int j = 0; j < 3; j++) {
+			for (double &velocity : particles.velocity[j]) {
+				velocity *= velocityScale;
+			}
+		}
+	}
+
+	Integrator *CreateIntegrator(IntegratorType type, Molecule *molecule, const IntegratorSettings &settings) {
+		switch (type) {
+		case IntegratorType::VelocityVerlet: return new VelocityVerletIntegrator(molecule);
+		case IntegratorType::RESPA: return new RESPAIntegrator(molecule, settings.innerSteps);
+		case IntegratorType::Langevin: return new LangevinIntegrator(molecule, settings.temperature, settings.friction, settings.seed);
+		case IntegratorType::NoseHoover: return new NoseHooverIntegrator(molecule, settings.temperature, settings.thermostatTimeConstant, settings.chainLength);
+		default: return new LeapfrogIntegrator(molecule);
+		}
+	}
+
+}
\ No newline at end of file
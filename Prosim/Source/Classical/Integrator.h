@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Molecule.h"
+
+namespace classical {
+
+	/* Time integration schemes of the molecular dynamics loop. Leapfrog keeps the velocities half a step behind the
+	   positions and estimates the kinetic energy from the average of the two half-step velocities; velocity Verlet keeps
+	   positions and velocities at the same time. RESPA is velocity Verlet with two force groups: the short-range forces
+	   move the atoms in several inner steps per time step, the remaining non-bonded forces are only evaluated once.
+	   Langevin samples the canonical ensemble with friction and random forces, Nose-Hoover with a deterministic chain of
+	   thermostat variables. */
+	enum class IntegratorType {
+		Leapfrog,
+		VelocityVerlet,
+		RESPA,
+		Langevin,
+		NoseHoover
+	};
+
+	/* Maps "leapfrog", "velocity-verlet", "respa", "langevin" or "nose-hoover" to a scheme; anything else is reported and
+	   falls back to leapfrog. */
+	IntegratorType ResolveIntegratorType(const String &name);
+	String GetIntegratorTypeName(IntegratorType type);
+
+	/* Advances the particles of a molecule in time. Initialize is called once the energy and gradient of the starting
+	   positions are current; every Step then advances by one time step and leaves the energy, gradient and kinetic
+	   energy of the new positions current. */
+	class Integrator {
+	public:
+		Integrator(Molecule *molecule);
+		virtual ~Integrator();
+
+		virtual void Initialize(double timeStep) = 0;
+		virtual void Step(double timeStep) = 0;
+		/* Called after the positions were changed outside of Step, e.g. by a barostat, and the energy and gradient were
+		   recomputed. Updates the stored accelerations. */
+		virtual void PositionsChanged();
+		/* Whether Step couples the particles to a heat bath itself, so the velocities must not be rescaled on top. */
+		virtual bool IsThermostatted() const;
+	protected:
+		/* a = -g / m from the total gradient. */
+		void UpdateAccelerations();
+		/* a = -g / m, then v += a dt, in one pass per coordinate. The velocities before the update are kept in
+		   previousVelocity. */
+		void UpdateAccelerationsAndVelocities(double deltaTime);
+		/* v += a dtv, then x += v dtx, in one pass per coordinate. The positions are then moved back onto the molecule's
+		   constraints, with the matching velocity correction, and the internal coordinates are updated unless
+		   updateInternals is false. */
+		void UpdateVelocitiesAndPositions(double velocityTime, double positionTime, bool updateInternals = true);
+		/* Removes the velocity components along the constraints. */
+		void ConstrainVelocities();
+	protected:
+		Molecule *m_molecule;
+	};
+
+	class LeapfrogIntegrator : public Integrator {
+	public:
+		LeapfrogIntegrator(Molecule *molecule);
+
+		void Initialize(double timeStep) override;
+		void Step(double timeStep) override;
+	};
+
+	class VelocityVerletIntegrator : public Integrator {
+	public:
+		VelocityVerletIntegrator(Molecule *molecule);
+
+		void Initialize(double timeStep) override;
+		void Step(double timeStep) override;
+	};
+
+	/* Reversible multiple time stepping (Tuckerman, Berne and Martyna, J. Chem. Phys. 97, 1990 (1992)). The time step is
+	   the outer step of the non-bonded pair forces and is split into innerSteps velocity Verlet steps of the short-range
+	   bonded, boundary and 1-4 forces. The last inner step evaluates all terms, so every Step ends with the complete
+	   energy. */
+	class RESPAIntegrator : public Integrator {
+	public:
+		RESPAIntegrator(Molecule *molecule, int innerSteps);
+
+		void Initialize(double timeStep) override;
+		void Step(double timeStep) override;
+		void PositionsChanged() override;
+	private:
+		/* Accelerations of the short-range gradient into the particles and, with slow, of the rest of the total gradient
+		   into m_slowAcceleration. */
+		void UpdateForceGroupAccelerations(bool slow);
+		/* v += a_fast dtFast + a_slow dtSlow. */
+		void UpdateVelocities(double fastTime, double slowTime);
+	private:
+		int m_innerSteps;
+		std::vector<double> m_slowAcceleration[3];
+	};
+
+	/* Langevin dynamics with the BAOAB splitting (Leimkuhler and Matthews, Appl. Math. Res. Express 2013, 34): half kick,
+	   half drift, the exact Ornstein-Uhlenbeck update of the velocities, half drift, half kick. The random forces come
+	   from Philox keyed by the seed, the step and the atom, so every atom draws its own numbers on any thread and a seed
+	   reproduces the trajectory exactly. */
+	class LangevinIntegrator : public Integrator {
+	public:
+		/* friction is the collision frequency in 1/ps. */
+		LangevinIntegrator(Molecule *molecule, double temperature, double friction, int seed);
+
+		void Initialize(double timeStep) override;
+		void Step(double timeStep) override;
+		bool IsThermostatted() const override;
+	private:
+		/* v = c v + sqrt((1 - c^2) kT / m) R with c = exp(-friction dt). */
+		void UpdateVelocitiesStochastic(double deltaTime);
+	private:
+		double m_temperature;
+		double m_friction;
+		int m_seed;
+		uint64_t m_step;
+	};
+
+	/* Velocity Verlet coupled to a Nose-Hoover chain (Martyna, Klein and Tuckerman, J. Chem. Phys. 97, 2635 (1992)). The
+	   chain is propagated for half a step before and after every velocity Verlet step with the Suzuki-Yoshida scheme of
+	   order four of Martyna et al., Mol. Phys. 87, 1117 (1996). The thermostat masses follow from the time constant, the
+	   period of the thermostat oscillation. */
+	class NoseHooverIntegrator : public VelocityVerletIntegrator {
+	public:
+		NoseHooverIntegrator(Molecule *molecule, double temperature, double timeConstant, int chainLength);
+
+		void Initialize(double timeStep) override;
+		void Step(double timeStep) override;
+		bool IsThermostatted() const override;
+
+		/* Energy of the chain; the total energy plus this is conserved. */
+		double GetChainEnergy() const;
+	private:
+		void PropagateChain(double deltaTime);
+	private:
+		double m_temperature;
+		double m_timeConstant;
+		int m_degreesOfFreedom;
+		std::vector<double> m_chainPosition;
+		std::vector<double> m_chainVelocity;
+		std::vector<double> m_chainMass;
+	};
+
+	/* Settings of the integrators that need more than the molecule. */
+	struct IntegratorSettings {
+		/* Number of inner steps per time step of RESPA. */
+		int innerSteps;
+		/* Bath temperature in K of Langevin and Nose-Hoover. */
+		double temperature;
+		/* Collision frequency in 1/ps and random seed of Langevin. */
+		double friction;
+		int seed;
+		/* Time constant in ps and number of thermostats of the Nose-Hoover chain. */
+		double thermostatTimeConstant;
+		int chainLength;
+
+		IntegratorSettings()
+			: innerSteps(4), temperature(298.15), friction(1.0), seed(0), thermostatTimeConstant(0.1), chainLength(3) {
+
+		}
+	};
+
+	Integrator *CreateIntegrator(IntegratorType type, Molecule *molecule, const IntegratorSettings &settings);
+
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "FFT.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include <utility>
+
+namespace classical {
+
+	namespace math {
+
+		int NextPowerOfTwo(int n) {
+			int power = 1;
+
+			while (power < n) power *= 2;
+
+			return power;
+		}
+
+		void FFT(std::complex<double> *data, int n, bool inverse) {
+			/* Bit-reversal permutation. */
+			for (int i = 1, j = 0; i < n; i++) {
+				int bit = n >> 1;
+
+				for (; j & bit; bit >>= 1) {
+					j ^= bit;
+				}
+
+				j ^= bit;
+
+				if (i < j) std::swap(data[i], data[j]);
+			}
+
+			double sign = inverse ? 1.0 : -1.0;
+
+			for (int length = 2; length <= n; length *= 2) {
+				int half = length / 2;
+
+				for (int k = 0; k < half; k++) {
+					/* Twiddles are evaluated directly rather than by repeated multiplication to keep them exact to rounding. */
+					double angle = sign * 2.0 * M_PI * k / length;
+					std::complex<double> twiddle(cos(angle), sin(angle));
+
+					for (int start = 0; start < n; start += length) {
+						std::complex<double> even = data[start + k];
+						std::complex<double> odd = data[start + k + half] * twiddle;
+
+						data[start + k] = even + odd;
+						data[start + k + half] = even - odd;
+					}
+				}
+			}
+		}
+
+		void FFT3D(std::vector<std::complex<double>> &grid, int nx, int ny, int nz, bool inverse) {
+			/* z lines are contiguous. */
+#pragma omp parallel for
+			for (int line = 0; line < nx * ny; line++) {
+				FFT(grid.data() + line * nz, nz, inverse);
+			}
+
+			/* y and x lines are strided and are copied out and back. */
+#pragma omp parallel
+			{
+				std::vector<std::complex<double>> buffer(ny > nx ? ny : nx);
+
+#pragma omp for
+				for (int line = 0; line < nx * nz; line++) {
+					int x = line / nz;
+					int z = line % nz;
+
+					for (int y = 0; y < ny; y++) buffer[y] = grid[(x * ny + y) * nz + z];
+
+					FFT(buffer.data(), ny, inverse);
+
+					for (int y = 0; y < ny; y++) grid[(x * ny + y) * nz + z] = buffer[y];
+				}
+
+#pragma omp for
+				for (int line = 0; line < ny * nz; line++) {
+					int y = line / nz;
+					int z = line % nz;
+
+					for (int x = 0; x < nx; x++) buffer[x] = grid[(x * ny + y) * nz + z];
+
+					FFT(buffer.data(), nx, inverse);
+
+					for (int x = 0; x < nx; x++) grid[(x * ny + y) * nz + z] = buffer[x];
+				}
+			}
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+namespace classical {
+
+	namespace math {
+
+		/* Smallest power of two that is at least n. */
+		int NextPowerOfTwo(int n);
+
+		/* In-place radix-2 transform of n contiguous values, n a power of two. The forward transform uses
+		   exp(-2 pi i j k / n), the inverse exp(+2 pi i j k / n); neither is normalized. */
+		void FFT(std::complex<double> *data, int n, bool inverse);
+
+		/* Transforms a row-major nx * ny * nz grid (z fastest) along all three axes. */
+		void FFT3D(std::vector<std::complex<double>> &grid, int nx, int ny, int nz, bool inverse);
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "Philox.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+namespace classical {
+
+	namespace math {
+
+		static const uint32_t s_philoxMultiplier0 = 0xD2511F53;
+		static const uint32_t s_philoxMultiplier1 = 0xCD9E8D57;
+		static const uint32_t s_philoxWeyl0 = 0x9E3779B9;
+		static const uint32_t s_philoxWeyl1 = 0xBB67AE85;
+
+		void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4]) {
+			uint32_t x0 = counter[0];
+			uint32_t x1 = counter[1];
+			uint32_t x2 = counter[2];
+			uint32_t x3 = counter[3];
+			uint32_t k0 = key[0];
+			uint32_t k1 = key[1];
+
+			for (int round = 0; round < 10; round++) {
+				uint64_t product0 = (uint64_t)s_philoxMultiplier0 * x0;
+				uint64_t product1 = (uint64_t)s_philoxMultiplier1 * x2;
+
+				uint32_t y0 = (uint32_t)(product1 >> 32) ^ x1 ^ k0;
+				uint32_t y1 = (uint32_t)product1;
+				uint32_t y2 = (uint32_t)(product0 >> 32) ^ x3 ^ k1;
+				uint32_t y3 = (uint32_t)product0;
+
+				x0 = y0;
+				x1 = y1;
+				x2 = y2;
+				x3 = y3;
+
+				k0 += s_philoxWeyl0;
+				k1 += s_philoxWeyl1;
+			}
+
+			result[0] = x0;
+			result[1] = x1;
+			result[2] = x2;
+			result[3] = x3;
+		}
+
+		/* Uniform in (0, 1], so that the logarithm of Box-Muller stays finite. */
+		static inline double GetUniform(uint32_t word) {
+			return (word + 1.0) * (1.0 / 4294967296.0);
+		}
+
+		void GetUniformDeviates(uint64_t seed, uint32_t stream, uint64_t step, uint32_t index, double deviates[4]) {
+			uint32_t counter[4] = { index, (uint32_t)step, (uint32_t)(step >> 32), stream };
+			uint32_t key[2] = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+			uint32_t words[4];
+
+			Philox4x32(counter, key, words);
+
+			for (int k = 0; k < 4; k++) {
+				deviates[k] = GetUniform(words[k]);
+			}
+		}
+
+		void GetNormalDeviates(uint64_t seed, uint32_t stream, uint64_t step, uint32_t index, double deviates[4]) {
+			double uniform[4];
+
+			GetUniformDeviates(seed, stream, step, index, uniform);
+
+			for (int k = 0; k < 4; k += 2) {
+				double radius = sqrt(-2.0 * log(uniform[k]));
+				double angle = 2.0 * M_PI * uniform[k + 1];
+
+				deviates[k] = radius * cos(angle);
+				deviates[k + 1] = radius * sin(angle);
+			}
+		}
+
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace classical {
+
+	namespace math {
+
+		/* Philox4x32-10 counter-based generator (Salmon et al., SC11 (2011)). The four 32-bit words are a pure function of
+		   the 128-bit counter and the 64-bit key, so every thread can draw its own numbers without shared state and a run
+		   is reproduced exactly from its key. */
+		void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4]);
+
+		/* Four uniform deviates in (0, 1] from the Philox block of counter (index, step, stream) and key seed. */
+		void GetUniformDeviates(uint64_t seed, uint32_t stream, uint64_t step, uint32_t index, double deviates[4]);
+		/* Four standard normal deviates from the same block. */
+		void GetNormalDeviates(uint64_t seed, uint32_t stream, uint64_t step, uint32_t index, double deviates[4]);
+
+	}
+
+}
\ No newline at end of file
@@ -1,35 +1,80 @@
 #include "MolecularDynamics.h"
 
+#include <algorithm>
 #include <chrono>
-#include <random>
+
+#include <omp.h>
 
 #include "Constants.h"
 #include "FileIO.h"
 
+#include "Math/Philox.h"
+
 namespace classical {
 
 	MolecularDynamics::MolecularDynamics(Molecule *molecule, const SimulationParameters &parameters)
-		: Simulation(molecule, parameters) {
+		: Simulation(molecule, parameters), m_lastTime(0.0), m_currentTime(0.0), m_eTemperature(0.0), m_eTime(0.0), m_gTime(0.0) {
+
+		m_integratorType = ResolveIntegratorType(m_parameters.GetIntegrator());
+		IntegratorSettings integratorSettings;
+		integratorSettings.innerSteps = m_parameters.GetRESPAInnerSteps();
+		integratorSettings.temperature = m_parameters.GetDesiredTemperature();
+		integratorSettings.friction = m_parameters.GetLangevinFriction();
+		integratorSettings.seed = m_parameters.GetRandomSeed();
+		integratorSettings.thermostatTimeConstant = m_parameters.GetThermostatTimeConstant();
+		integratorSettings.chainLength = m_parameters.GetNoseHooverChainLength();
+
+		m_integrator = CreateIntegrator(m_integratorType, m_molecule, integratorSettings);
+		m_barostat = nullptr;
+		m_equilibriumTime = m_parameters.GetEquilibriumTime();
+
+		/* Rescaling the velocities on top would fight the thermostat. */
+		if (m_integrator->IsThermostatted() && m_equilibriumTime > 0.0) {
+			std::cout << "The " << GetIntegratorTypeName(m_integratorType) << " integrator keeps the temperature itself; ignoring the equilibrium time" << std::endl;
+			m_equilibriumTime = 0.0;
+		}
+
+		if (ResolveBarostatType(m_parameters.GetBarostat()) == BarostatType::MonteCarlo) {
+			if (m_molecule->m_periodicBox.IsPeriodic() || (m_molecule->m_boundary > 0.0 && m_molecule->m_boundary < 1.0E3)) {
+				m_barostat = new MonteCarloBarostat(m_molecule, m_parameters.GetDesiredPressure(), m_parameters.GetDesiredTemperature(), m_parameters.GetRandomSeed());
+			} else {
+				std::cout << "The barostat needs a finite volume, but the boundary is " << m_molecule->m_boundary << " A; running without pressure control" << std::endl;
+			}
+		}
+
+		if (m_molecule->m_periodicBox.IsPeriodic()) {
+			m_molecule->m_bondGraph.FindComponents(m_moleculeOffsets, m_moleculeAtoms);
+		}
+	}
 
+	MolecularDynamics::~MolecularDynamics() {
+		delete m_integrator;
+		delete m_barostat;
 	}
 
 	void MolecularDynamics::Run() {
 		OpenOutputFiles();
+		ConstrainInitialPositions();
 		InitializeVelocities();
-		m_molecule->CalculateEnergy();
-		m_molecule->CalculateGradient();
-		UpdateAccelerations();
+		m_molecule->CalculateEnergyAndGradient();
+		m_molecule->CalculateKineticEnergy();
+		m_integrator->Initialize(m_parameters.GetTimeStep());
 		CheckPrint(0.0, true);
-		UpdateVelocities(0.5 * m_parameters.GetTimeStep());
+
+		uint64_t step = 0;
+		int barostatInterval = std::max(1, m_parameters.GetBarostatInterval());
 
 		while (m_currentTime < m_parameters.GetTotalTime()) {
-			UpdatePositions(m_parameters.GetTimeStep());
-			m_molecule->CalculateGradient();
-			UpdateAccelerations();
-			UpdateVelocities(m_parameters.GetTimeStep());
-			m_molecule->CalculateEnergy("leapfrog");
+			m_integrator->Step(m_parameters.GetTimeStep());
+			step++;
+
+			if (m_barostat && step % barostatInterval == 0 && m_barostat->Apply(step)) {
+				m_integrator->PositionsChanged();
+			}
+
+			m_molecule->CalculateTemperature();
 
-			if (m_currentTime < m_parameters.GetEquilibriumTime()) {
+			if (m_currentTime < m_equilibriumTime) {
 				EquilibrateTemperature();
 			}
 
@@ -38,6 +83,8 @@ namespace classical {
 		}
 
 		CheckPrint(m_parameters.GetTimeStep());
+		PrintNeighborListStatistics();
+		PrintBarostatStatistics();
 		CloseOutputFiles();
 	}
 
@@ -59,7 +106,19 @@ namespace classical {
 		
 		snprintf(comment, 20, "%.4f ps", m_currentTime);
 
-		m_geometryFile << GetCoordsXYZString(m_molecule->m_atoms, String(comment), m_parameters.GetGeometryWriteChars(), m_parameters.GetGeometryWriteDigits());
+		const std::vector<double> *positions = m_molecule->m_particles.position;
+
+		/* The positions are unwrapped during the run; whole molecules are put back into the box for output only. */
+		if (m_molecule->m_periodicBox.IsPeriodic()) {
+			for (int j = 0; j < 3; j++) {
+				m_wrappedPositions[j] = m_molecule->m_particles.position[j];
+			}
+
+			m_molecule->m_periodicBox.WrapMolecules(m_wrappedPositions, m_moleculeOffsets, m_moleculeAtoms);
+			positions = m_wrappedPositions;
+		}
+
+		m_geometryFile << GetCoordsXYZString(m_molecule->m_atoms, positions, String(comment), m_parameters.GetGeometryWriteChars(), m_parameters.GetGeometryWriteDigits());
 	}
 
 	void MolecularDynamics::WriteEnergyTerms(int totalFloatChars, int decimalChars, char printType) {
@@ -67,7 +126,7 @@ namespace classical {
 
 		std::vector<double> energyTerms = {
 			m->m_eKinetic, m->m_ePotential, m->m_eNonBonded, m->m_eBonded, m->m_eBound,
-			m->m_eVDW, m->m_eElst, m->m_eBonds, m->m_eAngles, m->m_eTorsions, m->m_eOutOfPlanes
+			m->m_eVDW, m->m_eElst, m->m_eBonds, m->m_eAngles, m->m_eTorsions, m->m_eOutOfPlanes, m->m_eSolvation
 		};
 
 		for (double term : energyTerms) {
@@ -80,6 +139,14 @@ namespace classical {
 
 		WriteValue(m_parameters.GetEnergyWriteChars() + 2, m_parameters.GetEnergyWriteDigits() + 2, m_molecule->m_eTotal, 'e');
 		WriteEnergyTerms(m_parameters.GetEnergyWriteChars(), m_parameters.GetEnergyWriteDigits(), 'e');
+
+		/* The total energy plus the energy of the thermostat chain is conserved, so its drift measures the integration error. */
+		if (m_integratorType == IntegratorType::NoseHoover) {
+			double eChain = static_cast<NoseHooverIntegrator *>(m_integrator)->GetChainEnergy();
+
+			WriteValue(m_parameters.GetEnergyWriteChars() + 2, m_parameters.GetEnergyWriteDigits() + 2, m_molecule->m_eTotal + eChain, 'e');
+		}
+
 		m_energyFile.write("\n", 1);
 	}
 
@@ -90,21 +157,54 @@ namespace classical {
 		m_energyFile << utils::StringWithFormat("\n# GEOMOUT %s", m_parameters.GetGeometryOutputFilePath().c_str()).c_str();
 		m_energyFile << utils::StringWithFormat("\n# RANDOMSEED %i", m_parameters.GetRandomSeed());
 		m_energyFile << utils::StringWithFormat("\n# DESIREDTEMPERATURE %.6f K", m_parameters.GetDesiredTemperature());
+		m_energyFile << utils::StringWithFormat("\n# DESIREDPRESSURE %.6f bar", m_parameters.GetDesiredPressure());
 		m_energyFile << utils::StringWithFormat("\n# BOUNDARY %.6f A", m_molecule->m_boundary);
 		m_energyFile << utils::StringWithFormat("\n# BOUNDARYSPRING %.6f kcal/(mol*A^2)", m_molecule->m_kBox);
 		m_energyFile << utils::StringWithFormat("\n# BOUNDARYTYPE %s", m_molecule->m_boundaryType.c_str());
+		m_energyFile << utils::StringWithFormat("\n# BOXSIZE %.6f %.6f %.6f A", m_molecule->m_periodicBox.GetLength(0), m_molecule->m_periodicBox.GetLength(1), m_molecule->m_periodicBox.GetLength(2));
+		m_energyFile << utils::StringWithFormat("\n# NONBONDEDCUTOFF %.6f A", m_molecule->m_nonBondedCutoff);
+		m_energyFile << utils::StringWithFormat("\n# NEIGHBORLISTSKIN %.6f A", m_molecule->m_neighborListSkin);
+		m_energyFile << utils::StringWithFormat("\n# VDW14SCALE %.6f", m_molecule->m_vdw14Scale);
+		m_energyFile << utils::StringWithFormat("\n# ELST14SCALE %.6f", m_molecule->m_elst14Scale);
+		m_energyFile << utils::StringWithFormat("\n# NONBONDEDKERNEL %s", GetNonBondedKernelName(m_molecule->m_nonBondedKernel).c_str());
+		m_energyFile << utils::StringWithFormat("\n# NONBONDEDDETERMINISTIC %d", (int)m_molecule->m_nonBondedDeterministic);
+		m_energyFile << utils::StringWithFormat("\n# THREADS %d", omp_get_max_threads());
+		m_energyFile << utils::StringWithFormat("\n# ELECTROSTATICS %s", GetElectrostaticsMethodName(m_molecule->m_electrostatics).c_str());
+		m_energyFile << utils::StringWithFormat("\n# EWALDTOLERANCE %.6e", m_molecule->m_ewaldTolerance);
+		m_energyFile << utils::StringWithFormat("\n# PMEGRIDSPACING %.6f A", m_molecule->m_pmeGridSpacing);
+		m_energyFile << utils::StringWithFormat("\n# PMEORDER %d", m_molecule->m_pmeOrder);
+		m_energyFile << utils::StringWithFormat("\n# REACTIONFIELDDIELECTRIC %.6f", m_molecule->m_reactionFieldDielectric);
+		m_energyFile << utils::StringWithFormat("\n# VDWSWITCHDISTANCE %.6f A", m_molecule->m_vdwSwitchDistance);
+		m_energyFile << utils::StringWithFormat("\n# IMPLICITSOLVENT %s", GetImplicitSolventModelName(m_molecule->m_implicitSolvent).c_str());
+		m_energyFile << utils::StringWithFormat("\n# SOLVENTDIELECTRIC %.6f", m_molecule->m_solventDielectric);
 		m_energyFile << utils::StringWithFormat("\n# STATUSWAITTIME %.6f s", m_parameters.GetStatusWaitTime());
 		m_energyFile << utils::StringWithFormat("\n# ENERGYWAITTIME %.6f ps", m_parameters.GetEnergyWaitTime());
 		m_energyFile << utils::StringWithFormat("\n# GEOMWAITTIME %.6f ps", m_parameters.GetGeometryWaitTime());
 		m_energyFile << utils::StringWithFormat("\n# TOTALTIME %.6f ps", m_parameters.GetTotalTime());
 		m_energyFile << utils::StringWithFormat("\n# TIMESTEP %.6f ps", m_parameters.GetTimeStep());
-		m_energyFile << utils::StringWithFormat("\n# EQTIME %.6f ps", m_parameters.GetEquilibriumTime());
+		m_energyFile << utils::StringWithFormat("\n# INTEGRATOR %s", GetIntegratorTypeName(m_integratorType).c_str());
+		m_energyFile << utils::StringWithFormat("\n# RESPAINNERSTEPS %d", m_parameters.GetRESPAInnerSteps());
+		m_energyFile << utils::StringWithFormat("\n# LANGEVINFRICTION %.6f 1/ps", m_parameters.GetLangevinFriction());
+		m_energyFile << utils::StringWithFormat("\n# THERMOSTATTIMECONSTANT %.6f ps", m_parameters.GetThermostatTimeConstant());
+		m_energyFile << utils::StringWithFormat("\n# NOSEHOOVERCHAINLENGTH %d", m_parameters.GetNoseHooverChainLength());
+		m_energyFile << utils::StringWithFormat("\n# BAROSTAT %s", GetBarostatTypeName(m_barostat ? BarostatType::MonteCarlo : BarostatType::None).c_str());
+		m_energyFile << utils::StringWithFormat("\n# BAROSTATINTERVAL %d", m_parameters.GetBarostatInterval());
+		m_energyFile << utils::StringWithFormat("\n# CONSTRAINTS %s %d", GetConstraintTypeName(m_molecule->m_constraints.GetType()).c_str(), m_molecule->m_constraints.GetNDistances());
+		m_energyFile << utils::StringWithFormat("\n# CONSTRAINTTOLERANCE %.6e", m_molecule->m_constraints.GetTolerance());
+		m_energyFile << utils::StringWithFormat("\n# RIGIDWATERS %d", m_molecule->m_constraints.GetNWaters());
+		m_energyFile << utils::StringWithFormat("\n# EQTIME %.6f ps", m_equilibriumTime);
 		m_energyFile << utils::StringWithFormat("\n# EQRATE %.6f p", m_parameters.GetEquilibriumRate());
 		m_energyFile << "\n#\n# -- ENERGY DATA --\n#";
 		m_energyFile << "\n# energy terms [kcal/mol]\n#  time      e_total      ";
 		m_energyFile << "e_kin      e_pot  e_nonbond   e_bonded e_boundary      ";
 		m_energyFile << "e_vdw     e_elst     e_bond    e_angle     e_tors      ";
-		m_energyFile << "e_oop\n";
+		m_energyFile << "e_oop     e_solv";
+
+		if (m_integratorType == IntegratorType::NoseHoover) {
+			m_energyFile << "  e_conserved";
+		}
+
+		m_energyFile << "\n";
 	}
 
 	void MolecularDynamics::PrintStatus() {
@@ -123,33 +223,71 @@ namespace classical {
 		FlushBuffers();
 	}
 
+	void MolecularDynamics::PrintNeighborListStatistics() {
+		const NeighborList &neighborList = m_molecule->m_neighborList;
+
+		std::cout << "Neighbor list rebuilds: " << neighborList.GetRebuildCount() << "/" << neighborList.GetUpdateCount() << " updates" << std::endl;
+		std::cout << "Average neighbor list length: " << neighborList.GetAverageListLength() << " pairs per atom" << std::endl;
+	}
+
+	void MolecularDynamics::PrintBarostatStatistics() {
+		if (!m_barostat) return;
+
+		const PeriodicBox &box = m_molecule->m_periodicBox;
+
+		std::cout << "Barostat: " << m_barostat->GetNAccepted() << "/" << m_barostat->GetNAttempts() << " volume changes accepted, final volume " << m_molecule->m_volume << " A^3";
+
+		if (box.IsPeriodic()) {
+			std::cout << " (box " << box.GetLength(0) << " x " << box.GetLength(1) << " x " << box.GetLength(2) << " A)" << std::endl;
+		} else {
+			std::cout << " (boundary " << m_molecule->m_boundary << " A)" << std::endl;
+		}
+	}
+
+	void MolecularDynamics::ConstrainInitialPositions() {
+		ConstraintSet &constraints = m_molecule->m_constraints;
+
+		if (!constraints.GetNConstraints()) return;
+
+		constraints.SetReference(m_molecule->m_particles);
+		constraints.ApplyPositions(m_molecule->m_particles, 0.0);
+		m_molecule->UpdateInternals();
+
+		std::cout << "Constrained " << constraints.GetNDistances() << " distances (" << GetConstraintTypeName(constraints.GetType()) << ") and " << constraints.GetNWaters() << " rigid waters" << std::endl;
+	}
+
 	void MolecularDynamics::InitializeVelocities() {
 		if (m_parameters.GetDesiredTemperature()) {
 			m_eTemperature = m_parameters.GetDesiredTemperature();
 
 			double sigmaBase = sqrt(2.0 * GAS_CONSTANT * m_parameters.GetDesiredTemperature() / 3);
 
-			for (Atom *atom : m_molecule->m_atoms) {
-				double sigma = sigmaBase * pow(atom->mass, -0.5);
+			ParticleStore &particles = m_molecule->m_particles;
+			int natoms = particles.GetSize();
 
-				for (int j = 0; j < 3; j++) {
-					std::random_device rd{};
-					std::mt19937 gen{ rd() };
+			/* Philox stream 0 at step 0 of the run's seed; the Langevin forces draw from stream 1. */
+#pragma omp parallel for
+			for (int i = 0; i < natoms; i++) {
+				double sigma = sigmaBase * pow(particles.mass[i], -0.5);
+				double deviates[4];
 
-					std::normal_distribution<double> distribution(0.0, sigma);
+				math::GetNormalDeviates(m_parameters.GetRandomSeed(), 0, 0, i, deviates);
 
-					atom->velocity[j] = distribution(gen);
+				for (int j = 0; j < 3; j++) {
+					particles.velocity[j][i] = sigma * deviates[j];
 				}
-
 			}
 
+			m_molecule->m_constraints.ApplyVelocities(particles);
 			m_molecule->CalculateEnergy();
 			m_molecule->CalculateTemperature();
 
 			double vScale = sqrt(m_parameters.GetDesiredTemperature() / m_molecule->m_temperature);
 
-			for (Atom *atom : m_molecule->m_atoms) {
-				atom->velocity *= vScale;
+			for (int j = 0; j < 3; j++) {
+				for (double &velocity : particles.velocity[j]) {
+					velocity *= vScale;
+				}
 			}
 		}
 	}
@@ -162,41 +300,13 @@ namespace classical {
 
 		double velocityScale = 1.0 + timeScale * (sqrt(m_parameters.GetDesiredTemperature() / m_eTemperature) - 1.0);
 
-		for (int i = 0; i < m_molecule->m_nAtoms; i++) {
-			for (int j = 0; j < 3; j++) {
-				m_molecule->m_atoms[i]->velocity[j] *= velocityScale;
-			}
-		}
-	}
-
-	void MolecularDynamics::UpdateAccelerations() {
-		for (int i = 0; i < m_molecule->m_nAtoms; i++) {
-			double mass = m_molecule->m_atoms[i]->mass;
-
-			for (int j = 0; j < 3; j++) {
-				m_molecule->m_atoms[i]->previousAcceleration[j] = m_molecule->m_atoms[i]->acceleration[j];
-				m_molecule->m_atoms[i]->acceleration[j] = (-ACCELERATION_CONVERSION * m_molecule->m_gTotal[i][j] / mass);
-			}
-		}
-	}
-
-	void MolecularDynamics::UpdateVelocities(double deltaTime) {
-		for (int i = 0; i < m_molecule->m_nAtoms; i++) {
-			for (int j = 0; j < 3; j++) {
-				m_molecule->m_atoms[i]->previousVelocity[j] = m_molecule->m_atoms[i]->velocity[j];
-				m_molecule->m_atoms[i]->velocity[j] += m_molecule->m_atoms[i]->acceleration[j] * deltaTime;
-			}
-		}
-	}
+		ParticleStore &particles = m_molecule->m_particles;
 
-	void MolecularDynamics::UpdatePositions(double deltaTime) {
-		for (int i = 0; i < m_molecule->m_nAtoms; i++) {
-			for (int j = 0; j < 3; j++) {
-				m_molecule->m_atoms[i]->position[j] += m_molecule->m_atoms[i]->velocity[j] * deltaTime;
+		for (int j = 0; j < 3; j++) {
+			for (double &velocity : particles.velocity[j]) {
+				velocity *= velocityScale;
 			}
 		}
-
-		m_molecule->UpdateInternals();
 	}
 
 	void MolecularDynamics::CheckPrint(double timeStep, bool printAll) {
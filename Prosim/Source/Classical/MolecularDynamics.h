@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Barostat.h"
+#include "Integrator.h"
 #include "Simulation.h"
 
 namespace classical {
@@ -7,6 +9,7 @@ namespace classical {
 	class MolecularDynamics : public Simulation {
 	public:
 		MolecularDynamics(Molecule *molecule, const SimulationParameters &parameters);
+		~MolecularDynamics();
 
 		void Run();
 	private:
@@ -16,21 +19,35 @@ namespace classical {
 		void WriteEnergy() override;
 		void WriteEnergyHeader() override;
 		void PrintStatus() override;
+		void PrintNeighborListStatistics();
+		void PrintBarostatStatistics();
 
+		void ConstrainInitialPositions();
 		void InitializeVelocities();
 		void EquilibrateTemperature();
-		void UpdateAccelerations();
-		void UpdateVelocities(double deltaTime);
-		void UpdatePositions(double deltaTime);
 		void CheckPrint(double timeStep, bool printAll = false);
 
 	private:
+		IntegratorType m_integratorType;
+		Integrator *m_integrator;
+		/* Null without pressure control. */
+		MonteCarloBarostat *m_barostat;
+
 		double m_lastTime;
 		double m_currentTime;
+		/* Time during which the velocities are rescaled towards the desired temperature; zero for thermostatted
+		   integrators. */
+		double m_equilibriumTime;
 		double m_eTemperature;
 
 		double m_eTime;
 		double m_gTime;
+
+		/* Molecules as offsets into a flattened atom list, and a scratch copy of the positions, for writing whole
+		   molecules wrapped into a periodic box. */
+		std::vector<int> m_moleculeOffsets;
+		std::vector<int> m_moleculeAtoms;
+		std::vector<double> m_wrappedPositions[3];
 	};
 
 }
\ No newline at end of file
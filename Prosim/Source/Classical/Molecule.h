@@ -3,26 +3,44 @@
 #include <string>
 #include <vector>
 
-#include "Angle.h"
 #include "Atom.h"
-#include "Bond.h"
+#include "BondGraph.h"
+#include "BondedTables.h"
+#include "Constraints.h"
 #include "Energy.h"
+#include "ExclusionTable.h"
 #include "ForceField.h"
-#include "OutOfPlane.h"
-#include "Torsion.h"
+#include "GeneralizedBorn.h"
+#include "NeighborList.h"
+#include "NonBondedKernel.h"
+#include "ParticleStore.h"
+#include "PeriodicBox.h"
 
 namespace classical {
 
 	class Simulation;
 	class MolecularDynamics;
+	class Integrator;
 
 	class Molecule {
 	public:
 		virtual void CalculateEnergy(const String &kineticType = "none") = 0;
 		virtual void CalculateGradient(const String &gradientType = "analytic") = 0;
+		/* Potential energy terms and the analytic gradient in a single pass over the non-bonded pairs. */
+		virtual void CalculateEnergyAndGradient() = 0;
+		/* Recomputes the bonded, boundary and 1-4 terms into the short-range gradient. The bonded energies and gradients are
+		   updated on the way; the other terms keep their last values. */
+		virtual void CalculateShortRangeGradient() = 0;
+		/* Rebuilds the short-range gradient from the bonded and boundary gradients of the last full evaluation and one pass
+		   over the 1-4 pairs, without evaluating the bonded terms again. */
+		virtual void SumShortRangeGradient() = 0;
+		/* Updates the kinetic and total energy only, e.g. after the velocities have been advanced. */
+		virtual void CalculateKineticEnergy(const String &kineticType = "none") = 0;
 		virtual void CalculateAnalyticGradient() = 0;
 		virtual void CalculateNumericalGradient() = 0;
 		virtual void UpdateInternals() = 0;
+		/* Perceives the bonds again in the current periodic box and rebuilds the bonded terms and exclusions from them. */
+		virtual void UpdateTopology() = 0;
 		virtual void CalculateTemperature() = 0;
 		virtual void CalculatePressure() = 0;
 		virtual void CalculateVolume() = 0;
@@ -39,6 +57,10 @@ namespace classical {
 		inline void SetBoundaryType(const String &boundaryType) { m_boundaryType = boundaryType; }
 		inline void SetOrigin(const math::Vec3 &origin) { m_origin = origin; }
 
+		/* Periodic cell of the "periodic" boundary type; not periodic for the sphere and cube walls. */
+		inline const PeriodicBox &GetPeriodicBox() const { return m_periodicBox; }
+		inline void SetPeriodicBox(const PeriodicBox &periodicBox) { m_periodicBox = periodicBox; }
+
 		inline double GetDielectric() const { return m_dielectric; }
 		inline double GetMass() const { return m_mass; }
 		inline double GetMemberVolume() const { return m_volume; }
@@ -48,14 +70,54 @@ namespace classical {
 
 		inline double SetDielectric(double dielectric) { m_dielectric = dielectric; }
 
-		inline const std::vector<Atom *> &GetAtoms() const { return m_atoms; }
-		inline const std::vector<Bond *> &GetBonds() const { return m_bonds; }
-		inline const std::vector<Angle *> &GetAngles() const { return m_angles; }
-		inline const std::vector<Torsion *> &GetTorsions() const { return m_torsions; }
-		inline const std::vector<OutOfPlane *> &GetOutOfPlanes() const { return m_outOfPlanes; }
+		/* A non-bonded cutoff <= 0 evaluates all pairs. */
+		inline double GetNonBondedCutoff() const { return m_nonBondedCutoff; }
+		inline void SetNonBondedCutoff(double nonBondedCutoff) { m_nonBondedCutoff = nonBondedCutoff; }
+		inline double GetNeighborListSkin() const { return m_neighborListSkin; }
+		inline void SetNeighborListSkin(double neighborListSkin) { m_neighborListSkin = neighborListSkin; }
+		/* Factors applied to the van der Waals and electrostatic energies of 1-4 pairs. */
+		inline double GetVDW14Scale() const { return m_vdw14Scale; }
+		inline void SetVDW14Scale(double vdw14Scale) { m_vdw14Scale = vdw14Scale; }
+		inline double GetElst14Scale() const { return m_elst14Scale; }
+		inline void SetElst14Scale(double elst14Scale) { m_elst14Scale = elst14Scale; }
+		inline NonBondedKernel GetNonBondedKernel() const { return m_nonBondedKernel; }
+		inline void SetNonBondedKernel(NonBondedKernel nonBondedKernel) { m_nonBondedKernel = nonBondedKernel; }
+		/* Bitwise identical non-bonded forces for any thread count, at twice the pair arithmetic. */
+		inline bool GetNonBondedDeterministic() const { return m_nonBondedDeterministic; }
+		inline void SetNonBondedDeterministic(bool nonBondedDeterministic) { m_nonBondedDeterministic = nonBondedDeterministic; }
+		/* PME uses the periodic box, or else treats the boundary as a periodic cube of edge 2 * boundary centered on the origin. */
+		inline ElectrostaticsMethod GetElectrostatics() const { return m_electrostatics; }
+		inline void SetElectrostatics(ElectrostaticsMethod electrostatics) { m_electrostatics = electrostatics; }
+		inline double GetEwaldTolerance() const { return m_ewaldTolerance; }
+		inline void SetEwaldTolerance(double ewaldTolerance) { m_ewaldTolerance = ewaldTolerance; }
+		inline double GetPMEGridSpacing() const { return m_pmeGridSpacing; }
+		inline void SetPMEGridSpacing(double pmeGridSpacing) { m_pmeGridSpacing = pmeGridSpacing; }
+		inline int GetPMEOrder() const { return m_pmeOrder; }
+		inline void SetPMEOrder(int pmeOrder) { m_pmeOrder = pmeOrder; }
+		inline double GetReactionFieldDielectric() const { return m_reactionFieldDielectric; }
+		inline void SetReactionFieldDielectric(double reactionFieldDielectric) { m_reactionFieldDielectric = reactionFieldDielectric; }
+		/* Start of the van der Waals switch to zero at the cutoff; 0 truncates instead. */
+		inline double GetVDWSwitchDistance() const { return m_vdwSwitchDistance; }
+		inline void SetVDWSwitchDistance(double vdwSwitchDistance) { m_vdwSwitchDistance = vdwSwitchDistance; }
+		/* Generalized Born solvation around a solute of the dielectric above; it uses the non-bonded cutoff. */
+		inline ImplicitSolventModel GetImplicitSolvent() const { return m_implicitSolvent; }
+		inline void SetImplicitSolvent(ImplicitSolventModel implicitSolvent) { m_implicitSolvent = implicitSolvent; }
+		inline double GetSolventDielectric() const { return m_solventDielectric; }
+		inline void SetSolventDielectric(double solventDielectric) { m_solventDielectric = solventDielectric; }
+		inline const GeneralizedBorn &GetGeneralizedBorn() const { return m_generalizedBorn; }
 
-		inline const std::vector<int> &GetNonInts() const { return m_nonInts; }
-		inline const std::map<int, std::map<int, double>> &GetBondGraph() const { return m_bondGraph; }
+		inline const std::vector<Atom *> &GetAtoms() const { return m_atoms; }
+		inline const ParticleStore &GetParticles() const { return m_particles; }
+		inline ParticleStore &GetParticles() { return m_particles; }
+		inline const BondTable &GetBonds() const { return m_bonds; }
+		inline const AngleTable &GetAngles() const { return m_angles; }
+		inline const TorsionTable &GetTorsions() const { return m_torsions; }
+		inline const OutOfPlaneTable &GetOutOfPlanes() const { return m_outOfPlanes; }
+
+		inline const ExclusionTable &GetExclusions() const { return m_exclusions; }
+		inline const BondGraph &GetBondGraph() const { return m_bondGraph; }
+		inline const ConstraintSet &GetConstraints() const { return m_constraints; }
+		inline const NeighborList &GetNeighborList() const { return m_neighborList; }
 
 		inline int GetNAtoms() const { return m_nAtoms; }
 		inline int GetNBonds() const { return m_nBonds; }
@@ -69,6 +131,7 @@ namespace classical {
 		inline double GetMemberEOutOfPlanes() const { return m_eOutOfPlanes; }
 		inline double GetMemberEVDW() const { return m_eVDW; }
 		inline double GetMemberEElst() const { return m_eElst; }
+		inline double GetMemberESolvation() const { return m_eSolvation; }
 		inline double GetMemberEBound() const { return m_eBound; }
 		inline double GetMemberEBonded() const { return m_eBonded; }
 		inline double GetMemberENonBonded() const { return m_eNonBonded; }
@@ -82,18 +145,21 @@ namespace classical {
 		inline const std::vector<math::Vec3> &GetGOutOfPlanes() const { return m_gOutOfPlanes; }
 		inline const std::vector<math::Vec3> &GetGVDW() const { return m_gVDW; }
 		inline const std::vector<math::Vec3> &GetGElst() const { return m_gElst; }
+		inline const std::vector<math::Vec3> &GetGSolvation() const { return m_gSolvation; }
 		inline const std::vector<math::Vec3> &GetGBound() const { return m_gBound; }
 		inline const std::vector<math::Vec3> &GetGBonded() const { return m_gBonded; }
 		inline const std::vector<math::Vec3> &GetGNonBonded() const { return m_gNonBonded; }
 		inline const std::vector<math::Vec3> &GetGPotential() const { return m_gPotential; }
 		inline const std::vector<math::Vec3> &GetGKinetic() const { return m_gKinetic; }
 		inline const std::vector<math::Vec3> &GetGTotal() const { return m_gTotal; }
+		inline const std::vector<math::Vec3> &GetGShortRange() const { return m_gShortRange; }
 
 	protected:
 		double m_kBox;
 		double m_boundary;
 		String m_boundaryType;
 		math::Vec3 m_origin;
+		PeriodicBox m_periodicBox;
 
 		double m_dielectric;
 		double m_mass;
@@ -101,15 +167,35 @@ namespace classical {
 		double m_temperature;
 		double m_pressure;
 		double m_virial;
+		double m_nonBondedVirial;
+		double m_nonBondedCutoff;
+		double m_neighborListSkin;
+		double m_vdw14Scale;
+		double m_elst14Scale;
+		NonBondedKernel m_nonBondedKernel;
+		bool m_nonBondedDeterministic;
+		ElectrostaticsMethod m_electrostatics;
+		double m_ewaldTolerance;
+		double m_pmeGridSpacing;
+		int m_pmeOrder;
+		double m_reactionFieldDielectric;
+		double m_vdwSwitchDistance;
+		NonBondedWorkspace m_nonBondedWorkspace;
+		ImplicitSolventModel m_implicitSolvent;
+		double m_solventDielectric;
+		GeneralizedBorn m_generalizedBorn;
 
 		std::vector<Atom *> m_atoms;
-		std::vector<Bond *> m_bonds;
-		std::vector<Angle *> m_angles;
-		std::vector<Torsion *> m_torsions;
-		std::vector<OutOfPlane *> m_outOfPlanes;
+		ParticleStore m_particles;
+		BondTable m_bonds;
+		AngleTable m_angles;
+		TorsionTable m_torsions;
+		OutOfPlaneTable m_outOfPlanes;
 
-		std::vector<int> m_nonInts;
-		std::map<int, std::map<int, double>> m_bondGraph;
+		ExclusionTable m_exclusions;
+		BondGraph m_bondGraph;
+		NeighborList m_neighborList;
+		ConstraintSet m_constraints;
 
 		int m_nAtoms;
 		int m_nBonds;
@@ -124,6 +210,8 @@ namespace classical {
 		double m_eOutOfPlanes;
 		double m_eVDW;
 		double m_eElst;
+		/* Polar solvation energy of the implicit solvent, part of the non-bonded energy. */
+		double m_eSolvation;
 		double m_eBound;
 		double m_eBonded;
 		double m_eNonBonded;
@@ -137,17 +225,22 @@ namespace classical {
 		std::vector<math::Vec3> m_gOutOfPlanes;
 		std::vector<math::Vec3> m_gVDW;
 		std::vector<math::Vec3> m_gElst;
+		std::vector<math::Vec3> m_gSolvation;
 		std::vector<math::Vec3> m_gBound;
 		std::vector<math::Vec3> m_gBonded;
 		std::vector<math::Vec3> m_gNonBonded;
 		std::vector<math::Vec3> m_gPotential;
 		std::vector<math::Vec3> m_gKinetic;
 		std::vector<math::Vec3> m_gTotal;
+		/* Bonded, boundary and 1-4 non-bonded gradient, the fast force group of multiple time stepping. Only kept current
+		   by CalculateShortRangeGradient and SumShortRangeGradient. */
+		std::vector<math::Vec3> m_gShortRange;
 
 		NonBondedEnergyGPUCalculator m_nonBondedGPUCalculator;
 
 		friend class Simulation;
 		friend class MolecularDynamics;
+		friend class Integrator;
 	};
 
 }
\ No newline at end of file
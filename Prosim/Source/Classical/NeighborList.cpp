@@ -0,0 +1,110 @@
+#include "NeighborList.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace classical {
+
+	NeighborList::NeighborList()
+		: m_cutoff(-1.0), m_skin(0.0), m_nAtoms(-1), m_rebuildCount(0), m_updateCount(0), m_totalListLength(0) {
+
+	}
+
+	bool NeighborList::Update(const ParticleStore &particles, double cutoff, double skin, const PeriodicBox &box) {
+		m_updateCount++;
+
+		if (!NeedsRebuild(particles, cutoff, skin, box)) return false;
+
+		Build(particles, cutoff, skin, box);
+		return true;
+	}
+
+	void NeighborList::Build(const ParticleStore &particles, double cutoff, double skin, const PeriodicBox &box) {
+		int natoms = particles.GetSize();
+
+		m_cutoff = cutoff;
+		m_box = box;
+		m_skin = std::max(0.0, skin);
+		m_nAtoms = natoms;
+
+		m_offsets.assign(natoms + 1, 0);
+		m_neighbors.clear();
+		m_lowerOffsets.assign(natoms + 1, 0);
+		m_lowerNeighbors.clear();
+
+		if (cutoff <= 0.0) {
+			/* Without a cutoff every pair interacts, so there is nothing to store. */
+			m_sequence.resize(natoms);
+			std::iota(m_sequence.begin(), m_sequence.end(), 0);
+			return;
+		}
+
+		for (int j = 0; j < 3; j++) {
+			m_referencePositions[j] = particles.position[j];
+		}
+
+		m_cellList.Build(particles, cutoff + m_skin, box);
+
+		m_cellList.ForEachPair(particles, [&](int i, int, double) {
+			m_offsets[i + 1]++;
+		});
+
+		for (int i = 0; i < natoms; i++) {
+			m_offsets[i + 1] += m_offsets[i];
+		}
+
+		m_neighbors.resize(m_offsets[natoms]);
+
+		std::vector<int> fill(m_offsets.begin(), m_offsets.end() - 1);
+
+		m_cellList.ForEachPair(particles, [&](int i, int j, double) {
+			m_neighbors[fill[i]++] = j;
+		});
+
+		/* Ascending neighbor order keeps the j accesses moving forward through memory. */
+		for (int i = 0; i < natoms; i++) {
+			std::sort(m_neighbors.begin() + m_offsets[i], m_neighbors.begin() + m_offsets[i + 1]);
+		}
+
+		for (int j : m_neighbors) {
+			m_lowerOffsets[j + 1]++;
+		}
+
+		for (int i = 0; i < natoms; i++) {
+			m_lowerOffsets[i + 1] += m_lowerOffsets[i];
+		}
+
+		m_lowerNeighbors.resize(m_neighbors.size());
+		fill.assign(m_lowerOffsets.begin(), m_lowerOffsets.end() - 1);
+
+		for (int i = 0; i < natoms; i++) {
+			for (int n = m_offsets[i]; n < m_offsets[i + 1]; n++) {
+				m_lowerNeighbors[fill[m_neighbors[n]]++] = i;
+			}
+		}
+
+		m_rebuildCount++;
+		m_totalListLength += m_neighbors.size();
+	}
+
+	bool NeighborList::NeedsRebuild(const ParticleStore &particles, double cutoff, double skin, const PeriodicBox &box) const {
+		if (m_nAtoms != particles.GetSize() || cutoff != m_cutoff || std::max(0.0, skin) != m_skin || box != m_box) return true;
+
+		if (cutoff <= 0.0) {
+			return false;
+		}
+
+		double limit2 = 0.25 * m_skin * m_skin;
+
+		for (int i = 0; i < m_nAtoms; i++) {
+			double a = particles.position[0][i] - m_referencePositions[0][i];
+			double b = particles.position[1][i] - m_referencePositions[1][i];
+			double c = particles.position[2][i] - m_referencePositions[2][i];
+
+			if (a * a + b * b + c * c > limit2) return true;
+		}
+
+		return false;
+	}
+
+}
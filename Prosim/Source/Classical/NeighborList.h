@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+
+#include "CellList.h"
+#include "ParticleStore.h"
+
+#include "Math/PSMath.h"
+#include "Utils/IterationTools.h"
+
+namespace classical {
+
+	/* Verlet neighbor list. Pairs within cutoff + skin are gathered from a cell list and stored per atom; the list is
+	   only rebuilt once some atom has moved more than half the skin since the last build, because until then no pair
+	   outside the stored list can have come within the cutoff. A cutoff <= 0 stores nothing and generates all pairs on the fly.
+	   In a periodic box pairs are found across the faces and all distances are between nearest images; a change of the
+	   box forces a rebuild. */
+	class NeighborList {
+	public:
+		NeighborList();
+
+		/* Rebuilds the list if the cutoff, skin, box or atom count changed or an atom moved too far. Returns true on a rebuild. */
+		bool Update(const ParticleStore &particles, double cutoff, double skin, const PeriodicBox &box = PeriodicBox());
+		void Build(const ParticleStore &particles, double cutoff, double skin, const PeriodicBox &box = PeriodicBox());
+
+		/* Calls function(i, j, r2) once for every pair i < j with squared distance r2 below the squared cutoff. */
+		template <typename Function>
+		void ForEachPair(const ParticleStore &particles, Function function) const;
+
+		/* Candidate partners j > i of atom i in ascending order, which may lie up to the skin beyond the cutoff and so
+		   still have to be tested against it. Without a cutoff these are all atoms after i. */
+		inline const int *GetNeighbors(int i) const { return m_cutoff <= 0.0 ? m_sequence.data() + i + 1 : m_neighbors.data() + m_offsets[i]; }
+		inline int GetNNeighbors(int i) const { return m_cutoff <= 0.0 ? m_nAtoms - i - 1 : m_offsets[i + 1] - m_offsets[i]; }
+		/* Candidate partners j < i of atom i in ascending order, for loops in which every atom owns its full row. */
+		inline const int *GetLowerNeighbors(int i) const { return m_cutoff <= 0.0 ? m_sequence.data() : m_lowerNeighbors.data() + m_lowerOffsets[i]; }
+		inline int GetNLowerNeighbors(int i) const { return m_cutoff <= 0.0 ? i : m_lowerOffsets[i + 1] - m_lowerOffsets[i]; }
+
+		inline double GetCutoff() const { return m_cutoff; }
+		inline double GetSkin() const { return m_skin; }
+		inline long long GetNPairs() const { return m_neighbors.size(); }
+		inline int GetRebuildCount() const { return m_rebuildCount; }
+		inline int GetUpdateCount() const { return m_updateCount; }
+		/* Mean number of stored neighbors per atom, averaged over all builds. */
+		inline double GetAverageListLength() const { return m_rebuildCount && m_nAtoms ? (double)m_totalListLength / ((double)m_rebuildCount * m_nAtoms) : 0.0; }
+		inline const CellList &GetCellList() const { return m_cellList; }
+		inline const PeriodicBox &GetPeriodicBox() const { return m_box; }
+	private:
+		bool NeedsRebuild(const ParticleStore &particles, double cutoff, double skin, const PeriodicBox &box) const;
+	private:
+		CellList m_cellList;
+		PeriodicBox m_box;
+
+		double m_cutoff;
+		double m_skin;
+		int m_nAtoms;
+
+		/* Neighbors j > i of atom i are m_neighbors[m_offsets[i]] ... m_neighbors[m_offsets[i + 1] - 1]. */
+		std::vector<int> m_offsets;
+		std::vector<int> m_neighbors;
+		/* Transpose of the rows above: partners j < i of atom i. */
+		std::vector<int> m_lowerOffsets;
+		std::vector<int> m_lowerNeighbors;
+		std::vector<double> m_referencePositions[3];
+		/* 0 ... natoms - 1, standing in for the neighbor rows when there is no cutoff. */
+		std::vector<int> m_sequence;
+
+		int m_rebuildCount;
+		int m_updateCount;
+		long long m_totalListLength;
+	};
+
+	template <typename Function>
+	void NeighborList::ForEachPair(const ParticleStore &particles, Function function) const {
+		const double *x = particles.position[0].data();
+		const double *y = particles.position[1].data();
+		const double *z = particles.position[2].data();
+
+		if (m_cutoff <= 0.0) {
+			utils::ForEachPair(m_nAtoms, [&](int i, int j) {
+				double a = x[i] - x[j];
+				double b = y[i] - y[j];
+				double c = z[i] - z[j];
+
+				m_box.ApplyMinimumImage(a, b, c);
+
+				function(i, j, a * a + b * b + c * c);
+			});
+			return;
+		}
+
+		double cutoff2 = m_cutoff * m_cutoff;
+
+		for (int i = 0; i < m_nAtoms; i++) {
+			double xi = x[i];
+			double yi = y[i];
+			double zi = z[i];
+
+			for (int n = m_offsets[i]; n < m_offsets[i + 1]; n++) {
+				int j = m_neighbors[n];
+
+				double a = xi - x[j];
+				double b = yi - y[j];
+				double c = zi - z[j];
+
+				m_box.ApplyMinimumImage(a, b, c);
+
+				double r2 = a * a + b * b + c * c;
+
+				if (r2 < cutoff2) {
+					function(i, j, r2);
+				}
+			}
+		}
+	}
+
+}
@@ -0,0 +1,798 @@
+#include "NonBondedKernel.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+#include <omp.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PS_TARGET_AVX2
+#define PS_TARGET_AVX512
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define PS_TARGET_AVX2 __attribute__((target("avx2")))
+#define PS_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+#include "Constants.h"
+#include "Energy.h"
+#include "Gradient.h"
+
+namespace classical {
+
+	/* The SIMD kernels gather c12 and c6 with a stride of four doubles. */
+	static_assert(sizeof(VanDerWaalsPair) == 4 * sizeof(double), "VanDerWaalsPair must be four packed doubles");
+
+	/* Per-atom inputs of the pair kernels, gathered once per call so that a pair only needs products and sums. */
+	struct NonBondedKernelData {
+		const double *x;
+		const double *y;
+		const double *z;
+		const double *charge;
+		/* Type id of every atom and the type pair table of the particle store, so that a pair needs no square roots. */
+		const int *typeId;
+		const VanDerWaalsPair *vdwPairs;
+		int nTypes;
+		/* CEU_TO_KCAL / dielectric, multiplied by q_i q_j for the pair prefactor. */
+		double chargeScale;
+		double cutoff2;
+		ElectrostaticsMethod electrostatics;
+		double ewaldCoefficient;
+		/* k_rf and c_rf of the reaction field, or 1 / r_c^2 and 2 / r_c of the force-shifted form. */
+		double electrostaticsLinear;
+		double electrostaticsConstant;
+		/* Start of the van der Waals switch and 1 / (r_c - r_s); the switch is off when the latter is 0. */
+		double switchDistance;
+		double inverseSwitchWidth;
+		/* Box of the minimum image convention; not periodic without one. */
+		PeriodicBox box;
+	};
+
+	static void CPUID(int leaf, int subleaf, int registers[4]) {
+#ifdef _MSC_VER
+		__cpuidex(registers, leaf, subleaf);
+#else
+		unsigned int a, b, c, d;
+		__cpuid_count(leaf, subleaf, a, b, c, d);
+		registers[0] = a;
+		registers[1] = b;
+		registers[2] = c;
+		registers[3] = d;
+#endif
+	}
+
+	static unsigned long long GetEnabledXState() {
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned int a, d;
+		__asm__ volatile("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+		return ((unsigned long long)d << 32) | a;
+#endif
+	}
+
+	static NonBondedKernel DetectNonBondedKernel() {
+		int registers[4];
+
+		CPUID(0, 0, registers);
+		int maxLeaf = registers[0];
+
+		if (maxLeaf < 7) return NonBondedKernel::Scalar;
+
+		/* The instruction set has to be present and the OS has to save the wider registers on a context switch. */
+		CPUID(1, 0, registers);
+		bool osxsave = (registers[2] >> 27) & 1;
+		bool avx = (registers[2] >> 28) & 1;
+
+		if (!osxsave || !avx) return NonBondedKernel::Scalar;
+
+		unsigned long long xstate = GetEnabledXState();
+
+		CPUID(7, 0, registers);
+		bool avx2 = (registers[1] >> 5) & 1;
+		bool avx512f = (registers[1] >> 16) & 1;
+
+		if (avx512f && (xstate & 0xE6) == 0xE6) return NonBondedKernel::AVX512;
+		if (avx2 && (xstate & 0x6) == 0x6) return NonBondedKernel::AVX2;
+
+		return NonBondedKernel::Scalar;
+	}
+
+	NonBondedKernel GetBestNonBondedKernel() {
+		static const NonBondedKernel best = DetectNonBondedKernel();
+		return best;
+	}
+
+	bool IsNonBondedKernelSupported(NonBondedKernel kernel) {
+		return (int)kernel <= (int)GetBestNonBondedKernel();
+	}
+
+	String GetNonBondedKernelName(NonBondedKernel kernel) {
+		switch (kernel) {
+		case NonBondedKernel::AVX2: return "avx2";
+		case NonBondedKernel::AVX512: return "avx512";
+		default: return "scalar";
+		}
+	}
+
+	NonBondedKernel ResolveNonBondedKernel(const String &name) {
+		NonBondedKernel best = GetBestNonBondedKernel();
+		NonBondedKernel kernel;
+
+		if (name.find("auto") != String::npos) {
+			return best;
+		}
+		else if (name.find("scalar") != String::npos) {
+			kernel = NonBondedKernel::Scalar;
+		}
+		else if (name.find("avx512") != String::npos) {
+			kernel = NonBondedKernel::AVX512;
+		}
+		else if (name.find("avx2") != String::npos) {
+			kernel = NonBondedKernel::AVX2;
+		} else {
+			std::cout << "Unknown non-bonded kernel: " << name << std::endl;
+			std::cout << "Use 'auto', 'scalar', 'avx2' or 'avx512'" << std::endl;
+			return best;
+		}
+
+		if (!IsNonBondedKernelSupported(kernel)) {
+			std::cout << "Non-bonded kernel " << GetNonBondedKernelName(kernel) << " is not supported by this CPU, using " << GetNonBondedKernelName(best) << std::endl;
+			return best;
+		}
+
+		return kernel;
+	}
+
+	ElectrostaticsMethod ResolveElectrostaticsMethod(const String &name) {
+		if (name.find("coulomb") != String::npos) {
+			return ElectrostaticsMethod::Coulomb;
+		}
+		else if (name.find("pme") != String::npos) {
+			return ElectrostaticsMethod::PME;
+		}
+		else if (name.find("reaction-field") != String::npos) {
+			return ElectrostaticsMethod::ReactionField;
+		}
+		else if (name.find("force-shifted") != String::npos) {
+			return ElectrostaticsMethod::ForceShifted;
+		}
+
+		std::cout << "Unknown electrostatics method: " << name << std::endl;
+		std::cout << "Use 'coulomb', 'pme', 'reaction-field' or 'force-shifted'" << std::endl;
+		return ElectrostaticsMethod::Coulomb;
+	}
+
+	String GetElectrostaticsMethodName(ElectrostaticsMethod method) {
+		switch (method) {
+		case ElectrostaticsMethod::PME: return "pme";
+		case ElectrostaticsMethod::ReactionField: return "reaction-field";
+		case ElectrostaticsMethod::ForceShifted: return "force-shifted";
+		default: return "coulomb";
+		}
+	}
+
+	bool IsNonBondedKernelApplicable(NonBondedKernel kernel, ElectrostaticsMethod electrostatics, double vdwSwitchDistance, double cutoff) {
+		if (kernel == NonBondedKernel::Scalar) return true;
+
+		return electrostatics == ElectrostaticsMethod::Coulomb && !(cutoff > 0.0 && vdwSwitchDistance > 0.0 && vdwSwitchDistance < cutoff);
+	}
+
+	double GetEwaldRealSpaceCutoff(const NonBondedSettings &settings, const NeighborList &neighborList) {
+		double halfBox = 0.5 * settings.box.GetMinimumLength();
+
+		return neighborList.GetCutoff() > 0.0 ? std::min(neighborList.GetCutoff(), halfBox) : halfBox;
+	}
+
+	static void PrepareNonBondedKernelData(NonBondedKernelData &data, const NonBondedSettings &settings, const ParticleStore &particles, const NeighborList &neighborList, double dielectric, double ewaldCoefficient) {
+		data.x = particles.position[0].data();
+		data.y = particles.position[1].data();
+		data.z = particles.position[2].data();
+		data.charge = particles.charge.data();
+		data.typeId = particles.typeId.data();
+		data.vdwPairs = particles.vdwPairTable.data();
+		data.nTypes = particles.GetNTypes();
+
+		data.chargeScale = CEU_TO_KCAL / dielectric;
+
+		data.cutoff2 = neighborList.GetCutoff() > 0.0 ? neighborList.GetCutoff() * neighborList.GetCutoff() : std::numeric_limits<double>::infinity();
+
+		data.electrostatics = settings.electrostatics;
+		data.ewaldCoefficient = ewaldCoefficient;
+		data.electrostaticsLinear = 0.0;
+		data.electrostaticsConstant = 0.0;
+		data.switchDistance = 0.0;
+		data.inverseSwitchWidth = 0.0;
+		data.box = settings.box;
+
+		double cutoff = neighborList.GetCutoff();
+
+		/* Without a cutoff the constants stay 0 and both cutoff methods are plain Coulomb. */
+		if (cutoff > 0.0) {
+			if (settings.electrostatics == ElectrostaticsMethod::ReactionField) {
+				double reactionFieldDielectric = settings.reactionFieldDielectric;
+
+				data.electrostaticsLinear = (reactionFieldDielectric - dielectric) / ((2.0 * reactionFieldDielectric + dielectric) * cutoff * cutoff * cutoff);
+				data.electrostaticsConstant = 1.0 / cutoff + data.electrostaticsLinear * cutoff * cutoff;
+			}
+			else if (settings.electrostatics == ElectrostaticsMethod::ForceShifted) {
+				data.electrostaticsLinear = 1.0 / (cutoff * cutoff);
+				data.electrostaticsConstant = 2.0 / cutoff;
+			}
+
+			if (settings.vdwSwitchDistance > 0.0 && settings.vdwSwitchDistance < cutoff) {
+				data.switchDistance = settings.vdwSwitchDistance;
+				data.inverseSwitchWidth = 1.0 / (cutoff - settings.vdwSwitchDistance);
+			}
+		}
+
+		if (settings.electrostatics == ElectrostaticsMethod::PME) {
+			double realSpaceCutoff = GetEwaldRealSpaceCutoff(settings, neighborList);
+
+			data.cutoff2 = realSpaceCutoff * realSpaceCutoff;
+		}
+	}
+
+	/* Fills the atom indices of partners n ... n + width - 1 of a row and returns a bit mask of the lanes to evaluate.
+	   Exclusions are found by walking the sorted exclusion row alongside the sorted neighbor row; padding lanes point
+	   at atom i itself and are left out of the mask. */
+	static inline int PrepareLanes(int width, int i, const int *neighbors, int count, int n, const int *&exclusion, const int *exclusionEnd, int *lanes) {
+		int valid = 0;
+
+		for (int l = 0; l < width; l++) {
+			if (n + l >= count) {
+				lanes[l] = i;
+				continue;
+			}
+
+			int j = neighbors[n + l];
+			lanes[l] = j;
+
+			while (exclusion < exclusionEnd && *exclusion < j) exclusion++;
+
+			if (exclusion == exclusionEnd || *exclusion != j) {
+				valid |= 1 << l;
+			}
+		}
+
+		return valid;
+	}
+
+	/* Evaluates the pairs of atom i with one sorted partner segment. The gradient of atom i is added to gI (van der Waals
+	   x, y, z, then electrostatic x, y, z) and the energies and pair virial to e; the partner gradients are subtracted
+	   from gVDW and gElst unless those are null, as when every atom owns its full row. */
+	typedef void (*NonBondedRowFunction)(const NonBondedKernelData &data, int i, const int *neighbors, int count, const int *exclusion, const int *exclusionEnd, math::Vec3 *gVDW, math::Vec3 *gElst, double *gI, double *e);
+
+	static void AccumulateRowScalar(const NonBondedKernelData &data, int i, const int *neighbors, int count, const int *exclusion, const int *exclusionEnd, math::Vec3 *gVDW, math::Vec3 *gElst, double *gI, double *e) {
+		double chargeI = data.chargeScale * data.charge[i];
+		const VanDerWaalsPair *vdwPairsI = data.vdwPairs + data.typeId[i] * data.nTypes;
+		double twoAlphaOverRootPi = 2.0 * data.ewaldCoefficient / sqrt(M_PI);
+		double alpha2 = data.ewaldCoefficient * data.ewaldCoefficient;
+
+		for (int n = 0; n < count; n++) {
+			int j = neighbors[n];
+
+			while (exclusion < exclusionEnd && *exclusion < j) exclusion++;
+
+			if (exclusion < exclusionEnd && *exclusion == j) continue;
+
+			double a = data.x[i] - data.x[j];
+			double b = data.y[i] - data.y[j];
+			double c = data.z[i] - data.z[j];
+
+			data.box.ApplyMinimumImage(a, b, c);
+
+			double r2 = a * a + b * b + c * c;
+
+			if (r2 >= data.cutoff2) continue;
+
+			double inverseR2 = 1.0 / r2;
+			double inverseR = 1.0 / sqrt(r2);
+
+			const VanDerWaalsPair &vdwPair = vdwPairsI[data.typeId[j]];
+
+			double inverseR6 = inverseR2 * inverseR2 * inverseR2;
+			double c12OverR12 = vdwPair.c12 * inverseR6 * inverseR6;
+			double c6OverR6 = vdwPair.c6 * inverseR6;
+
+			double eVDWIJ = c12OverR12 - c6OverR6;
+			double gVDWOverR = (-12.0 * c12OverR12 + 6.0 * c6OverR6) * inverseR2;
+			double eElstIJ;
+			double gElstOverR;
+
+			double r = r2 * inverseR;
+
+			if (data.inverseSwitchWidth > 0.0 && r > data.switchDistance) {
+				/* S(x) = 1 - 10 x^3 + 15 x^4 - 6 x^5 has zero first and second derivatives at both ends. */
+				double x = (r - data.switchDistance) * data.inverseSwitchWidth;
+				double x2 = x * x;
+				double switchValue = 1.0 + x2 * x * (-10.0 + x * (15.0 - 6.0 * x));
+				double switchDerivative = -30.0 * x2 * (1.0 - x) * (1.0 - x) * data.inverseSwitchWidth;
+
+				gVDWOverR = gVDWOverR * switchValue + eVDWIJ * switchDerivative * inverseR;
+				eVDWIJ *= switchValue;
+			}
+
+			if (data.electrostatics == ElectrostaticsMethod::PME) {
+				/* Real-space Ewald term k q_i q_j erfc(alpha r) / r. */
+				double chargeIJ = chargeI * data.charge[j];
+
+				eElstIJ = chargeIJ * erfc(data.ewaldCoefficient * r) * inverseR;
+				gElstOverR = -(eElstIJ + chargeIJ * twoAlphaOverRootPi * exp(-alpha2 * r2)) * inverseR2;
+			}
+			else if (data.electrostatics == ElectrostaticsMethod::ReactionField) {
+				double chargeIJ = chargeI * data.charge[j];
+
+				eElstIJ = chargeIJ * (inverseR + data.electrostaticsLinear * r2 - data.electrostaticsConstant);
+				gElstOverR = chargeIJ * (2.0 * data.electrostaticsLinear - inverseR * inverseR2);
+			}
+			else if (data.electrostatics == ElectrostaticsMethod::ForceShifted) {
+				/* 1 / r - 1 / r_c + (r - r_c) / r_c^2 = 1 / r + r / r_c^2 - 2 / r_c. */
+				double chargeIJ = chargeI * data.charge[j];
+
+				eElstIJ = chargeIJ * (inverseR + data.electrostaticsLinear * r - data.electrostaticsConstant);
+				gElstOverR = chargeIJ * (data.electrostaticsLinear - inverseR2) * inverseR;
+			} else {
+				eElstIJ = chargeI * data.charge[j] * inverseR;
+				gElstOverR = -eElstIJ * inverseR2;
+			}
+
+			e[0] += eVDWIJ;
+			e[1] += eElstIJ;
+			e[2] -= (gVDWOverR + gElstOverR) * r2;
+
+			gI[0] += gVDWOverR * a;
+			gI[1] += gVDWOverR * b;
+			gI[2] += gVDWOverR * c;
+			gI[3] += gElstOverR * a;
+			gI[4] += gElstOverR * b;
+			gI[5] += gElstOverR * c;
+
+			if (gVDW) {
+				gVDW[j] -= math::Vec3(gVDWOverR * a, gVDWOverR * b, gVDWOverR * c);
+				gElst[j] -= math::Vec3(gElstOverR * a, gElstOverR * b, gElstOverR * c);
+			}
+		}
+	}
+
+	/* Subtracts the partner gradients of one block. */
+	static inline void ScatterPartnerGradients(math::Vec3 *gVDW, math::Vec3 *gElst, const int *lanes, int width,
+		const double *gVDWX, const double *gVDWY, const double *gVDWZ, const double *gElstX, const double *gElstY, const double *gElstZ) {
+
+		for (int l = 0; l < width; l++) {
+			gVDW[lanes[l]] -= math::Vec3(gVDWX[l], gVDWY[l], gVDWZ[l]);
+			gElst[lanes[l]] -= math::Vec3(gElstX[l], gElstY[l], gElstZ[l]);
+		}
+	}
+
+	/* The unmasked gathers and several AVX-512 intrinsics start from an undefined register in the GCC headers, which GCC
+	   reports as possibly uninitialized once they are inlined into the kernels below. */
+#ifndef _MSC_VER
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+	PS_TARGET_AVX2 static inline double HorizontalSumAVX2(__m256d value) {
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(value), _mm256_extractf128_pd(value, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+	}
+
+	PS_TARGET_AVX2 static void AccumulateRowAVX2(const NonBondedKernelData &data, int i, const int *neighbors, int count, const int *exclusion, const int *exclusionEnd, math::Vec3 *gVDW, math::Vec3 *gElst, double *gI, double *e) {
+		const int width = 4;
+
+		if (count == 0) return;
+
+		const __m256d zero = _mm256_setzero_pd();
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d six = _mm256_set1_pd(6.0);
+		const __m256d minusTwelve = _mm256_set1_pd(-12.0);
+		const __m256d cutoff2 = _mm256_set1_pd(data.cutoff2);
+		const __m256i laneBits = _mm256_set_epi64x(8, 4, 2, 1);
+		const bool periodic = data.box.IsPeriodic();
+		const __m256d boxX = _mm256_set1_pd(data.box.GetLength(0));
+		const __m256d boxY = _mm256_set1_pd(data.box.GetLength(1));
+		const __m256d boxZ = _mm256_set1_pd(data.box.GetLength(2));
+		const __m256d inverseBoxX = _mm256_set1_pd(data.box.GetInverseLength(0));
+		const __m256d inverseBoxY = _mm256_set1_pd(data.box.GetInverseLength(1));
+		const __m256d inverseBoxZ = _mm256_set1_pd(data.box.GetInverseLength(2));
+
+		alignas(32) int lanes[width];
+		alignas(32) double blockGVDWX[width], blockGVDWY[width], blockGVDWZ[width];
+		alignas(32) double blockGElstX[width], blockGElstY[width], blockGElstZ[width];
+
+		__m256d xi = _mm256_set1_pd(data.x[i]);
+		__m256d yi = _mm256_set1_pd(data.y[i]);
+		__m256d zi = _mm256_set1_pd(data.z[i]);
+		__m128i typeRowI = _mm_set1_epi32(data.typeId[i] * data.nTypes);
+		__m256d scaledChargeI = _mm256_set1_pd(data.chargeScale * data.charge[i]);
+
+		__m256d gVDWXI = zero, gVDWYI = zero, gVDWZI = zero;
+		__m256d gElstXI = zero, gElstYI = zero, gElstZI = zero;
+		__m256d eVDWI = zero, eElstI = zero, virialI = zero;
+
+		for (int n = 0; n < count; n += width) {
+			int valid = PrepareLanes(width, i, neighbors, count, n, exclusion, exclusionEnd, lanes);
+
+			__m128i index = _mm_load_si128((const __m128i *)lanes);
+
+			__m256d a = _mm256_sub_pd(xi, _mm256_i32gather_pd(data.x, index, 8));
+			__m256d b = _mm256_sub_pd(yi, _mm256_i32gather_pd(data.y, index, 8));
+			__m256d c = _mm256_sub_pd(zi, _mm256_i32gather_pd(data.z, index, 8));
+
+			if (periodic) {
+				a = _mm256_sub_pd(a, _mm256_mul_pd(boxX, _mm256_round_pd(_mm256_mul_pd(a, inverseBoxX), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+				b = _mm256_sub_pd(b, _mm256_mul_pd(boxY, _mm256_round_pd(_mm256_mul_pd(b, inverseBoxY), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+				c = _mm256_sub_pd(c, _mm256_mul_pd(boxZ, _mm256_round_pd(_mm256_mul_pd(c, inverseBoxZ), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+			}
+
+			__m256d r2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b)), _mm256_mul_pd(c, c));
+
+			__m256d validMask = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(valid), laneBits), laneBits));
+			__m256d mask = _mm256_and_pd(validMask, _mm256_cmp_pd(r2, cutoff2, _CMP_LT_OQ));
+
+			/* Masked lanes get r2 = 1 so that padding (r2 = 0) never produces infinities. */
+			r2 = _mm256_blendv_pd(one, r2, mask);
+
+			__m256d inverseR2 = _mm256_div_pd(one, r2);
+			__m256d inverseR = _mm256_div_pd(one, _mm256_sqrt_pd(r2));
+
+			/* Offset of the pair entry in doubles, four per VanDerWaalsPair. */
+			__m128i pairIndex = _mm_slli_epi32(_mm_add_epi32(typeRowI, _mm_i32gather_epi32(data.typeId, index, 4)), 2);
+			__m256d c12 = _mm256_i32gather_pd(&data.vdwPairs->c12, pairIndex, 8);
+			__m256d c6 = _mm256_i32gather_pd(&data.vdwPairs->c6, pairIndex, 8);
+			__m256d chargeIJ = _mm256_mul_pd(scaledChargeI, _mm256_i32gather_pd(data.charge, index, 8));
+
+			__m256d inverseR6 = _mm256_mul_pd(_mm256_mul_pd(inverseR2, inverseR2), inverseR2);
+			__m256d c12OverR12 = _mm256_mul_pd(_mm256_mul_pd(c12, inverseR6), inverseR6);
+			__m256d c6OverR6 = _mm256_mul_pd(c6, inverseR6);
+
+			__m256d eVDWIJ = _mm256_and_pd(mask, _mm256_sub_pd(c12OverR12, c6OverR6));
+			/* Gradient magnitudes divided by r, so that multiplying by (a, b, c) gives the gradient of atom i. */
+			__m256d gVDWOverR = _mm256_and_pd(mask, _mm256_mul_pd(_mm256_add_pd(_mm256_mul_pd(minusTwelve, c12OverR12), _mm256_mul_pd(six, c6OverR6)), inverseR2));
+			__m256d eElstIJ = _mm256_and_pd(mask, _mm256_mul_pd(chargeIJ, inverseR));
+			__m256d gElstOverR = _mm256_sub_pd(zero, _mm256_mul_pd(eElstIJ, inverseR2));
+
+			eVDWI = _mm256_add_pd(eVDWI, eVDWIJ);
+			eElstI = _mm256_add_pd(eElstI, eElstIJ);
+			virialI = _mm256_sub_pd(virialI, _mm256_mul_pd(_mm256_add_pd(gVDWOverR, gElstOverR), r2));
+
+			__m256d gVDWX = _mm256_mul_pd(gVDWOverR, a);
+			__m256d gVDWY = _mm256_mul_pd(gVDWOverR, b);
+			__m256d gVDWZ = _mm256_mul_pd(gVDWOverR, c);
+			__m256d gElstX = _mm256_mul_pd(gElstOverR, a);
+			__m256d gElstY = _mm256_mul_pd(gElstOverR, b);
+			__m256d gElstZ = _mm256_mul_pd(gElstOverR, c);
+
+			gVDWXI = _mm256_add_pd(gVDWXI, gVDWX);
+			gVDWYI = _mm256_add_pd(gVDWYI, gVDWY);
+			gVDWZI = _mm256_add_pd(gVDWZI, gVDWZ);
+			gElstXI = _mm256_add_pd(gElstXI, gElstX);
+			gElstYI = _mm256_add_pd(gElstYI, gElstY);
+			gElstZI = _mm256_add_pd(gElstZI, gElstZ);
+
+			if (gVDW) {
+				_mm256_store_pd(blockGVDWX, gVDWX);
+				_mm256_store_pd(blockGVDWY, gVDWY);
+				_mm256_store_pd(blockGVDWZ, gVDWZ);
+				_mm256_store_pd(blockGElstX, gElstX);
+				_mm256_store_pd(blockGElstY, gElstY);
+				_mm256_store_pd(blockGElstZ, gElstZ);
+
+				ScatterPartnerGradients(gVDW, gElst, lanes, std::min(width, count - n), blockGVDWX, blockGVDWY, blockGVDWZ, blockGElstX, blockGElstY, blockGElstZ);
+			}
+		}
+
+		gI[0] += HorizontalSumAVX2(gVDWXI);
+		gI[1] += HorizontalSumAVX2(gVDWYI);
+		gI[2] += HorizontalSumAVX2(gVDWZI);
+		gI[3] += HorizontalSumAVX2(gElstXI);
+		gI[4] += HorizontalSumAVX2(gElstYI);
+		gI[5] += HorizontalSumAVX2(gElstZI);
+
+		e[0] += HorizontalSumAVX2(eVDWI);
+		e[1] += HorizontalSumAVX2(eElstI);
+		e[2] += HorizontalSumAVX2(virialI);
+	}
+
+	PS_TARGET_AVX512 static void AccumulateRowAVX512(const NonBondedKernelData &data, int i, const int *neighbors, int count, const int *exclusion, const int *exclusionEnd, math::Vec3 *gVDW, math::Vec3 *gElst, double *gI, double *e) {
+		const int width = 8;
+
+		if (count == 0) return;
+
+		const __m512d zero = _mm512_setzero_pd();
+		const __m512d one = _mm512_set1_pd(1.0);
+		const __m512d six = _mm512_set1_pd(6.0);
+		const __m512d minusTwelve = _mm512_set1_pd(-12.0);
+		const __m512d cutoff2 = _mm512_set1_pd(data.cutoff2);
+		const bool periodic = data.box.IsPeriodic();
+		const __m512d boxX = _mm512_set1_pd(data.box.GetLength(0));
+		const __m512d boxY = _mm512_set1_pd(data.box.GetLength(1));
+		const __m512d boxZ = _mm512_set1_pd(data.box.GetLength(2));
+		const __m512d inverseBoxX = _mm512_set1_pd(data.box.GetInverseLength(0));
+		const __m512d inverseBoxY = _mm512_set1_pd(data.box.GetInverseLength(1));
+		const __m512d inverseBoxZ = _mm512_set1_pd(data.box.GetInverseLength(2));
+
+		alignas(64) int lanes[width];
+		alignas(64) double blockGVDWX[width], blockGVDWY[width], blockGVDWZ[width];
+		alignas(64) double blockGElstX[width], blockGElstY[width], blockGElstZ[width];
+
+		__m512d xi = _mm512_set1_pd(data.x[i]);
+		__m512d yi = _mm512_set1_pd(data.y[i]);
+		__m512d zi = _mm512_set1_pd(data.z[i]);
+		__m256i typeRowI = _mm256_set1_epi32(data.typeId[i] * data.nTypes);
+		__m512d scaledChargeI = _mm512_set1_pd(data.chargeScale * data.charge[i]);
+
+		__m512d gVDWXI = zero, gVDWYI = zero, gVDWZI = zero;
+		__m512d gElstXI = zero, gElstYI = zero, gElstZI = zero;
+		__m512d eVDWI = zero, eElstI = zero, virialI = zero;
+
+		for (int n = 0; n < count; n += width) {
+			__mmask8 valid = (__mmask8)PrepareLanes(width, i, neighbors, count, n, exclusion, exclusionEnd, lanes);
+
+			__m256i index = _mm256_load_si256((const __m256i *)lanes);
+
+			__m512d a = _mm512_sub_pd(xi, _mm512_i32gather_pd(index, data.x, 8));
+			__m512d b = _mm512_sub_pd(yi, _mm512_i32gather_pd(index, data.y, 8));
+			__m512d c = _mm512_sub_pd(zi, _mm512_i32gather_pd(index, data.z, 8));
+
+			if (periodic) {
+				a = _mm512_sub_pd(a, _mm512_mul_pd(boxX, _mm512_roundscale_pd(_mm512_mul_pd(a, inverseBoxX), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+				b = _mm512_sub_pd(b, _mm512_mul_pd(boxY, _mm512_roundscale_pd(_mm512_mul_pd(b, inverseBoxY), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+				c = _mm512_sub_pd(c, _mm512_mul_pd(boxZ, _mm512_roundscale_pd(_mm512_mul_pd(c, inverseBoxZ), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+			}
+
+			__m512d r2 = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(a, a), _mm512_mul_pd(b, b)), _mm512_mul_pd(c, c));
+
+			__mmask8 mask = _mm512_mask_cmp_pd_mask(valid, r2, cutoff2, _CMP_LT_OQ);
+
+			/* Masked lanes get r2 = 1 so that padding (r2 = 0) never produces infinities. */
+			r2 = _mm512_mask_blend_pd(mask, one, r2);
+
+			__m512d inverseR2 = _mm512_div_pd(one, r2);
+			__m512d inverseR = _mm512_div_pd(one, _mm512_sqrt_pd(r2));
+
+			/* Offset of the pair entry in doubles, four per VanDerWaalsPair. */
+			__m256i pairIndex = _mm256_slli_epi32(_mm256_add_epi32(typeRowI, _mm256_i32gather_epi32(data.typeId, index, 4)), 2);
+			__m512d c12 = _mm512_i32gather_pd(pairIndex, &data.vdwPairs->c12, 8);
+			__m512d c6 = _mm512_i32gather_pd(pairIndex, &data.vdwPairs->c6, 8);
+			__m512d chargeIJ = _mm512_mul_pd(scaledChargeI, _mm512_i32gather_pd(index, data.charge, 8));
+
+			__m512d inverseR6 = _mm512_mul_pd(_mm512_mul_pd(inverseR2, inverseR2), inverseR2);
+			__m512d c12OverR12 = _mm512_mul_pd(_mm512_mul_pd(c12, inverseR6), inverseR6);
+			__m512d c6OverR6 = _mm512_mul_pd(c6, inverseR6);
+
+			__m512d eVDWIJ = _mm512_maskz_mov_pd(mask, _mm512_sub_pd(c12OverR12, c6OverR6));
+			/* Gradient magnitudes divided by r, so that multiplying by (a, b, c) gives the gradient of atom i. */
+			__m512d gVDWOverR = _mm512_maskz_mov_pd(mask, _mm512_mul_pd(_mm512_add_pd(_mm512_mul_pd(minusTwelve, c12OverR12), _mm512_mul_pd(six, c6OverR6)), inverseR2));
+			__m512d eElstIJ = _mm512_maskz_mov_pd(mask, _mm512_mul_pd(chargeIJ, inverseR));
+			__m512d gElstOverR = _mm512_sub_pd(zero, _mm512_mul_pd(eElstIJ, inverseR2));
+
+			eVDWI = _mm512_add_pd(eVDWI, eVDWIJ);
+			eElstI = _mm512_add_pd(eElstI, eElstIJ);
+			virialI = _mm512_sub_pd(virialI, _mm512_mul_pd(_mm512_add_pd(gVDWOverR, gElstOverR), r2));
+
+			__m512d gVDWX = _mm512_mul_pd(gVDWOverR, a);
+			__m512d gVDWY = _mm512_mul_pd(gVDWOverR, b);
+			__m512d gVDWZ = _mm512_mul_pd(gVDWOverR, c);
+			__m512d gElstX = _mm512_mul_pd(gElstOverR, a);
+			__m512d gElstY = _mm512_mul_pd(gElstOverR, b);
+			__m512d gElstZ = _mm512_mul_pd(gElstOverR, c);
+
+			gVDWXI = _mm512_add_pd(gVDWXI, gVDWX);
+			gVDWYI = _mm512_add_pd(gVDWYI, gVDWY);
+			gVDWZI = _mm512_add_pd(gVDWZI, gVDWZ);
+			gElstXI = _mm512_add_pd(gElstXI, gElstX);
+			gElstYI = _mm512_add_pd(gElstYI, gElstY);
+			gElstZI = _mm512_add_pd(gElstZI, gElstZ);
+
+			if (gVDW) {
+				_mm512_store_pd(blockGVDWX, gVDWX);
+				_mm512_store_pd(blockGVDWY, gVDWY);
+				_mm512_store_pd(blockGVDWZ, gVDWZ);
+				_mm512_store_pd(blockGElstX, gElstX);
+				_mm512_store_pd(blockGElstY, gElstY);
+				_mm512_store_pd(blockGElstZ, gElstZ);
+
+				ScatterPartnerGradients(gVDW, gElst, lanes, std::min(width, count - n), blockGVDWX, blockGVDWY, blockGVDWZ, blockGElstX, blockGElstY, blockGElstZ);
+			}
+		}
+
+		gI[0] += _mm512_reduce_add_pd(gVDWXI);
+		gI[1] += _mm512_reduce_add_pd(gVDWYI);
+		gI[2] += _mm512_reduce_add_pd(gVDWZI);
+		gI[3] += _mm512_reduce_add_pd(gElstXI);
+		gI[4] += _mm512_reduce_add_pd(gElstYI);
+		gI[5] += _mm512_reduce_add_pd(gElstZI);
+
+		e[0] += _mm512_reduce_add_pd(eVDWI);
+		e[1] += _mm512_reduce_add_pd(eElstI);
+		e[2] += _mm512_reduce_add_pd(virialI);
+	}
+
+#ifndef _MSC_VER
+#pragma GCC diagnostic pop
+#endif
+
+	static NonBondedRowFunction GetNonBondedRowFunction(NonBondedKernel kernel, const NonBondedKernelData &data) {
+		/* The SIMD kernels only implement plain Coulomb and unswitched van der Waals. */
+		if (data.electrostatics != ElectrostaticsMethod::Coulomb || data.inverseSwitchWidth > 0.0) return AccumulateRowScalar;
+
+		if (kernel == NonBondedKernel::AVX512 && IsNonBondedKernelSupported(NonBondedKernel::AVX512)) return AccumulateRowAVX512;
+		if (kernel != NonBondedKernel::Scalar && IsNonBondedKernelSupported(NonBondedKernel::AVX2)) return AccumulateRowAVX2;
+
+		return AccumulateRowScalar;
+	}
+
+	void AccumulateEGNonBondedPairs(const NonBondedSettings &settings, NonBondedWorkspace &workspace, std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, double &eVDW, double &eElst, double &virial, const ParticleStore &particles, const NeighborList &neighborList, const ExclusionTable &exclusions, double dielectric, double ewaldCoefficient) {
+		int natoms = particles.GetSize();
+
+		NonBondedKernelData data;
+		PrepareNonBondedKernelData(data, settings, particles, neighborList, dielectric, ewaldCoefficient);
+
+		NonBondedRowFunction row = GetNonBondedRowFunction(settings.kernel, data);
+
+		const int *exclusionOffsets = exclusions.GetOffsets().data();
+		const int *exclusionPartners = exclusions.GetPartners().data();
+		const int *lowerExclusionOffsets = exclusions.GetLowerOffsets().data();
+		const int *lowerExclusionPartners = exclusions.GetLowerPartners().data();
+
+		workspace.rowEnergies.resize(3 * natoms);
+
+		if (settings.deterministic) {
+			/* Every atom owns its full row and only writes its own gradient, so nothing depends on which thread ran it. */
+#pragma omp parallel for schedule(dynamic, 16)
+			for (int i = 0; i < natoms; i++) {
+				double gI[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+				double e[3] = { 0.0, 0.0, 0.0 };
+
+				row(data, i, neighborList.GetNeighbors(i), neighborList.GetNNeighbors(i), exclusionPartners + exclusionOffsets[i], exclusionPartners + exclusionOffsets[i + 1], nullptr, nullptr, gI, e);
+				row(data, i, neighborList.GetLowerNeighbors(i), neighborList.GetNLowerNeighbors(i), lowerExclusionPartners + lowerExclusionOffsets[i], lowerExclusionPartners + lowerExclusionOffsets[i + 1], nullptr, nullptr, gI, e);
+
+				gVDW[i] += math::Vec3(gI[0], gI[1], gI[2]);
+				gElst[i] += math::Vec3(gI[3], gI[4], gI[5]);
+
+				/* Each pair was evaluated from both of its atoms. */
+				for (int k = 0; k < 3; k++) {
+					workspace.rowEnergies[3 * i + k] = 0.5 * e[k];
+				}
+			}
+		} else {
+#pragma omp parallel
+			{
+				int nthreads = omp_get_num_threads();
+				int thread = omp_get_thread_num();
+
+#pragma omp single
+				{
+					workspace.gVDW.resize(nthreads);
+					workspace.gElst.resize(nthreads);
+				}
+
+				std::vector<math::Vec3> &threadGVDW = workspace.gVDW[thread];
+				std::vector<math::Vec3> &threadGElst = workspace.gElst[thread];
+
+				threadGVDW.assign(natoms, math::Vec3());
+				threadGElst.assign(natoms, math::Vec3());
+
+				/* A static schedule hands every thread the same rows on every call, so the result is reproducible for a given thread count. */
+#pragma omp for schedule(static, 16)
+				for (int i = 0; i < natoms; i++) {
+					double gI[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+					double e[3] = { 0.0, 0.0, 0.0 };
+
+					row(data, i, neighborList.GetNeighbors(i), neighborList.GetNNeighbors(i), exclusionPartners + exclusionOffsets[i], exclusionPartners + exclusionOffsets[i + 1], threadGVDW.data(), threadGElst.data(), gI, e);
+
+					threadGVDW[i] += math::Vec3(gI[0], gI[1], gI[2]);
+					threadGElst[i] += math::Vec3(gI[3], gI[4], gI[5]);
+
+					for (int k = 0; k < 3; k++) {
+						workspace.rowEnergies[3 * i + k] = e[k];
+					}
+				}
+
+				/* Pairwise tree reduction of the thread buffers, split over atoms. */
+#pragma omp for schedule(static)
+				for (int i = 0; i < natoms; i++) {
+					for (int stride = 1; stride < nthreads; stride *= 2) {
+						for (int t = 0; t + stride < nthreads; t += 2 * stride) {
+							workspace.gVDW[t][i] += workspace.gVDW[t + stride][i];
+							workspace.gElst[t][i] += workspace.gElst[t + stride][i];
+						}
+					}
+
+					gVDW[i] += workspace.gVDW[0][i];
+					gElst[i] += workspace.gElst[0][i];
+				}
+			}
+		}
+
+		/* Row sums are added in atom order, so the energies do not depend on the schedule either. */
+		for (int i = 0; i < natoms; i++) {
+			eVDW += workspace.rowEnergies[3 * i];
+			eElst += workspace.rowEnergies[3 * i + 1];
+			virial += workspace.rowEnergies[3 * i + 2];
+		}
+	}
+
+	bool VerifyNonBondedKernel(NonBondedKernel kernel, bool deterministic, const ParticleStore &particles, const NeighborList &neighborList, const ExclusionTable &exclusions, double dielectric, double tolerance) {
+		int natoms = particles.GetSize();
+
+		double referenceEVDW = 0.0;
+		double referenceEElst = 0.0;
+		std::vector<double> referenceGradient[3];
+
+		for (int k = 0; k < 3; k++) {
+			referenceGradient[k].assign(natoms, 0.0);
+		}
+
+		const PeriodicBox &box = neighborList.GetPeriodicBox();
+
+		neighborList.ForEachPair(particles, [&](int i, int j, double r2) {
+			if (exclusions.IsExcluded(i, j)) return;
+
+			double distance = sqrt(r2);
+			const VanDerWaalsPair &vdwPair = particles.GetVanDerWaalsPair(i, j);
+			double vdwAttractionMagnitudeIJ = vdwPair.attractionMagnitude;
+			double vdwRadiusIJ = vdwPair.radius;
+
+			referenceEVDW += GetEVDWIJ(distance, vdwAttractionMagnitudeIJ, vdwRadiusIJ);
+			referenceEElst += GetEElstIJ(distance, particles.charge[i], particles.charge[j], dielectric);
+
+			double gMagnitude = GetGMagnitudeVDWIJ(distance, vdwAttractionMagnitudeIJ, vdwRadiusIJ) + GetGMagnitudeElstIJ(distance, particles.charge[i], particles.charge[j], dielectric);
+
+			double separation[3];
+
+			for (int k = 0; k < 3; k++) {
+				separation[k] = particles.position[k][i] - particles.position[k][j];
+			}
+
+			box.ApplyMinimumImage(separation[0], separation[1], separation[2]);
+
+			for (int k = 0; k < 3; k++) {
+				double g = gMagnitude * separation[k] / distance;
+				referenceGradient[k][i] += g;
+				referenceGradient[k][j] -= g;
+			}
+		});
+
+		std::vector<math::Vec3> gVDW(natoms);
+		std::vector<math::Vec3> gElst(natoms);
+		double eVDW;
+		double eElst;
+		double virial;
+
+		/* Zero 1-4 scales leave only the pair loop that the reference covers. */
+		NonBondedSettings settings;
+		settings.kernel = kernel;
+		settings.deterministic = deterministic;
+		settings.box = box;
+
+		CalculateEGNonBonded(gVDW, gElst, eVDW, eElst, virial, particles, neighborList, exclusions, dielectric, 0.0, 0.0, settings);
+
+		double eError = std::max(fabs(eVDW - referenceEVDW) / std::max(1.0, fabs(referenceEVDW)), fabs(eElst - referenceEElst) / std::max(1.0, fabs(referenceEElst)));
+		double gError = 0.0;
+		double gMax = 1.0;
+
+		for (int i = 0; i < natoms; i++) {
+			for (int k = 0; k < 3; k++) {
+				gError = std::max(gError, fabs((double)gVDW[i][k] + (double)gElst[i][k] - referenceGradient[k][i]));
+				gMax = std::max(gMax, fabs(referenceGradient[k][i]));
+			}
+		}
+
+		gError /= gMax;
+
+		if (eError > tolerance || gError > tolerance) {
+			std::cout << "Non-bonded kernel " << GetNonBondedKernelName(kernel) << " differs from the scalar reference: relative energy error " << eError << ", relative gradient error " << gError << ", tolerance " << tolerance << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+}
\ No newline at end of file
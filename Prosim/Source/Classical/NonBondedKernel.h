@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+
+#include "ExclusionTable.h"
+#include "NeighborList.h"
+#include "ParticleMeshEwald.h"
+#include "ParticleStore.h"
+#include "PeriodicBox.h"
+
+#include "Math/PSMath.h"
+#include "Utils/String.h"
+
+namespace classical {
+
+	/* Instruction sets the non-bonded pair kernel can be dispatched to. */
+	enum class NonBondedKernel {
+		Scalar,
+		AVX2,
+		AVX512
+	};
+
+	/* Maps "auto", "scalar", "avx2" or "avx512" to a kernel the running CPU supports. "auto" and any unsupported or
+	   unknown request fall back to the widest supported instruction set. */
+	NonBondedKernel ResolveNonBondedKernel(const String &name);
+	NonBondedKernel GetBestNonBondedKernel();
+	bool IsNonBondedKernelSupported(NonBondedKernel kernel);
+	String GetNonBondedKernelName(NonBondedKernel kernel);
+
+	/* Treatment of the electrostatic interactions. Coulomb is the plain 1 / r sum over the neighbor list; PME splits it
+	   into an erfc(alpha r) / r real-space sum over the neighbor list and a smooth particle mesh Ewald reciprocal sum,
+	   both in a periodic orthorhombic box. The two cutoff methods bring the pair energy and force smoothly to zero at the
+	   non-bonded cutoff:
+	   reaction field      k q_i q_j (1 / r + k_rf r^2 - c_rf), k_rf = (eps_rf - eps) / ((2 eps_rf + eps) r_c^3),
+	   force shifted       k q_i q_j (1 / r - 1 / r_c + (r - r_c) / r_c^2).
+	   Without a cutoff both reduce to plain Coulomb. */
+	enum class ElectrostaticsMethod {
+		Coulomb,
+		PME,
+		ReactionField,
+		ForceShifted
+	};
+
+	/* Maps "coulomb", "pme", "reaction-field" or "force-shifted" to a method; anything else is reported and falls back
+	   to Coulomb. */
+	ElectrostaticsMethod ResolveElectrostaticsMethod(const String &name);
+	String GetElectrostaticsMethodName(ElectrostaticsMethod method);
+
+	/* Whether the kernel implements the electrostatics and van der Waals switch in effect at the cutoff. The SIMD kernels
+	   only implement plain Coulomb and unswitched van der Waals; the pair loop runs the scalar kernel otherwise. */
+	bool IsNonBondedKernelApplicable(NonBondedKernel kernel, ElectrostaticsMethod electrostatics, double vdwSwitchDistance, double cutoff);
+
+	/* How the non-bonded pass is evaluated. */
+	struct NonBondedSettings {
+		NonBondedKernel kernel;
+		bool deterministic;
+		ElectrostaticsMethod electrostatics;
+		/* Relative size erfc(alpha r_c) of the real-space terms at the real-space cutoff. */
+		double ewaldTolerance;
+		/* Largest PME grid spacing in A and the B-spline order. */
+		double pmeGridSpacing;
+		int pmeOrder;
+		/* Dielectric constant of the continuum beyond the cutoff for the reaction field. */
+		double reactionFieldDielectric;
+		/* Van der Waals energies are switched off smoothly between this distance and the cutoff; 0 disables it. */
+		double vdwSwitchDistance;
+		/* Pair distances are taken between nearest images in a periodic box; PME needs one. */
+		PeriodicBox box;
+
+		NonBondedSettings()
+			: kernel(NonBondedKernel::Scalar), deterministic(false), electrostatics(ElectrostaticsMethod::Coulomb),
+			ewaldTolerance(1e-5), pmeGridSpacing(1.0), pmeOrder(4), reactionFieldDielectric(78.5), vdwSwitchDistance(0.0) {
+
+		}
+	};
+
+	/* Scratch space of the threaded pair loop, kept between calls so that it is not reallocated every step. */
+	struct NonBondedWorkspace {
+		/* One gradient buffer per thread, reduced pairwise after the pair loop. */
+		std::vector<std::vector<math::Vec3>> gVDW;
+		std::vector<std::vector<math::Vec3>> gElst;
+		/* van der Waals energy, electrostatic energy and pair virial of every row. */
+		std::vector<double> rowEnergies;
+		/* Charge grid and spline weights of the reciprocal sum. */
+		ParticleMeshEwald pme;
+	};
+
+	/* Threaded pair loop over the neighbor rows. The SIMD kernels process 4 (AVX2) or 8 (AVX-512) partners at a time in
+	   double precision, with excluded, out of range and padding lanes masked out. By default every thread scatters
+	   into its own gradient buffer and the buffers are tree-reduced, which is reproducible for a fixed thread count.
+	   A deterministic loop instead lets every atom own its full row and evaluates each pair from both ends, at twice
+	   the arithmetic, so the result is bitwise identical for any number of threads.
+	   Only plain Coulomb without a van der Waals switch has SIMD kernels; the other methods run the scalar kernel. All
+	   kernels use the minimum image convention in a periodic box.
+	   Adds to the given gradients, energies and pair virial; 1-4 pairs are left to the caller. */
+	void AccumulateEGNonBondedPairs(const NonBondedSettings &settings, NonBondedWorkspace &workspace, std::vector<math::Vec3> &gVDW, std::vector<math::Vec3> &gElst, double &eVDW, double &eElst, double &virial, const ParticleStore &particles, const NeighborList &neighborList, const ExclusionTable &exclusions, double dielectric, double ewaldCoefficient);
+
+	/* Real-space cutoff of PME: the non-bonded cutoff, but never more than half the shortest box edge. */
+	double GetEwaldRealSpaceCutoff(const NonBondedSettings &settings, const NeighborList &neighborList);
+
+	/* Compares the kernel against a reference built from GetEVDWIJ, GetEElstIJ, GetGMagnitudeVDWIJ and GetGMagnitudeElstIJ
+	   on the current configuration. Energy errors are relative to max(1, |E|), gradient errors to max(1, max |g|).
+	   Distances use the periodic box of the neighbor list. Returns false and reports the errors if either exceeds the
+	   tolerance. */
+	bool VerifyNonBondedKernel(NonBondedKernel kernel, bool deterministic, const ParticleStore &particles, const NeighborList &neighborList, const ExclusionTable &exclusions, double dielectric, double tolerance);
+
+}
\ No newline at end of file
@@ -6,7 +6,7 @@
 namespace classical {
 
 	OutOfPlane::OutOfPlane(int atom1, int atom2, int atom3, int atom4, double degrees, double halfBarrierHeight)
-		: atom1(atom1), atom2(atom2), atom3(atom3), atom4(atom4), degrees(degrees), halfBarrierHeight(halfBarrierHeight) {
+		: atom1(atom1), atom2(atom2), atom3(atom3), atom4(atom4), bond31(-1), bond32(-1), bond34(-1), degrees(degrees), halfBarrierHeight(halfBarrierHeight) {
 
 	}
 
@@ -16,6 +16,10 @@ namespace classical {
 		int atom2;
 		int atom3;
 		int atom4;
+		/* BondGraph indices of the bonds from the central atom 3 to atoms 1, 2 and 4. */
+		int bond31;
+		int bond32;
+		int bond34;
 		double degrees;
 		double halfBarrierHeight;
 		double energy;
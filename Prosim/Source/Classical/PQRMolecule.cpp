@@ -12,37 +12,14 @@
 namespace classical {
 
 	PQRMolecule::PQRMolecule(const String &pqrFilePath, ForceField *forceField, bool additionalTopologyCalculation)
-		: m_pqrFilePath(pqrFilePath), m_forceField(forceField) {
+		: m_pqrFilePath(pqrFilePath), m_forceField(forceField), m_additionalTopologyCalculation(additionalTopologyCalculation), m_bondedInternalsCurrent(false) {
 
 		ReadInPQR();
 
-		CalculateBondGraphFromBonds(m_nAtoms, m_bondGraph, m_bonds);
+		m_particles.BuildVanDerWaalsPairTable(*m_forceField);
 
-		if (additionalTopologyCalculation) {
-			CalculateBondGraph(m_atoms, m_bondGraph, m_forceField);
-		}
-
-		std::cout << "Calculated bond graph" << std::endl;
-
-		CalculateBonds(m_atoms, m_bondGraph, m_bonds, m_forceField);
-		std::cout << "Calculated bonds" << std::endl;
-
-		CalculateAngles(m_atoms, m_bondGraph, m_angles, m_forceField);
-		std::cout << "Calculated angles" << std::endl;
-
-		CalculateTorsions(m_atoms, m_bondGraph, m_torsions, m_forceField);
-		std::cout << "Calculated torsions" << std::endl;
-
-		CalculateOutOfPlanes(m_atoms, m_bondGraph, m_outOfPlanes, m_forceField);
-		std::cout << "Calculated out-of-planes" << std::endl;
-
-		CalculateNonInts(m_bonds, m_angles, m_torsions, m_nonInts);
-		std::cout << "Calculated non-interacting pairs" << std::endl;
-
-		m_nBonds = m_bonds.size();
-		m_nAngles = m_angles.size();
-		m_nTorsions = m_torsions.size();
-		m_nOutOfPlanes = m_outOfPlanes.size();
+		CalculateBondedPairsFromBonds(m_bonds, m_inputBondedPairs);
+		CalculateTopology(PeriodicBox());
 
 		m_dielectric = 1.0;
 		m_mass = 0.0;
@@ -54,6 +31,27 @@ namespace classical {
 		m_temperature = 0.0;
 		m_pressure = 0.0;
 		m_virial = 0.0;
+		m_nonBondedVirial = 0.0;
+		m_eKinetic = 0.0;
+		m_nonBondedCutoff = 0.0;
+		m_neighborListSkin = 2.0;
+		m_vdw14Scale = 0.5;
+		m_elst14Scale = 1.0 / 1.2;
+		m_nonBondedKernel = GetBestNonBondedKernel();
+		m_nonBondedDeterministic = false;
+		m_electrostatics = ElectrostaticsMethod::Coulomb;
+		m_ewaldTolerance = 1e-5;
+		m_pmeGridSpacing = 1.0;
+		m_pmeOrder = 4;
+		m_reactionFieldDielectric = 78.5;
+		m_vdwSwitchDistance = 0.0;
+		m_implicitSolvent = ImplicitSolventModel::None;
+		m_solventDielectric = 78.5;
+		m_eSolvation = 0.0;
+
+		m_generalizedBorn.Setup(m_atoms, m_particles);
+
+		m_neighborList.Update(m_particles, m_nonBondedCutoff, m_neighborListSkin);
 
 		for (int i = 0; i < m_nAtoms; i++) {
 			m_gBonds.push_back(math::Vec3());
@@ -62,12 +60,14 @@ namespace classical {
 			m_gOutOfPlanes.push_back(math::Vec3());
 			m_gVDW.push_back(math::Vec3());
 			m_gElst.push_back(math::Vec3());
+			m_gSolvation.push_back(math::Vec3());
 			m_gBound.push_back(math::Vec3());
 			m_gBonded.push_back(math::Vec3());
 			m_gNonBonded.push_back(math::Vec3());
 			m_gPotential.push_back(math::Vec3());
 			m_gKinetic.push_back(math::Vec3());
 			m_gTotal.push_back(math::Vec3());
+			m_gShortRange.push_back(math::Vec3());
 		}
 	}
 
@@ -75,48 +75,41 @@ namespace classical {
 		for (int i = 0; i < m_nAtoms; i++) {
 			delete m_atoms[i];
 		}
-
-		for (int i = 0; i < m_nBonds; i++) {
-			delete m_bonds[i];
-		}
-
-		for (int i = 0; i < m_nAngles; i++) {
-			delete m_angles[i];
-		}
-
-		for (int i = 0; i < m_nTorsions; i++) {
-			delete m_torsions[i];
-		}
-
-		for (int i = 0; i < m_nOutOfPlanes; i++) {
-			delete m_outOfPlanes[i];
-		}
 	}
 
 	void PQRMolecule::CalculateEnergy(const String &kineticType) {
+		UpdateBondedInternals();
+
 		m_eBonds = GetEBonds(m_bonds);
 		m_eAngles = GetEAngles(m_angles);
 		m_eTorsions = GetETorsions(m_torsions);
 		m_eOutOfPlanes = GetEOutOfPlanes(m_outOfPlanes);
 
+		if (m_electrostatics == ElectrostaticsMethod::Coulomb && m_vdwSwitchDistance <= 0.0 && !m_periodicBox.IsPeriodic()) {
 #ifdef PS_OPTIMIZED
-		math::Vec2 nonBondedEnergy = m_nonBondedGPUCalculator.GetENonBonded(m_atoms, m_nonInts, m_dielectric);
+			math::Vec2 nonBondedEnergy = m_nonBondedGPUCalculator.GetENonBonded(m_particles, m_exclusions, m_dielectric, m_vdw14Scale, m_elst14Scale);
 #else
-		math::Vec2 nonBondedEnergy = GetENonBonded(m_atoms, m_nonInts, m_dielectric);
+			math::Vec2 nonBondedEnergy = GetENonBonded(m_particles, m_neighborList, m_exclusions, m_dielectric, m_vdw14Scale, m_elst14Scale);
 #endif
 
-		m_eVDW = nonBondedEnergy.x;
-		m_eElst = nonBondedEnergy.y;
+			m_eVDW = nonBondedEnergy.x;
+			m_eElst = nonBondedEnergy.y;
+		} else {
+			/* Ewald sums, cutoff electrostatics, the van der Waals switch and periodic images are only implemented in the fused pass; its gradients go to scratch so that m_gVDW and m_gElst
+			   keep their values, e.g. during the numerical gradient. */
+			std::vector<math::Vec3> gVDW(m_nAtoms);
+			std::vector<math::Vec3> gElst(m_nAtoms);
+			double virial;
 
-		m_eBound = GetEBound(m_atoms, m_kBox, m_boundary, m_origin, m_boundaryType);
-		m_eKinetic = GetEKinetic(m_atoms, kineticType);
-		m_eBonded = m_eBonds + m_eAngles + m_eTorsions + m_eOutOfPlanes;
+			CalculateEGNonBonded(gVDW, gElst, m_eVDW, m_eElst, virial, m_particles, m_neighborList, m_exclusions, m_dielectric, m_vdw14Scale, m_elst14Scale, GetNonBondedSettings(), &m_nonBondedWorkspace);
+		}
 
-		m_eNonBonded = m_eVDW + m_eElst;
+		m_eSolvation = m_implicitSolvent == ImplicitSolventModel::None ? 0.0 : m_generalizedBorn.CalculateEnergy(m_particles, m_neighborList, m_dielectric, m_solventDielectric);
 
-		m_ePotential = m_eBonded + m_eNonBonded + m_eBound;
+		m_eBound = GetEBound(m_particles, m_kBox, m_boundary, m_origin, m_boundaryType);
 
-		m_eTotal = m_ePotential + m_eKinetic;
+		SumEnergies();
+		CalculateKineticEnergy(kineticType);
 	}
 
 	void PQRMolecule::CalculateGradient(const String &gradientType) {
@@ -131,6 +124,140 @@ namespace classical {
 			return;
 		}
 
+		SumGradients();
+	}
+
+	void PQRMolecule::CalculateEnergyAndGradient() {
+		CalculateEGBonds(m_gBonds, m_eBonds, m_bonds, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGAngles(m_gAngles, m_eAngles, m_angles, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGTorsions(m_gTorsions, m_eTorsions, m_torsions, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGOutOfPlanes(m_gOutOfPlanes, m_eOutOfPlanes, m_outOfPlanes, m_particles, m_bondGraph, m_periodicBox);
+		m_bondedInternalsCurrent = true;
+
+		CalculateEGNonBonded(m_gVDW, m_gElst, m_eVDW, m_eElst, m_nonBondedVirial, m_particles, m_neighborList, m_exclusions, m_dielectric, m_vdw14Scale, m_elst14Scale, GetNonBondedSettings(), &m_nonBondedWorkspace);
+		CalculateEGSolvation(m_eSolvation);
+
+		m_eBound = GetEBound(m_particles, m_kBox, m_boundary, m_origin, m_boundaryType);
+		CalculateGBound(m_gBound, m_particles, m_kBox, m_boundary, m_origin, m_boundaryType);
+
+		SumEnergies();
+		SumGradients();
+	}
+
+	void PQRMolecule::CalculateShortRangeGradient() {
+		CalculateEGBonds(m_gBonds, m_eBonds, m_bonds, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGAngles(m_gAngles, m_eAngles, m_angles, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGTorsions(m_gTorsions, m_eTorsions, m_torsions, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGOutOfPlanes(m_gOutOfPlanes, m_eOutOfPlanes, m_outOfPlanes, m_particles, m_bondGraph, m_periodicBox);
+		m_bondedInternalsCurrent = true;
+
+		CalculateGBound(m_gBound, m_particles, m_kBox, m_boundary, m_origin, m_boundaryType);
+
+		SumShortRangeGradient();
+	}
+
+	void PQRMolecule::SumShortRangeGradient() {
+		/* Both 1-4 gradients go straight into the sum. */
+		double eVDW14 = 0.0;
+		double eElst14 = 0.0;
+		double virial14 = 0.0;
+
+		std::fill(m_gShortRange.begin(), m_gShortRange.end(), 0);
+		CalculateEGNonBonded14(m_gShortRange, m_gShortRange, eVDW14, eElst14, virial14, m_particles, m_exclusions, m_dielectric, m_vdw14Scale, m_elst14Scale, m_periodicBox);
+
+		for (int i = 0; i < m_nAtoms; i++) {
+			m_gShortRange[i].Add(m_gBonds[i]);
+			m_gShortRange[i].Add(m_gAngles[i]);
+			m_gShortRange[i].Add(m_gTorsions[i]);
+			m_gShortRange[i].Add(m_gOutOfPlanes[i]);
+			m_gShortRange[i].Add(m_gBound[i]);
+		}
+	}
+
+	void PQRMolecule::CalculateKineticEnergy(const String &kineticType) {
+		m_eKinetic = GetEKinetic(m_particles, kineticType);
+		m_eTotal = m_ePotential + m_eKinetic;
+	}
+
+	void PQRMolecule::CalculateAnalyticGradient() {
+		double eBonds;
+		double eAngles;
+		double eTorsions;
+		double eOutOfPlanes;
+		double eVDW;
+		double eElst;
+		double eSolvation;
+
+		CalculateEGBonds(m_gBonds, eBonds, m_bonds, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGAngles(m_gAngles, eAngles, m_angles, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGTorsions(m_gTorsions, eTorsions, m_torsions, m_particles, m_bondGraph, m_periodicBox);
+		CalculateEGOutOfPlanes(m_gOutOfPlanes, eOutOfPlanes, m_outOfPlanes, m_particles, m_bondGraph, m_periodicBox);
+		m_bondedInternalsCurrent = true;
+
+		CalculateEGNonBonded(m_gVDW, m_gElst, eVDW, eElst, m_nonBondedVirial, m_particles, m_neighborList, m_exclusions, m_dielectric, m_vdw14Scale, m_elst14Scale, GetNonBondedSettings(), &m_nonBondedWorkspace);
+		CalculateEGSolvation(eSolvation);
+		CalculateGBound(m_gBound, m_particles, m_kBox, m_boundary, m_origin, m_boundaryType);
+	}
+
+	void PQRMolecule::CalculateEGSolvation(double &eSolvation) {
+		std::fill(m_gSolvation.begin(), m_gSolvation.end(), 0);
+
+		eSolvation = m_implicitSolvent == ImplicitSolventModel::None ? 0.0 : m_generalizedBorn.CalculateEnergyAndGradient(m_gSolvation, m_particles, m_neighborList, m_dielectric, m_solventDielectric);
+	}
+
+	void PQRMolecule::CalculateNumericalGradient() {
+		CalculateGNumerical();
+	}
+
+	void PQRMolecule::UpdateInternals() {
+		m_bondGraph.UpdateLengths(m_particles, m_periodicBox);
+
+		/* The bonded internal coordinates are refreshed on demand: the fused energy and gradient passes compute them anyway. */
+		m_bondedInternalsCurrent = false;
+
+		m_neighborList.Update(m_particles, m_nonBondedCutoff, m_neighborListSkin, m_periodicBox);
+	}
+
+	void PQRMolecule::UpdateTopology() {
+		CalculateTopology(m_periodicBox);
+	}
+
+	void PQRMolecule::UpdateBondedInternals() {
+		if (m_bondedInternalsCurrent) return;
+
+		UpdateBonds(m_bonds, m_bondGraph);
+		UpdateAngles(m_angles, m_particles, m_bondGraph, m_periodicBox);
+		UpdateTorsions(m_torsions, m_particles, m_bondGraph, m_periodicBox);
+		UpdateOutOfPlanes(m_outOfPlanes, m_particles, m_bondGraph, m_periodicBox);
+
+		m_bondedInternalsCurrent = true;
+	}
+
+	void PQRMolecule::CalculateTemperature() {
+		m_temperature = GetTemperature(m_eKinetic, 3 * m_nAtoms - m_constraints.GetNConstraints());
+	}
+
+	void PQRMolecule::CalculatePressure() {
+		/* The bonded, bound and solvation gradients can use the per-atom form; the non-bonded pass supplies its pair virial. */
+		m_virial = GetVirial(m_gBonded, m_particles) + GetVirial(m_gBound, m_particles) + GetVirial(m_gSolvation, m_particles) + m_nonBondedVirial;
+		m_pressure = GetPressure(m_particles, m_temperature, m_virial, m_volume);
+	}
+
+	void PQRMolecule::CalculateVolume() {
+		m_volume = m_periodicBox.IsPeriodic() ? m_periodicBox.GetVolume() : GetVolume(m_boundary, m_boundaryType);
+	}
+
+	void PQRMolecule::SumEnergies() {
+		m_eBonded = m_eBonds + m_eAngles + m_eTorsions + m_eOutOfPlanes;
+
+		m_eNonBonded = m_eVDW + m_eElst + m_eSolvation;
+
+		m_ePotential = m_eBonded + m_eNonBonded + m_eBound;
+
+		m_eTotal = m_ePotential + m_eKinetic;
+	}
+
+	void PQRMolecule::SumGradients() {
 		std::fill(m_gBonded.begin(), m_gBonded.end(), 0);
 		std::fill(m_gNonBonded.begin(), m_gNonBonded.end(), 0);
 		std::fill(m_gTotal.begin(), m_gTotal.end(), 0);
@@ -143,6 +270,7 @@ namespace classical {
 
 			m_gNonBonded[i].Add(m_gVDW[i]);
 			m_gNonBonded[i].Add(m_gElst[i]);
+			m_gNonBonded[i].Add(m_gSolvation[i]);
 
 			m_gTotal[i].Add(m_gBonded[i]);
 			m_gTotal[i].Add(m_gNonBonded[i]);
@@ -150,35 +278,67 @@ namespace classical {
 		}
 	}
 
-	void PQRMolecule::CalculateAnalyticGradient() {
-		CalculateGBonds(m_gBonds, m_bonds, m_atoms);
-		CalculateGAngles(m_gAngles, m_angles, m_atoms, m_bondGraph);
-		CalculateGTorsions(m_gTorsions, m_torsions, m_atoms, m_bondGraph);
-		CalculateGOutOfPlanes(m_gOutOfPlanes, m_outOfPlanes, m_atoms, m_bondGraph);
-	}
+	NonBondedSettings PQRMolecule::GetNonBondedSettings() const {
+		NonBondedSettings settings;
+
+		settings.kernel = m_nonBondedKernel;
+		settings.deterministic = m_nonBondedDeterministic;
+		settings.electrostatics = m_electrostatics;
+		settings.ewaldTolerance = m_ewaldTolerance;
+		settings.pmeGridSpacing = m_pmeGridSpacing;
+		settings.pmeOrder = m_pmeOrder;
+		settings.reactionFieldDielectric = m_reactionFieldDielectric;
+		settings.vdwSwitchDistance = m_vdwSwitchDistance;
+
+		if (m_periodicBox.IsPeriodic()) {
+			settings.box = m_periodicBox;
+		} else if (m_electrostatics == ElectrostaticsMethod::PME) {
+			/* The sphere and cube walls imply a periodic cube of edge 2 * boundary for PME only. */
+			settings.box = PeriodicBox(2.0 * m_boundary, 2.0 * m_boundary, 2.0 * m_boundary, m_origin);
+		}
 
-	void PQRMolecule::CalculateNumericalGradient() {
-		CalculateGNumerical();
+		return settings;
 	}
 
-	void PQRMolecule::UpdateInternals() {
-		UpdateBonds(m_bonds, m_atoms, m_bondGraph);
-		UpdateAngles(m_angles, m_atoms, m_bondGraph);
-		UpdateTorsions(m_torsions, m_atoms, m_bondGraph);
-		UpdateOutOfPlanes(m_outOfPlanes, m_atoms, m_bondGraph);
-	}
+	void PQRMolecule::CalculateTopology(const PeriodicBox &box) {
+		std::vector<int> bondedPairs = m_inputBondedPairs;
 
-	void PQRMolecule::CalculateTemperature() {
-		m_temperature = GetTemperature(m_eKinetic, m_nAtoms);
-	}
+		if (m_additionalTopologyCalculation) {
+			CalculateBondedPairs(m_atoms, m_particles, bondedPairs, box);
+		}
 
-	void PQRMolecule::CalculatePressure() {
-		m_virial = GetVirial(m_gTotal, m_atoms);
-		m_pressure = GetPressure(m_atoms, m_temperature, m_virial, m_volume);
-	}
+		m_bondGraph.Build(m_nAtoms, bondedPairs);
+		m_bondGraph.UpdateLengths(m_particles, box);
 
-	void PQRMolecule::CalculateVolume() {
-		m_volume = GetVolume(m_boundary, m_boundaryType);
+		std::cout << "Calculated bond graph" << std::endl;
+
+		CalculateBonds(m_atoms, m_bondGraph, m_bonds, m_forceField);
+		std::cout << "Calculated bonds" << std::endl;
+
+		CalculateAngles(m_atoms, m_particles, m_bondGraph, m_angles, m_forceField);
+		std::cout << "Calculated angles" << std::endl;
+
+		CalculateTorsions(m_atoms, m_particles, m_bondGraph, m_torsions, m_forceField);
+		std::cout << "Calculated torsions" << std::endl;
+
+		CalculateOutOfPlanes(m_atoms, m_particles, m_bondGraph, m_outOfPlanes, m_forceField);
+		std::cout << "Calculated out-of-planes" << std::endl;
+
+		CalculateExclusions(m_nAtoms, m_bonds, m_angles, m_torsions, m_exclusions);
+		std::cout << "Calculated non-bonded exclusions" << std::endl;
+
+		/* Terms of one color share no atom, so the bonded passes can split every color over threads. */
+		m_bonds.ColorByAtoms(m_nAtoms);
+		m_angles.ColorByAtoms(m_nAtoms);
+		m_torsions.ColorByAtoms(m_nAtoms);
+		m_outOfPlanes.ColorByAtoms(m_nAtoms);
+
+		m_nBonds = m_bonds.GetSize();
+		m_nAngles = m_angles.GetSize();
+		m_nTorsions = m_torsions.GetSize();
+		m_nOutOfPlanes = m_outOfPlanes.GetSize();
+
+		m_bondedInternalsCurrent = false;
 	}
 
 	void PQRMolecule::ReadInPQR() {
@@ -224,7 +384,11 @@ namespace classical {
 
 				math::Vec3 position = math::Vec3(x, y, z);
 
-				m_atoms.push_back(new Atom(atomName, position, charge, m_forceField));
+				Atom *atom = new Atom(atomName, m_forceField);
+
+				m_atoms.push_back(atom);
+				m_particles.Add(position, m_forceField->GetAtomicMass(atom->element), charge, radius,
+					m_forceField->GetVanDerWaalsRadius(atom->type), m_forceField->GetVanDerWaalsAttractionMagnitude(atom->type), atom->type);
 			}
 		}
 
@@ -239,11 +403,11 @@ namespace classical {
 				Atom *atom1 = m_atoms[atom1Index];
 				Atom *atom2 = m_atoms[atom2Index];
 
-				double distance = GetRij(atom1->position, atom2->position);
-				double equilibriumDistance = m_forceField->GetBondEquilibriumLength(atom1->type, atom2->type);
-				double springConstant = m_forceField->GetBondSpringConstant(atom1->type, atom2->type);
+				double distance = GetRij(m_particles.GetPosition(atom1Index), m_particles.GetPosition(atom2Index));
+				double equilibriumDistance = m_forceField->GetBondEquilibriumLength(atom1->typeId, atom2->typeId);
+				double springConstant = m_forceField->GetBondSpringConstant(atom1->typeId, atom2->typeId);
 
-				m_bonds.push_back(new Bond(atom1Index, atom2Index, distance, equilibriumDistance, springConstant));
+				m_bonds.Add(Bond(atom1Index, atom2Index, distance, equilibriumDistance, springConstant));
 
 				break;
 			}
@@ -260,15 +424,16 @@ namespace classical {
 		std::fill(m_gOutOfPlanes.begin(), m_gOutOfPlanes.end(), 0);
 		std::fill(m_gVDW.begin(), m_gVDW.end(), 0);
 		std::fill(m_gElst.begin(), m_gElst.end(), 0);
+		std::fill(m_gSolvation.begin(), m_gSolvation.end(), 0);
 		std::fill(m_gBound.begin(), m_gBound.end(), 0);
 
 		for (int i = 0; i < m_nAtoms; i++) {
 			for (int j = 0; j < 3; j++) {
-				double q = m_atoms[i]->position[j];
+				double q = m_particles.position[j][i];
 
 				double qp = q + 0.5 * NUMERICAL_DISPLACEMENT;
 
-				m_atoms[i]->position[j] = qp;
+				m_particles.position[j][i] = qp;
 
 				UpdateInternals();
 				CalculateEnergy();
@@ -279,6 +444,7 @@ namespace classical {
 				double epOutOfPlane = m_eOutOfPlanes;
 				double epVDW = m_eVDW;
 				double epElst = m_eElst;
+				double epSolvation = m_eSolvation;
 				double epBound = m_eBound;
 
 				double qm = q - 0.5 * NUMERICAL_DISPLACEMENT;
@@ -292,17 +458,19 @@ namespace classical {
 				double emOutOfPlane = m_eOutOfPlanes;
 				double emVDW = m_eVDW;
 				double emElst = m_eElst;
+				double emSolvation = m_eSolvation;
 				double emBound = m_eBound;
 
 				double displacement = qp - qm;
 
-				m_atoms[i]->position[j] = q;
+				m_particles.position[j][i] = q;
 				m_gBonds[i][j] = (epBond - emBond) / displacement;
 				m_gAngles[i][j] = (epAngle - emAngle) / displacement;
 				m_gTorsions[i][j] = (epTorsion - emTorsion) / displacement;
 				m_gOutOfPlanes[i][j] = (epOutOfPlane - emOutOfPlane) / displacement;
 				m_gVDW[i][j] = (epVDW - emVDW) / displacement;
 				m_gElst[i][j] = (epElst - emElst) / displacement;
+				m_gSolvation[i][j] = (epSolvation - emSolvation) / displacement;
 				m_gBound[i][j] = (epBound - emBound) / displacement;
 			}
 		}
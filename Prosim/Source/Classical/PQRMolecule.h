@@ -11,20 +11,40 @@ namespace classical {
 
 		void CalculateEnergy(const String &kineticType = "none") override;
 		void CalculateGradient(const String &gradientType = "analytic") override;
+		void CalculateEnergyAndGradient() override;
+		void CalculateShortRangeGradient() override;
+		void SumShortRangeGradient() override;
+		void CalculateKineticEnergy(const String &kineticType = "none") override;
 		void CalculateAnalyticGradient() override;
 		void CalculateNumericalGradient() override;
 		void UpdateInternals() override;
+		void UpdateTopology() override;
 		void CalculateTemperature() override;
 		void CalculatePressure() override;
 		void CalculateVolume() override;
 	private:
 		void ReadInPQR();
 		void ResolvePQRTokens(const std::vector<String> &tokens);
+		/* Bond graph, bonded tables and exclusions from the input bonds and, if enabled, the perceived ones. */
+		void CalculateTopology(const PeriodicBox &box);
 
 		void CalculateGNumerical();
+		void UpdateBondedInternals();
+		/* Energy and gradient of the implicit solvent into m_gSolvation. */
+		void CalculateEGSolvation(double &eSolvation);
+
+		NonBondedSettings GetNonBondedSettings() const;
+
+		void SumEnergies();
+		void SumGradients();
 	private:
 		String m_pqrFilePath;
 		ForceField *m_forceField;
+		/* Atom pairs bonded in the input file; perception only adds to them. */
+		std::vector<int> m_inputBondedPairs;
+		bool m_additionalTopologyCalculation;
+		/* Whether the internal coordinates in the bonded tables match the positions; see UpdateInternals. */
+		bool m_bondedInternalsCurrent;
 	};
 
 }
\ No newline at end of file
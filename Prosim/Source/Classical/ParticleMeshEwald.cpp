@@ -0,0 +1,345 @@
+#include "ParticleMeshEwald.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "Constants.h"
+
+#include "Math/FFT.h"
+
+namespace classical {
+
+	/* Weights M_n(w + order - 1 - k) of the order n cardinal B-spline at the order grid points around a particle with
+	   fractional grid offset w, and their derivatives with respect to w. */
+	static void ComputeBSpline(double w, int order, double *theta, double *dTheta) {
+		theta[order - 1] = 0.0;
+		theta[1] = w;
+		theta[0] = 1.0 - w;
+
+		for (int j = 3; j < order; j++) {
+			double div = 1.0 / (j - 1);
+			theta[j - 1] = div * w * theta[j - 2];
+
+			for (int k = 1; k < j - 1; k++) {
+				theta[j - k - 1] = div * ((w + k) * theta[j - k - 2] + (j - k - w) * theta[j - k - 1]);
+			}
+
+			theta[0] = div * (1.0 - w) * theta[0];
+		}
+
+		/* The derivative follows from the splines one order lower. */
+		dTheta[0] = -theta[0];
+
+		for (int j = 1; j < order; j++) {
+			dTheta[j] = theta[j - 1] - theta[j];
+		}
+
+		double div = 1.0 / (order - 1);
+		theta[order - 1] = div * w * theta[order - 2];
+
+		for (int k = 1; k < order - 1; k++) {
+			theta[order - k - 1] = div * ((w + k) * theta[order - k - 2] + (order - k - w) * theta[order - k - 1]);
+		}
+
+		theta[0] = div * (1.0 - w) * theta[0];
+	}
+
+	ParticleMeshEwald::ParticleMeshEwald()
+		: m_order(0) {
+		m_gridSize[0] = m_gridSize[1] = m_gridSize[2] = 0;
+	}
+
+	void ParticleMeshEwald::Setup(const PeriodicBox &box, double gridSpacing, int order) {
+		int gridSize[3];
+
+		for (int d = 0; d < 3; d++) {
+			gridSize[d] = std::max(math::NextPowerOfTwo((int)ceil(box.GetLength(d) / gridSpacing)), math::NextPowerOfTwo(2 * order));
+		}
+
+		m_box = box;
+
+		if (gridSize[0] == m_gridSize[0] && gridSize[1] == m_gridSize[1] && gridSize[2] == m_gridSize[2] && order == m_order) return;
+
+		m_order = order;
+
+		for (int d = 0; d < 3; d++) {
+			m_gridSize[d] = gridSize[d];
+		}
+
+		m_grid.assign((size_t)m_gridSize[0] * m_gridSize[1] * m_gridSize[2], 0.0);
+
+		ComputeBSplineModuli();
+	}
+
+	void ParticleMeshEwald::ComputeBSplineModuli() {
+		std::vector<double> theta(m_order);
+		std::vector<double> dTheta(m_order);
+
+		/* At w = 0 the weights are the spline values M_n(k + 1) at the integers. */
+		ComputeBSpline(0.0, m_order, theta.data(), dTheta.data());
+
+		for (int d = 0; d < 3; d++) {
+			int n = m_gridSize[d];
+			std::vector<double> &moduli = m_bSplineModuli[d];
+
+			moduli.assign(n, 0.0);
+
+			for (int m = 0; m < n; m++) {
+				double real = 0.0;
+				double imaginary = 0.0;
+
+				for (int k = 0; k < m_order; k++) {
+					double angle = 2.0 * M_PI * m * k / n;
+					real += theta[k] * cos(angle);
+					imaginary += theta[k] * sin(angle);
+				}
+
+				moduli[m] = real * real + imaginary * imaginary;
+			}
+
+			/* Odd orders have a zero at the Nyquist frequency; interpolate over it. */
+			for (int m = 0; m < n; m++) {
+				if (moduli[m] < 1e-7) {
+					moduli[m] = 0.5 * (moduli[(m - 1 + n) % n] + moduli[(m + 1) % n]);
+				}
+			}
+
+			for (int m = 0; m < n; m++) {
+				moduli[m] = 1.0 / moduli[m];
+			}
+		}
+	}
+
+	double ParticleMeshEwald::CalculateReciprocal(std::vector<math::Vec3> &gElst, double &virial, const ParticleStore &particles, double ewaldCoefficient, double dielectric) {
+		int natoms = particles.GetSize();
+		int nx = m_gridSize[0];
+		int ny = m_gridSize[1];
+		int nz = m_gridSize[2];
+		int order = m_order;
+		double scale[3];
+
+		for (int d = 0; d < 3; d++) {
+			scale[d] = m_gridSize[d] * m_box.GetInverseLength(d);
+		}
+
+		for (int d = 0; d < 3; d++) {
+			m_theta[d].resize((size_t)natoms * order);
+			m_dTheta[d].resize((size_t)natoms * order);
+			m_gridIndex[d].resize(natoms);
+		}
+
+#pragma omp parallel for
+		for (int i = 0; i < natoms; i++) {
+			for (int d = 0; d < 3; d++) {
+				int n = m_gridSize[d];
+				double t = (particles.position[d][i] - m_box.GetCorner(d)) * scale[d];
+				t -= floor(t / n) * n;
+
+				int index = std::min((int)t, n - 1);
+
+				m_gridIndex[d][i] = index;
+				ComputeBSpline(t - index, order, &m_theta[d][(size_t)i * order], &m_dTheta[d][(size_t)i * order]);
+			}
+		}
+
+		std::fill(m_grid.begin(), m_grid.end(), 0.0);
+
+		/* Charge spreading; serial because neighboring atoms share grid points. */
+		for (int i = 0; i < natoms; i++) {
+			double charge = particles.charge[i];
+
+			if (charge == 0.0) continue;
+
+			const double *thetaX = &m_theta[0][(size_t)i * order];
+			const double *thetaY = &m_theta[1][(size_t)i * order];
+			const double *thetaZ = &m_theta[2][(size_t)i * order];
+
+			for (int ix = 0; ix < order; ix++) {
+				int x = (m_gridIndex[0][i] + ix) % nx;
+				double weightX = charge * thetaX[ix];
+
+				for (int iy = 0; iy < order; iy++) {
+					int y = (m_gridIndex[1][i] + iy) % ny;
+					double weightXY = weightX * thetaY[iy];
+					std::complex<double> *row = &m_grid[((size_t)x * ny + y) * nz];
+
+					for (int iz = 0; iz < order; iz++) {
+						row[(m_gridIndex[2][i] + iz) % nz] += weightXY * thetaZ[iz];
+					}
+				}
+			}
+		}
+
+		math::FFT3D(m_grid, nx, ny, nz, false);
+
+		/* E = k / (2 pi V) sum_{m != 0} B(m) exp(-pi^2 m^2 / alpha^2) / m^2 |F(Q)(m)|^2. Each term is also the
+		   convolution kernel applied to F(Q) for the potential on the grid. */
+		double volume = m_box.GetVolume();
+		double prefactor = CEU_TO_KCAL / (dielectric * M_PI * volume);
+		double piOverAlpha2 = M_PI * M_PI / (ewaldCoefficient * ewaldCoefficient);
+
+		m_planeEnergies.assign(nx, 0.0);
+		m_planeVirials.assign(nx, 0.0);
+
+#pragma omp parallel for
+		for (int mx = 0; mx < nx; mx++) {
+			double kx = (mx <= nx / 2 ? mx : mx - nx) * m_box.GetInverseLength(0);
+			double planeEnergy = 0.0;
+			double planeVirial = 0.0;
+
+			for (int my = 0; my < ny; my++) {
+				double ky = (my <= ny / 2 ? my : my - ny) * m_box.GetInverseLength(1);
+
+				for (int mz = 0; mz < nz; mz++) {
+					size_t index = ((size_t)mx * ny + my) * nz + mz;
+
+					if (mx == 0 && my == 0 && mz == 0) {
+						m_grid[index] = 0.0;
+						continue;
+					}
+
+					double kz = (mz <= nz / 2 ? mz : mz - nz) * m_box.GetInverseLength(2);
+					double k2 = kx * kx + ky * ky + kz * kz;
+					double factor = prefactor * m_bSplineModuli[0][mx] * m_bSplineModuli[1][my] * m_bSplineModuli[2][mz] * exp(-piOverAlpha2 * k2) / k2;
+					double termEnergy = 0.5 * factor * std::norm(m_grid[index]);
+
+					planeEnergy += termEnergy;
+					/* The trace of the reciprocal virial tensor, -L dE/dL for an isotropic scaling of the box. */
+					planeVirial += termEnergy * (1.0 - 2.0 * piOverAlpha2 * k2);
+
+					m_grid[index] *= factor;
+				}
+			}
+
+			m_planeEnergies[mx] = planeEnergy;
+			m_planeVirials[mx] = planeVirial;
+		}
+
+		/* Plane sums are added in grid order, so the energy does not depend on the thread count. */
+		double energy = 0.0;
+		double reciprocalVirial = 0.0;
+
+		for (int mx = 0; mx < nx; mx++) {
+			energy += m_planeEnergies[mx];
+			reciprocalVirial += m_planeVirials[mx];
+		}
+
+		math::FFT3D(m_grid, nx, ny, nz, true);
+
+		/* The grid now holds dE/dQ; the gradient of atom i is q_i times the potential differentiated through its splines. */
+#pragma omp parallel for
+		for (int i = 0; i < natoms; i++) {
+			double charge = particles.charge[i];
+
+			if (charge == 0.0) continue;
+
+			const double *thetaX = &m_theta[0][(size_t)i * order];
+			const double *thetaY = &m_theta[1][(size_t)i * order];
+			const double *thetaZ = &m_theta[2][(size_t)i * order];
+			const double *dThetaX = &m_dTheta[0][(size_t)i * order];
+			const double *dThetaY = &m_dTheta[1][(size_t)i * order];
+			const double *dThetaZ = &m_dTheta[2][(size_t)i * order];
+
+			double gx = 0.0;
+			double gy = 0.0;
+			double gz = 0.0;
+
+			for (int ix = 0; ix < order; ix++) {
+				int x = (m_gridIndex[0][i] + ix) % nx;
+
+				for (int iy = 0; iy < order; iy++) {
+					int y = (m_gridIndex[1][i] + iy) % ny;
+					const std::complex<double> *row = &m_grid[((size_t)x * ny + y) * nz];
+
+					for (int iz = 0; iz < order; iz++) {
+						double potential = row[(m_gridIndex[2][i] + iz) % nz].real();
+
+						gx += dThetaX[ix] * thetaY[iy] * thetaZ[iz] * potential;
+						gy += thetaX[ix] * dThetaY[iy] * thetaZ[iz] * potential;
+						gz += thetaX[ix] * thetaY[iy] * dThetaZ[iz] * potential;
+					}
+				}
+			}
+
+			gElst[i] += math::Vec3(charge * scale[0] * gx, charge * scale[1] * gy, charge * scale[2] * gz);
+		}
+
+		virial += reciprocalVirial;
+
+		return energy;
+	}
+
+	double GetEwaldCoefficient(double cutoff, double tolerance) {
+		double low = 0.0;
+		double high = 10.0 / cutoff;
+
+		/* erfc(alpha * cutoff) falls monotonically with alpha. */
+		for (int iteration = 0; iteration < 100; iteration++) {
+			double alpha = 0.5 * (low + high);
+
+			if (erfc(alpha * cutoff) > tolerance) {
+				low = alpha;
+			} else {
+				high = alpha;
+			}
+		}
+
+		return 0.5 * (low + high);
+	}
+
+	double CalculateEwaldCorrections(std::vector<math::Vec3> &gElst, double &virial, const ParticleStore &particles, const ExclusionTable &exclusions, double ewaldCoefficient, double dielectric, const PeriodicBox &box) {
+		int natoms = particles.GetSize();
+		double k = CEU_TO_KCAL / dielectric;
+		double energy = 0.0;
+
+		const std::vector<int> &offsets = exclusions.GetOffsets();
+		const std::vector<int> &partners = exclusions.GetPartners();
+
+		for (int i = 0; i < natoms; i++) {
+			for (int n = offsets[i]; n < offsets[i + 1]; n++) {
+				int j = partners[n];
+
+				double a = particles.position[0][i] - particles.position[0][j];
+				double b = particles.position[1][i] - particles.position[1][j];
+				double c = particles.position[2][i] - particles.position[2][j];
+
+				box.ApplyMinimumImage(a, b, c);
+
+				double r = sqrt(a * a + b * b + c * c);
+
+				double kqq = k * particles.charge[i] * particles.charge[j];
+				double erfTerm = erf(ewaldCoefficient * r);
+
+				/* E = -k q_i q_j erf(alpha r) / r. */
+				double eIJ = -kqq * erfTerm / r;
+				double gMagnitude = -kqq * (2.0 * ewaldCoefficient / sqrt(M_PI) * exp(-ewaldCoefficient * ewaldCoefficient * r * r) / r - erfTerm / (r * r));
+				math::Vec3 direction(a / r, b / r, c / r);
+
+				energy += eIJ;
+				virial -= gMagnitude * r;
+
+				gElst[i] += direction * gMagnitude;
+				gElst[j] += direction * -gMagnitude;
+			}
+		}
+
+		double chargeSum = 0.0;
+		double chargeSquareSum = 0.0;
+
+		for (int i = 0; i < natoms; i++) {
+			chargeSum += particles.charge[i];
+			chargeSquareSum += particles.charge[i] * particles.charge[i];
+		}
+
+		energy -= k * ewaldCoefficient / sqrt(M_PI) * chargeSquareSum;
+
+		/* The neutralizing background scales as 1 / V, so its virial -L dE/dL is 3 E. */
+		double eBackground = -k * M_PI * chargeSum * chargeSum / (2.0 * box.GetVolume() * ewaldCoefficient * ewaldCoefficient);
+		energy += eBackground;
+		virial += 3.0 * eBackground;
+
+		return energy;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include "ExclusionTable.h"
+#include "ParticleStore.h"
+#include "PeriodicBox.h"
+
+#include "Math/PSMath.h"
+
+namespace classical {
+
+	/* Reciprocal-space part of smooth particle mesh Ewald (Essmann et al. 1995) for an orthorhombic periodic box. Charges are
+	   spread onto a grid with cardinal B-splines, the grid is convolved with the Ewald kernel by 3D FFT and the
+	   potential is interpolated back with the spline derivatives. */
+	class ParticleMeshEwald {
+	public:
+		ParticleMeshEwald();
+
+		/* Sizes the grid so that its spacing is at most gridSpacing along every edge (rounded up to a power of two
+		   points). The grid and B-spline moduli are only rebuilt when the grid size or order change, so a box scaled by
+		   a barostat usually keeps them. */
+		void Setup(const PeriodicBox &box, double gridSpacing, int order);
+
+		/* Returns the reciprocal-space energy and adds its gradient to gElst and its virial to virial. */
+		double CalculateReciprocal(std::vector<math::Vec3> &gElst, double &virial, const ParticleStore &particles, double ewaldCoefficient, double dielectric);
+
+		inline int GetGridSize(int j) const { return m_gridSize[j]; }
+		inline int GetOrder() const { return m_order; }
+	private:
+		void ComputeBSplineModuli();
+	private:
+		PeriodicBox m_box;
+		int m_order;
+		int m_gridSize[3];
+
+		/* 1 / |b(m)|^2 of the Euler exponential spline along each axis. */
+		std::vector<double> m_bSplineModuli[3];
+		std::vector<std::complex<double>> m_grid;
+		/* Reciprocal energy and virial of every x plane of the grid. */
+		std::vector<double> m_planeEnergies;
+		std::vector<double> m_planeVirials;
+
+		/* Spline weights, their derivatives and the first grid index of every atom along x, y and z. */
+		std::vector<double> m_theta[3];
+		std::vector<double> m_dTheta[3];
+		std::vector<int> m_gridIndex[3];
+	};
+
+	/* Ewald splitting coefficient alpha with erfc(alpha * cutoff) = tolerance. */
+	double GetEwaldCoefficient(double cutoff, double tolerance);
+
+	/* Removes what the reciprocal sum wrongly includes: the self energy of every charge, the erf(alpha r) / r
+	   interaction of every excluded pair (1-2, 1-3 and 1-4) at its nearest image and, for a charged system, the
+	   interaction with the neutralizing background. Returns the energy and adds the gradient and virial. */
+	double CalculateEwaldCorrections(std::vector<math::Vec3> &gElst, double &virial, const ParticleStore &particles, const ExclusionTable &exclusions, double ewaldCoefficient, double dielectric, const PeriodicBox &box);
+
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "ParticleStore.h"
+
+namespace classical {
+
+	ParticleStore::ParticleStore() {
+
+	}
+
+	int ParticleStore::Add(const math::Vec3 &position, double mass, double charge, double radius, double vdwRadius, double vdwAttractionMagnitude, const String &type) {
+		int i = GetSize();
+
+		for (int j = 0; j < 3; j++) {
+			this->position[j].push_back(position[j]);
+			velocity[j].push_back(0.0);
+			acceleration[j].push_back(0.0);
+			previousVelocity[j].push_back(0.0);
+		}
+
+		std::map<String, int>::iterator it = m_typeIds.find(type);
+
+		if (it == m_typeIds.end()) {
+			it = m_typeIds.insert(std::make_pair(type, (int)typeNames.size())).first;
+			typeNames.push_back(type);
+		}
+
+		this->mass.push_back(mass);
+		this->charge.push_back(charge);
+		this->radius.push_back(radius);
+		this->vdwRadius.push_back(vdwRadius);
+		this->vdwAttractionMagnitude.push_back(vdwAttractionMagnitude);
+		typeId.push_back(it->second);
+
+		return i;
+	}
+
+	void ParticleStore::Clear() {
+		for (int j = 0; j < 3; j++) {
+			position[j].clear();
+			velocity[j].clear();
+			acceleration[j].clear();
+			previousVelocity[j].clear();
+		}
+
+		mass.clear();
+		charge.clear();
+		radius.clear();
+		vdwRadius.clear();
+		vdwAttractionMagnitude.clear();
+		typeId.clear();
+		typeNames.clear();
+		vdwPairTable.clear();
+		m_typeIds.clear();
+	}
+
+	void ParticleStore::BuildVanDerWaalsPairTable(const ForceField &forceField) {
+		int nTypes = GetNTypes();
+
+		/* Force field type ids and a representative particle of every local type. */
+		std::vector<int> forceFieldIds(nTypes);
+		std::vector<int> representatives(nTypes, -1);
+
+		for (int t = 0; t < nTypes; t++) {
+			forceFieldIds[t] = forceField.GetTypeId(typeNames[t]);
+		}
+
+		for (int i = GetSize() - 1; i >= 0; i--) {
+			representatives[typeId[i]] = i;
+		}
+
+		vdwPairTable.assign(nTypes * nTypes, VanDerWaalsPair());
+
+		for (int t1 = 0; t1 < nTypes; t1++) {
+			for (int t2 = 0; t2 < nTypes; t2++) {
+				if (forceField.HasVanDerWaalsParameters(forceFieldIds[t1]) && forceField.HasVanDerWaalsParameters(forceFieldIds[t2])) {
+					vdwPairTable[t1 * nTypes + t2] = forceField.GetVanDerWaalsPair(forceFieldIds[t1], forceFieldIds[t2]);
+				} else {
+					int i = representatives[t1];
+					int j = representatives[t2];
+
+					vdwPairTable[t1 * nTypes + t2] = CombineVanDerWaalsParameters(vdwRadius[i], vdwAttractionMagnitude[i], vdwRadius[j], vdwAttractionMagnitude[j]);
+				}
+			}
+		}
+	}
+
+}
\ No newline at end of file
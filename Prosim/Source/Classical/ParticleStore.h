@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "ForceField.h"
+
+#include "Math/PSMath.h"
+#include "Utils/String.h"
+
+namespace classical {
+
+	/* Structure-of-arrays storage for the per-particle state read by the force kernels and advanced by the integrator.
+	   Component j of particle i's position is position[j][i], so every coordinate, velocity and parameter is a
+	   contiguous array of doubles; Atom only keeps the descriptive data that hot loops never touch. */
+	struct ParticleStore {
+		ParticleStore();
+
+		/* Appends a particle at rest and returns its index. Types are interned to small integer ids in order of appearance. */
+		int Add(const math::Vec3 &position, double mass, double charge, double radius, double vdwRadius, double vdwAttractionMagnitude, const String &type);
+		void Clear();
+
+		/* Gathers the force field pair parameters of the types present into vdwPairTable. Types the force field does not
+		   know are combined from the per-particle parameters. */
+		void BuildVanDerWaalsPairTable(const ForceField &forceField);
+
+		inline int GetSize() const { return mass.size(); }
+		inline int GetNTypes() const { return typeNames.size(); }
+
+		inline math::Vec3 GetPosition(int i) const { return math::Vec3(position[0][i], position[1][i], position[2][i]); }
+		inline math::Vec3 GetVelocity(int i) const { return math::Vec3(velocity[0][i], velocity[1][i], velocity[2][i]); }
+
+		inline void SetPosition(int i, const math::Vec3 &value) { for (int j = 0; j < 3; j++) position[j][i] = value[j]; }
+		inline void SetVelocity(int i, const math::Vec3 &value) { for (int j = 0; j < 3; j++) velocity[j][i] = value[j]; }
+
+		inline const VanDerWaalsPair &GetVanDerWaalsPair(int i, int j) const { return vdwPairTable[typeId[i] * typeNames.size() + typeId[j]]; }
+
+		std::vector<double> position[3];
+		std::vector<double> velocity[3];
+		std::vector<double> acceleration[3];
+		/* Velocity before the last velocity update, used for the leapfrog kinetic energy. */
+		std::vector<double> previousVelocity[3];
+
+		std::vector<double> mass;
+		std::vector<double> charge;
+		/* Radius given in the input, e.g. the PQR radius column, 0 if there is none. Only implicit solvent reads it. */
+		std::vector<double> radius;
+		std::vector<double> vdwRadius;
+		std::vector<double> vdwAttractionMagnitude;
+		std::vector<int> typeId;
+
+		std::vector<String> typeNames;
+		/* Row-major GetNTypes() x GetNTypes() table of pair parameters, indexed by type id. */
+		std::vector<VanDerWaalsPair> vdwPairTable;
+
+	private:
+		std::map<String, int> m_typeIds;
+	};
+
+}
\ No newline at end of file
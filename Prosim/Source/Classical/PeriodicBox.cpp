@@ -0,0 +1,88 @@
+#include "PeriodicBox.h"
+
+namespace classical {
+
+	PeriodicBox::PeriodicBox()
+		: m_periodic(false) {
+
+		for (int j = 0; j < 3; j++) {
+			m_lengths[j] = 0.0;
+			m_inverseLengths[j] = 0.0;
+			m_center[j] = 0.0;
+		}
+	}
+
+	PeriodicBox::PeriodicBox(double a, double b, double c, const math::Vec3 &center)
+		: m_periodic(a > 0.0 && b > 0.0 && c > 0.0) {
+
+		m_lengths[0] = a;
+		m_lengths[1] = b;
+		m_lengths[2] = c;
+
+		for (int j = 0; j < 3; j++) {
+			if (!m_periodic) m_lengths[j] = 0.0;
+
+			m_inverseLengths[j] = m_periodic ? 1.0 / m_lengths[j] : 0.0;
+			m_center[j] = center[j];
+		}
+	}
+
+	void PeriodicBox::Scale(double scale) {
+		if (!m_periodic) return;
+
+		for (int j = 0; j < 3; j++) {
+			m_lengths[j] *= scale;
+			m_inverseLengths[j] = 1.0 / m_lengths[j];
+		}
+	}
+
+	math::Vec3 PeriodicBox::GetNearestImage(const math::Vec3 &position, const math::Vec3 &reference) const {
+		if (!m_periodic) return position;
+
+		double a = position.x - reference.x;
+		double b = position.y - reference.y;
+		double c = position.z - reference.z;
+
+		ApplyMinimumImage(a, b, c);
+
+		return math::Vec3(reference.x + a, reference.y + b, reference.z + c);
+	}
+
+	void PeriodicBox::WrapMolecules(std::vector<double> *positions, const std::vector<int> &moleculeOffsets, const std::vector<int> &moleculeAtoms) const {
+		if (!m_periodic) return;
+
+		int nmolecules = (int)moleculeOffsets.size() - 1;
+
+		for (int m = 0; m < nmolecules; m++) {
+			int begin = moleculeOffsets[m];
+			int end = moleculeOffsets[m + 1];
+
+			for (int j = 0; j < 3; j++) {
+				double center = 0.0;
+
+				for (int n = begin; n < end; n++) {
+					center += positions[j][moleculeAtoms[n]];
+				}
+
+				center /= end - begin;
+
+				double shift = m_lengths[j] * floor((center - GetCorner(j)) * m_inverseLengths[j]);
+
+				for (int n = begin; n < end; n++) {
+					positions[j][moleculeAtoms[n]] -= shift;
+				}
+			}
+		}
+	}
+
+	bool PeriodicBox::operator==(const PeriodicBox &other) const {
+		if (m_periodic != other.m_periodic) return false;
+
+		for (int j = 0; j < 3; j++) {
+			if (m_lengths[j] != other.m_lengths[j] || m_center[j] != other.m_center[j]) return false;
+		}
+
+		return true;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <math.h>
+
+#include <vector>
+
+#include "Math/PSMath.h"
+
+namespace classical {
+
+	/* Orthorhombic periodic cell with edge lengths a, b and c, centered on a point. A default constructed box is not
+	   periodic and leaves every distance as it is, so code paths can take a box unconditionally. Positions are never
+	   wrapped during a run; separations are reduced to their nearest image instead, which keeps molecules whole. */
+	class PeriodicBox {
+	public:
+		PeriodicBox();
+		PeriodicBox(double a, double b, double c, const math::Vec3 &center);
+
+		inline bool IsPeriodic() const { return m_periodic; }
+		inline double GetLength(int j) const { return m_lengths[j]; }
+		inline double GetInverseLength(int j) const { return m_inverseLengths[j]; }
+		inline double GetCenter(int j) const { return m_center[j]; }
+		/* Lower corner of the cell along axis j. */
+		inline double GetCorner(int j) const { return m_center[j] - 0.5 * m_lengths[j]; }
+		inline double GetVolume() const { return m_lengths[0] * m_lengths[1] * m_lengths[2]; }
+		inline double GetMinimumLength() const { return fmin(m_lengths[0], fmin(m_lengths[1], m_lengths[2])); }
+
+		/* Scales the edges about the center. */
+		void Scale(double scale);
+
+		/* Reduces the separation (a, b, c) to its nearest periodic image. */
+		inline void ApplyMinimumImage(double &a, double &b, double &c) const {
+			if (!m_periodic) return;
+
+			a -= m_lengths[0] * round(a * m_inverseLengths[0]);
+			b -= m_lengths[1] * round(b * m_inverseLengths[1]);
+			c -= m_lengths[2] * round(c * m_inverseLengths[2]);
+		}
+
+		/* Image of position closest to reference. */
+		math::Vec3 GetNearestImage(const math::Vec3 &position, const math::Vec3 &reference) const;
+
+		/* Shifts every molecule, given as offsets into a flattened atom list, by whole cell edges so that its geometric
+		   center lies inside the cell. */
+		void WrapMolecules(std::vector<double> *positions, const std::vector<int> &moleculeOffsets, const std::vector<int> &moleculeAtoms) const;
+
+		bool operator==(const PeriodicBox &other) const;
+		inline bool operator!=(const PeriodicBox &other) const { return !(*this == other); }
+	private:
+		bool m_periodic;
+		double m_lengths[3];
+		double m_inverseLengths[3];
+		double m_center[3];
+	};
+
+}
\ No newline at end of file
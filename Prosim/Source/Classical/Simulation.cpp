@@ -1,5 +1,12 @@
 #include "Simulation.h"
 
+#include <algorithm>
+#include <iostream>
+
+#include <omp.h>
+
+#include "Topology.h"
+
 namespace classical {
 
 	Simulation::Simulation(Molecule *molecule, const SimulationParameters &simulationParameters)
@@ -11,6 +18,102 @@ namespace classical {
 		m_molecule->m_boundaryType = m_parameters.GetBoundaryType();
 		m_molecule->CalculateVolume();
 		m_molecule->m_origin = m_parameters.GetOrigin();
+
+		if (m_molecule->m_boundaryType == "periodic") {
+			math::Vec3 boxSize = m_parameters.GetBoxSize();
+
+			/* Without a box size the box is the cube of edge 2 * boundary. */
+			if (boxSize.x <= 0.0 || boxSize.y <= 0.0 || boxSize.z <= 0.0) {
+				double edge = 2.0 * m_molecule->m_boundary;
+				boxSize = math::Vec3(edge, edge, edge);
+			}
+
+			m_molecule->m_periodicBox = PeriodicBox(boxSize.x, boxSize.y, boxSize.z, m_molecule->m_origin);
+			m_molecule->CalculateVolume();
+			/* Molecules wrapped across the box faces are only bonded once the box is known. */
+			m_molecule->UpdateTopology();
+			MakeMoleculesWhole(m_molecule->m_particles, m_molecule->m_bondGraph, m_molecule->m_periodicBox);
+		}
+
+		m_molecule->m_nonBondedCutoff = m_parameters.GetNonBondedCutoff();
+
+		/* The minimum image convention only finds every pair within the cutoff if it is at most half the shortest edge. */
+		if (m_molecule->m_periodicBox.IsPeriodic() && (m_molecule->m_nonBondedCutoff <= 0.0 || m_molecule->m_nonBondedCutoff > 0.5 * m_molecule->m_periodicBox.GetMinimumLength())) {
+			std::cout << "The non-bonded cutoff " << m_molecule->m_nonBondedCutoff << " A does not fit the periodic box; using half its shortest edge" << std::endl;
+			m_molecule->m_nonBondedCutoff = 0.5 * m_molecule->m_periodicBox.GetMinimumLength();
+		}
+
+		m_molecule->m_neighborListSkin = m_parameters.GetNeighborListSkin();
+		m_molecule->m_vdw14Scale = m_parameters.GetVDW14Scale();
+		m_molecule->m_elst14Scale = m_parameters.GetElst14Scale();
+		m_molecule->m_nonBondedKernel = ResolveNonBondedKernel(m_parameters.GetNonBondedKernel());
+		m_molecule->m_nonBondedDeterministic = m_parameters.GetNonBondedDeterministic();
+		m_molecule->m_electrostatics = ResolveElectrostaticsMethod(m_parameters.GetElectrostatics());
+		m_molecule->m_ewaldTolerance = m_parameters.GetEwaldTolerance();
+		m_molecule->m_pmeGridSpacing = m_parameters.GetPMEGridSpacing();
+		m_molecule->m_pmeOrder = std::max(3, m_parameters.GetPMEOrder());
+		m_molecule->m_reactionFieldDielectric = m_parameters.GetReactionFieldDielectric();
+		m_molecule->m_vdwSwitchDistance = m_parameters.GetVDWSwitchDistance();
+		m_molecule->m_implicitSolvent = ResolveImplicitSolventModel(m_parameters.GetImplicitSolvent());
+		m_molecule->m_solventDielectric = m_parameters.GetSolventDielectric();
+		m_molecule->m_constraints.SetTolerance(m_parameters.GetConstraintTolerance());
+		m_molecule->m_constraints.Build(ResolveConstraintType(m_parameters.GetConstraints()), m_parameters.GetRigidWater(), m_molecule->m_atoms, m_molecule->m_bonds, m_molecule->m_angles, m_molecule->m_bondGraph, m_molecule->m_particles);
+
+		/* Rigid waters have no internal bonded terms; their exclusions stay in place. */
+		if (m_molecule->m_constraints.GetNWaters()) {
+			RemoveRigidWaterTerms(m_molecule->m_nAtoms, m_molecule->m_constraints.GetWaters(), m_molecule->m_bonds, m_molecule->m_angles);
+			m_molecule->m_bonds.ColorByAtoms(m_molecule->m_nAtoms);
+			m_molecule->m_angles.ColorByAtoms(m_molecule->m_nAtoms);
+			m_molecule->m_nBonds = m_molecule->m_bonds.GetSize();
+			m_molecule->m_nAngles = m_molecule->m_angles.GetSize();
+		}
+
+		m_molecule->UpdateInternals();
+
+		if (m_molecule->m_electrostatics == ElectrostaticsMethod::PME && !m_molecule->m_periodicBox.IsPeriodic() && !(m_molecule->m_boundary > 0.0 && m_molecule->m_boundary < 1.0E3)) {
+			std::cout << "PME needs a finite box, but the boundary is " << m_molecule->m_boundary << " A; using plain Coulomb electrostatics" << std::endl;
+			m_molecule->m_electrostatics = ElectrostaticsMethod::Coulomb;
+		}
+
+		if (m_molecule->m_electrostatics == ElectrostaticsMethod::PME && m_molecule->m_boundaryType != "cube" && !m_molecule->m_periodicBox.IsPeriodic()) {
+			std::cout << "PME uses a periodic cube of edge 2 * boundary; the " << m_molecule->m_boundaryType << " boundary only confines the atoms" << std::endl;
+		}
+
+		/* The cell list only searches images across the faces of a periodic box, so the implied PME cube needs all pairs. */
+		if (m_molecule->m_electrostatics == ElectrostaticsMethod::PME && !m_molecule->m_periodicBox.IsPeriodic() && m_molecule->m_nonBondedCutoff > 0.0) {
+			std::cout << "PME without a periodic boundary needs all pairs to see images across the box faces; ignoring the non-bonded cutoff" << std::endl;
+			m_molecule->m_nonBondedCutoff = 0.0;
+		}
+
+		if (m_molecule->m_implicitSolvent != ImplicitSolventModel::None && m_molecule->m_periodicBox.IsPeriodic()) {
+			std::cout << "Generalized Born implicit solvent needs a non-periodic system; running without it" << std::endl;
+			m_molecule->m_implicitSolvent = ImplicitSolventModel::None;
+		}
+
+		bool cutoffMethod = m_molecule->m_electrostatics == ElectrostaticsMethod::ReactionField || m_molecule->m_electrostatics == ElectrostaticsMethod::ForceShifted;
+
+		if (m_molecule->m_nonBondedCutoff <= 0.0 && (cutoffMethod || m_molecule->m_vdwSwitchDistance > 0.0)) {
+			std::cout << "Without a non-bonded cutoff " << GetElectrostaticsMethodName(m_molecule->m_electrostatics) << " electrostatics are plain Coulomb and van der Waals is not switched" << std::endl;
+		}
+
+		if (m_molecule->m_nonBondedCutoff > 0.0 && m_molecule->m_vdwSwitchDistance >= m_molecule->m_nonBondedCutoff) {
+			std::cout << "The van der Waals switch distance " << m_molecule->m_vdwSwitchDistance << " A is not below the cutoff; van der Waals is truncated" << std::endl;
+		}
+
+		/* Zero keeps the OpenMP default of one thread per core. */
+		if (m_parameters.GetThreads() > 0) {
+			omp_set_num_threads(m_parameters.GetThreads());
+		}
+
+		if (!IsNonBondedKernelApplicable(m_molecule->m_nonBondedKernel, m_molecule->m_electrostatics, m_molecule->m_vdwSwitchDistance, m_molecule->m_nonBondedCutoff)) {
+			std::cout << "The " << GetNonBondedKernelName(m_molecule->m_nonBondedKernel) << " non-bonded kernel only implements plain Coulomb electrostatics and unswitched van der Waals; using the scalar kernel" << std::endl;
+			m_molecule->m_nonBondedKernel = NonBondedKernel::Scalar;
+		}
+
+		if (m_molecule->m_nonBondedKernel != NonBondedKernel::Scalar && !VerifyNonBondedKernel(m_molecule->m_nonBondedKernel, m_molecule->m_nonBondedDeterministic, m_molecule->m_particles, m_molecule->m_neighborList, m_molecule->m_exclusions, m_molecule->m_dielectric, m_parameters.GetNonBondedKernelTolerance())) {
+			std::cout << "Falling back to the scalar non-bonded kernel" << std::endl;
+			m_molecule->m_nonBondedKernel = NonBondedKernel::Scalar;
+		}
 	}
 
 	void Simulation::CloseOutputFiles() {
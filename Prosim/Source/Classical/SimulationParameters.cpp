@@ -46,9 +46,36 @@ namespace classical {
 		stream << "\tBoundary: " << simulationParameters.m_boundary << std::endl;
 		stream << "\tBoundary type: " << simulationParameters.m_boundaryType << std::endl;
 		stream << "\tOrigin: " << simulationParameters.m_origin << std::endl;
+		stream << "\tBox size: " << simulationParameters.m_boxSize << std::endl;
+		stream << "\tNon-bonded cutoff: " << simulationParameters.m_nonBondedCutoff << std::endl;
+		stream << "\tNeighbor list skin: " << simulationParameters.m_neighborListSkin << std::endl;
+		stream << "\t1-4 van der Waals scale: " << simulationParameters.m_vdw14Scale << std::endl;
+		stream << "\t1-4 electrostatic scale: " << simulationParameters.m_elst14Scale << std::endl;
+		stream << "\tNon-bonded kernel: " << simulationParameters.m_nonBondedKernel << std::endl;
+		stream << "\tNon-bonded kernel tolerance: " << simulationParameters.m_nonBondedKernelTolerance << std::endl;
+		stream << "\tNon-bonded deterministic: " << simulationParameters.m_nonBondedDeterministic << std::endl;
+		stream << "\tThreads: " << simulationParameters.m_threads << std::endl;
+		stream << "\tElectrostatics: " << simulationParameters.m_electrostatics << std::endl;
+		stream << "\tEwald tolerance: " << simulationParameters.m_ewaldTolerance << std::endl;
+		stream << "\tPME grid spacing: " << simulationParameters.m_pmeGridSpacing << std::endl;
+		stream << "\tPME order: " << simulationParameters.m_pmeOrder << std::endl;
+		stream << "\tReaction field dielectric: " << simulationParameters.m_reactionFieldDielectric << std::endl;
+		stream << "\tVan der Waals switch distance: " << simulationParameters.m_vdwSwitchDistance << std::endl;
+		stream << "\tImplicit solvent: " << simulationParameters.m_implicitSolvent << std::endl;
+		stream << "\tSolvent dielectric: " << simulationParameters.m_solventDielectric << std::endl;
 		stream << "\tTotal time: " << simulationParameters.m_totalTime << std::endl;
 		stream << "\tTotal configurations: " << simulationParameters.m_totalConfigurations << std::endl;
 		stream << "\tTime step: " << simulationParameters.m_timeStep << std::endl;
+		stream << "\tIntegrator: " << simulationParameters.m_integrator << std::endl;
+		stream << "\tRESPA inner steps: " << simulationParameters.m_respaInnerSteps << std::endl;
+		stream << "\tLangevin friction: " << simulationParameters.m_langevinFriction << std::endl;
+		stream << "\tThermostat time constant: " << simulationParameters.m_thermostatTimeConstant << std::endl;
+		stream << "\tNose-Hoover chain length: " << simulationParameters.m_noseHooverChainLength << std::endl;
+		stream << "\tBarostat: " << simulationParameters.m_barostat << std::endl;
+		stream << "\tBarostat interval: " << simulationParameters.m_barostatInterval << std::endl;
+		stream << "\tConstraints: " << simulationParameters.m_constraints << std::endl;
+		stream << "\tConstraint tolerance: " << simulationParameters.m_constraintTolerance << std::endl;
+		stream << "\tRigid water: " << simulationParameters.m_rigidWater << std::endl;
 		stream << "\tGeometry wait time: " << simulationParameters.m_geometryWaitTime << std::endl;
 		stream << "\tGeometry configurations: " << simulationParameters.m_geometryConfigurations << std::endl;
 		stream << "\tEnergy output file path: " << simulationParameters.m_energyOutputFilePath << std::endl;
@@ -76,9 +103,36 @@ namespace classical {
 		m_boundary = 10.0;
 		m_boundaryType = "sphere";
 		m_origin = math::Vec3();
+		m_boxSize = math::Vec3();
+		m_nonBondedCutoff = 0.0;
+		m_neighborListSkin = 2.0;
+		m_vdw14Scale = 0.5;
+		m_elst14Scale = 1.0 / 1.2;
+		m_nonBondedKernel = "auto";
+		m_nonBondedKernelTolerance = 1e-5;
+		m_nonBondedDeterministic = false;
+		m_threads = 0;
+		m_electrostatics = "coulomb";
+		m_ewaldTolerance = 1e-5;
+		m_pmeGridSpacing = 1.0;
+		m_pmeOrder = 4;
+		m_reactionFieldDielectric = 78.5;
+		m_vdwSwitchDistance = 0.0;
+		m_implicitSolvent = "none";
+		m_solventDielectric = 78.5;
 		m_totalTime = 0.5;
 		m_totalConfigurations = 1000;
 		m_timeStep = 0.0005;
+		m_integrator = "leapfrog";
+		m_respaInnerSteps = 4;
+		m_langevinFriction = 1.0;
+		m_thermostatTimeConstant = 0.1;
+		m_noseHooverChainLength = 3;
+		m_barostat = "none";
+		m_barostatInterval = 25;
+		m_constraints = "none";
+		m_constraintTolerance = 1e-8;
+		m_rigidWater = false;
 		m_geometryWaitTime = 0.001;
 		m_geometryConfigurations = 1;
 		m_energyOutputFilePath = "energy.dat";
@@ -101,7 +155,7 @@ namespace classical {
 		if (key.find("desired-temperature") != String::npos) { m_desiredTemperature = utils::ToDouble(value); }
 		if (key.find("desired-pressure") != String::npos) { m_desiredPressure = utils::ToDouble(value); }
 		if (key.find("boundary-spring") != String::npos) { m_boundarySpring = utils::ToDouble(value); }
-		if (key.find("boundary") != String::npos) { m_boundary = utils::ToDouble(value); }
+		if (key.find("boundary") != String::npos && key.find("boundary-") == String::npos) { m_boundary = utils::ToDouble(value); }
 		if (key.find("boundary-type") != String::npos) { m_boundaryType = value; }
 		if (key.find("origin") != String::npos) {
 			std::vector<String> valueTokens = utils::SplitString(value, ',');
@@ -110,9 +164,42 @@ namespace classical {
 				m_origin = math::Vec3(utils::ToDouble(valueTokens[0]), utils::ToDouble(valueTokens[1]), utils::ToDouble(valueTokens[2]));
 			}
 		}
+		if (key.find("box-size") != String::npos) {
+			std::vector<String> valueTokens = utils::SplitString(value, ',');
+
+			if (valueTokens.size() >= 3) {
+				m_boxSize = math::Vec3(utils::ToDouble(valueTokens[0]), utils::ToDouble(valueTokens[1]), utils::ToDouble(valueTokens[2]));
+			}
+		}
+		if (key.find("non-bonded-cutoff") != String::npos) { m_nonBondedCutoff = utils::ToDouble(value); }
+		if (key.find("neighbor-list-skin") != String::npos) { m_neighborListSkin = utils::ToDouble(value); }
+		if (key.find("vdw-14-scale") != String::npos) { m_vdw14Scale = utils::ToDouble(value); }
+		if (key.find("elst-14-scale") != String::npos) { m_elst14Scale = utils::ToDouble(value); }
+		if (key.find("non-bonded-kernel") != String::npos && key.find("non-bonded-kernel-") == String::npos) { m_nonBondedKernel = value; }
+		if (key.find("non-bonded-kernel-tolerance") != String::npos) { m_nonBondedKernelTolerance = utils::ToDouble(value); }
+		if (key.find("non-bonded-deterministic") != String::npos) { m_nonBondedDeterministic = utils::NextInt(value) != 0; }
+		if (key.find("threads") != String::npos) { m_threads = utils::NextInt(value); }
+		if (key.find("electrostatics") != String::npos) { m_electrostatics = value; }
+		if (key.find("ewald-tolerance") != String::npos) { m_ewaldTolerance = utils::ToDouble(value); }
+		if (key.find("pme-grid-spacing") != String::npos) { m_pmeGridSpacing = utils::ToDouble(value); }
+		if (key.find("pme-order") != String::npos) { m_pmeOrder = utils::NextInt(value); }
+		if (key.find("reaction-field-dielectric") != String::npos) { m_reactionFieldDielectric = utils::ToDouble(value); }
+		if (key.find("vdw-switch-distance") != String::npos) { m_vdwSwitchDistance = utils::ToDouble(value); }
+		if (key.find("implicit-solvent") != String::npos) { m_implicitSolvent = value; }
+		if (key.find("solvent-dielectric") != String::npos) { m_solventDielectric = utils::ToDouble(value); }
 		if (key.find("total-time") != String::npos) { m_totalTime = utils::ToDouble(value); }
 		if (key.find("total-configurations") != String::npos) { m_totalConfigurations = utils::NextInt(value); }
 		if (key.find("time-step") != String::npos) { m_timeStep = utils::ToDouble(value); }
+		if (key.find("integrator") != String::npos) { m_integrator = value; }
+		if (key.find("respa-inner-steps") != String::npos) { m_respaInnerSteps = utils::NextInt(value); }
+		if (key.find("langevin-friction") != String::npos) { m_langevinFriction = utils::ToDouble(value); }
+		if (key.find("thermostat-time-constant") != String::npos) { m_thermostatTimeConstant = utils::ToDouble(value); }
+		if (key.find("nose-hoover-chain-length") != String::npos) { m_noseHooverChainLength = utils::NextInt(value); }
+		if (key.find("barostat") != String::npos && key.find("barostat-") == String::npos) { m_barostat = value; }
+		if (key.find("barostat-interval") != String::npos) { m_barostatInterval = utils::NextInt(value); }
+		if (key.find("constraints") != String::npos) { m_constraints = value; }
+		if (key.find("constraint-tolerance") != String::npos) { m_constraintTolerance = utils::ToDouble(value); }
+		if (key.find("rigid-water") != String::npos) { m_rigidWater = utils::NextInt(value) != 0; }
 		if (key.find("geometry-wait-time") != String::npos) { m_geometryWaitTime = utils::ToDouble(value); }
 		if (key.find("geometry-configurations") != String::npos) { m_geometryConfigurations = utils::NextInt(value); }
 		if (key.find("energy-output-file-path") != String::npos) { m_energyOutputFilePath = value; }
@@ -20,9 +20,36 @@ namespace classical {
 		inline double GetBoundary() { return m_boundary; }
 		inline const String &GetBoundaryType() { return m_boundaryType; }
 		inline const math::Vec3 &GetOrigin() { return m_origin; }
+		inline const math::Vec3 &GetBoxSize() { return m_boxSize; }
+		inline double GetNonBondedCutoff() { return m_nonBondedCutoff; }
+		inline double GetNeighborListSkin() { return m_neighborListSkin; }
+		inline double GetVDW14Scale() { return m_vdw14Scale; }
+		inline double GetElst14Scale() { return m_elst14Scale; }
+		inline const String &GetNonBondedKernel() { return m_nonBondedKernel; }
+		inline double GetNonBondedKernelTolerance() { return m_nonBondedKernelTolerance; }
+		inline bool GetNonBondedDeterministic() { return m_nonBondedDeterministic; }
+		inline int GetThreads() { return m_threads; }
+		inline const String &GetElectrostatics() { return m_electrostatics; }
+		inline double GetEwaldTolerance() { return m_ewaldTolerance; }
+		inline double GetPMEGridSpacing() { return m_pmeGridSpacing; }
+		inline int GetPMEOrder() { return m_pmeOrder; }
+		inline double GetReactionFieldDielectric() { return m_reactionFieldDielectric; }
+		inline double GetVDWSwitchDistance() { return m_vdwSwitchDistance; }
+		inline const String &GetImplicitSolvent() { return m_implicitSolvent; }
+		inline double GetSolventDielectric() { return m_solventDielectric; }
 		inline double GetTotalTime() { return m_totalTime; }
 		inline int GetTotalConfigurations() { return m_totalConfigurations; }
 		inline double GetTimeStep() { return m_timeStep; }
+		inline const String &GetIntegrator() { return m_integrator; }
+		inline int GetRESPAInnerSteps() { return m_respaInnerSteps; }
+		inline double GetLangevinFriction() { return m_langevinFriction; }
+		inline double GetThermostatTimeConstant() { return m_thermostatTimeConstant; }
+		inline int GetNoseHooverChainLength() { return m_noseHooverChainLength; }
+		inline const String &GetBarostat() { return m_barostat; }
+		inline int GetBarostatInterval() { return m_barostatInterval; }
+		inline const String &GetConstraints() { return m_constraints; }
+		inline double GetConstraintTolerance() { return m_constraintTolerance; }
+		inline bool GetRigidWater() { return m_rigidWater; }
 		inline double GetGeometryWaitTime() { return m_geometryWaitTime; }
 		inline int GetGeometryConfigurations() { return m_geometryConfigurations; }
 		inline const String &GetEnergyOutputFilePath() const { return m_energyOutputFilePath; }
@@ -53,9 +80,36 @@ namespace classical {
 		double m_boundary;
 		String m_boundaryType;
 		math::Vec3 m_origin;
+		math::Vec3 m_boxSize;
+		double m_nonBondedCutoff;
+		double m_neighborListSkin;
+		double m_vdw14Scale;
+		double m_elst14Scale;
+		String m_nonBondedKernel;
+		double m_nonBondedKernelTolerance;
+		bool m_nonBondedDeterministic;
+		int m_threads;
+		String m_electrostatics;
+		double m_ewaldTolerance;
+		double m_pmeGridSpacing;
+		int m_pmeOrder;
+		double m_reactionFieldDielectric;
+		double m_vdwSwitchDistance;
+		String m_implicitSolvent;
+		double m_solventDielectric;
 		double m_totalTime;
 		int m_totalConfigurations;
 		double m_timeStep;
+		String m_integrator;
+		int m_respaInnerSteps;
+		double m_langevinFriction;
+		double m_thermostatTimeConstant;
+		int m_noseHooverChainLength;
+		String m_barostat;
+		int m_barostatInterval;
+		String m_constraints;
+		double m_constraintTolerance;
+		bool m_rigidWater;
 		double m_geometryWaitTime;
 		int m_geometryConfigurations;
 		String m_energyOutputFilePath;
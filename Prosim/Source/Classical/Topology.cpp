@@ -1,166 +1,185 @@
 #include "Topology.h"
 
+#include <math.h>
+#include <omp.h>
+
 #include <algorithm>
+#include <tuple>
 
+#include "CellList.h"
 #include "Constants.h"
 #include "Geometry.h"
 
-#include "Utils/IterationTools.h"
-
 namespace classical {
 
-	void CalculateBondGraph(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, ForceField *forceField) {
+	void CalculateBondedPairs(const std::vector<Atom *> &atoms, const ParticleStore &particles, std::vector<int> &bondedPairs, const PeriodicBox &box) {
 		int natoms = atoms.size();
 
-		utils::IterationMatrix matrix(utils::CombinationsNR(natoms, 2), 2);
+		/* The covalent radii were looked up once per atom on construction. */
+		std::vector<double> covalentRadii(natoms);
+		double maxCovalentRadius = 0.0;
+
+		for (int i = 0; i < natoms; i++) {
+			covalentRadii[i] = atoms[i]->covalentRadius;
+			maxCovalentRadius = std::max(maxCovalentRadius, fabs(covalentRadii[i]));
+		}
 
-		utils::CombinationKN(matrix, 2, natoms);
+		if (natoms < 2 || maxCovalentRadius == 0.0) return;
 
-#ifdef PS_OPTIMIZED
-#pragma omp parallel for
-#endif
-		for (int n = 0; n < utils::CombinationsNR(natoms, 2); n++) {
-			int i = matrix(n, 0);
-			int j = matrix(n, 1);
+		/* No pair further apart than the largest possible threshold can bond, so only neighboring cells are searched; in a
+		   periodic box these include the images across its faces. */
+		CellList cellList;
+		cellList.Build(particles, 2.0 * BOND_THRESHOLD * maxCovalentRadius, box);
 
-			Atom *atom1 = atoms[i];
-			Atom *atom2 = atoms[j];
+		int nCells = cellList.GetNCells();
+		std::vector<std::vector<int>> threadPairs(omp_get_max_threads());
 
-			double covalentRadius1 = forceField->GetCovalentRadius(atom1->element);
-			double covalentRadius2 = forceField->GetCovalentRadius(atom2->element);
+#pragma omp parallel
+		{
+			std::vector<int> &pairs = threadPairs[omp_get_thread_num()];
 
-			double threshold = BOND_THRESHOLD * (covalentRadius1 + covalentRadius2);
-			double distance = GetRij(atom1->position, atom2->position);
-			double distance2 = distance * distance;
+#pragma omp for schedule(dynamic, 16)
+			for (int cell = 0; cell < nCells; cell++) {
+				cellList.ForEachPairInCell(particles, cell, [&](int i, int j, double r2) {
+					double threshold = BOND_THRESHOLD * (covalentRadii[i] + covalentRadii[j]);
 
-			if (distance2 < threshold * threshold) {
-				bondGraph[i][j] = bondGraph[j][i] = distance;
+					if (r2 < threshold * threshold) {
+						pairs.push_back(i);
+						pairs.push_back(j);
+					}
+				});
 			}
 		}
+
+		for (auto &pairs : threadPairs) {
+			bondedPairs.insert(bondedPairs.end(), pairs.begin(), pairs.end());
+		}
 	}
 
-	void CalculateBondGraphFromBonds(int natoms, std::map<int, std::map<int, double>> &bondGraph, const std::vector<Bond *> &bonds) {
-		for (auto &bond : bonds) {
-			bondGraph[bond->atom1][bond->atom2] = bondGraph[bond->atom2][bond->atom1] = bond->distance;
+	void CalculateBondedPairsFromBonds(const BondTable &bonds, std::vector<int> &bondedPairs) {
+		for (int n = 0; n < bonds.GetSize(); n++) {
+			bondedPairs.push_back(bonds.atom1[n]);
+			bondedPairs.push_back(bonds.atom2[n]);
 		}
 	}
 
-	void CalculateBonds(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, std::vector<Bond *> &bonds, ForceField *forceField) {
-		bonds.clear();
+	void CalculateBonds(const std::vector<Atom *> &atoms, const BondGraph &bondGraph, BondTable &bonds, ForceField *forceField) {
+		bonds.Clear();
+
+		const std::vector<int> &offsets = bondGraph.GetOffsets();
 
 		int i = 0;
 
 		for (auto &atom1 : atoms) {
-			for (auto pair : bondGraph[i]) {
-				int j = pair.first;
+			for (int edge = offsets[i]; edge < offsets[i + 1]; edge++) {
+				int j = bondGraph.GetNeighbor(edge);
 				if (i > j) continue;
 
 				Atom *atom2 = atoms[j];
-				double distance = bondGraph[i][j];
+				int graphIndex = bondGraph.GetEdgeBond(edge);
+				double distance = bondGraph.GetLength(graphIndex);
 
-				double equilibriumDistance = forceField->GetBondEquilibriumLength(atom1->type, atom2->type);
-				double springConstant = forceField->GetBondSpringConstant(atom1->type, atom2->type);
+				double equilibriumDistance = forceField->GetBondEquilibriumLength(atom1->typeId, atom2->typeId);
+				double springConstant = forceField->GetBondSpringConstant(atom1->typeId, atom2->typeId);
 
 				if (springConstant) {
-					bonds.push_back(new Bond(i, j, distance, equilibriumDistance, springConstant));
+					Bond bond(i, j, distance, equilibriumDistance, springConstant);
+					bond.graphIndex = graphIndex;
+
+					bonds.Add(bond);
 				}
 			}
 
 			i++;
 		}
 
-		std::sort(std::begin(bonds), std::end(bonds), [](Bond *a, Bond *b) {return a->atom1 < b->atom1; });
+		bonds.SortByFirstAtom();
 	}
 
-	void CalculateAngles(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, std::vector<Angle *> &angles, ForceField *forceField) {
-		angles.clear();
+	void CalculateAngles(const std::vector<Atom *> &atoms, const ParticleStore &particles, const BondGraph &bondGraph, AngleTable &angles, ForceField *forceField) {
+		angles.Clear();
+
+		const std::vector<int> &offsets = bondGraph.GetOffsets();
 
 		int j = 0;
 
 		for (auto &atom2 : atoms) {
-			std::vector<int> row;
-			std::vector<std::vector<int>> indices;
-
-			for (std::map<int, double>::iterator it = bondGraph[j].begin(); it != bondGraph[j].end(); ++it) {
-				row.push_back(it->first);
-			}
+			/* Every pair of neighbors of j; rows are ascending, so i < k. */
+			for (int edge1 = offsets[j]; edge1 < offsets[j + 1]; edge1++) {
+				for (int edge2 = edge1 + 1; edge2 < offsets[j + 1]; edge2++) {
+					int i = bondGraph.GetNeighbor(edge1);
+					int k = bondGraph.GetNeighbor(edge2);
 
-			if (row.size()) {
-				int *data = new int[row.size()];
-
-				utils::CombinationArray(&row[0], data, indices, 0, row.size() - 1, 0, 2);
-
-				delete[] data;
-			}
+					Atom *atom1 = atoms[i];
+					Atom *atom3 = atoms[k];
 
-			for (auto &v : indices) {
-				int i = v[0];
-				int k = v[1];
+					double aijk = GetAijk(particles.GetPosition(i), particles.GetPosition(j), particles.GetPosition(k));
+					double angleEquilibriumDegrees = forceField->GetAngleEquilibriumDegrees(atom1->typeId, atom2->typeId, atom3->typeId);
+					double angleSpringConstant = forceField->GetAngleSpringConstant(atom1->typeId, atom2->typeId, atom3->typeId);
 
-				if (i > k) continue;
+					if (angleSpringConstant) {
+						Angle angle(i, j, k, aijk, angleEquilibriumDegrees, angleSpringConstant);
+						angle.bond12 = bondGraph.GetEdgeBond(edge1);
+						angle.bond23 = bondGraph.GetEdgeBond(edge2);
 
-				Atom *atom1 = atoms[i];
-				Atom *atom3 = atoms[k];
-
-				double aijk = GetAijk(atom1->position, atom2->position, atom3->position);
-				double angleEquilibriumDegrees = forceField->GetAngleEquilibriumDegrees(atom1->type, atom2->type, atom3->type);
-				double angleSpringConstant = forceField->GetAngleSpringConstant(atom1->type, atom2->type, atom3->type);
-
-				if (angleSpringConstant) {
-					angles.push_back(new Angle(i, j, k, aijk, angleEquilibriumDegrees, angleSpringConstant));
+						angles.Add(angle);
+					}
 				}
 			}
 
 			j++;
 		}
 
-		std::sort(std::begin(angles), std::end(angles), [](Angle *a, Angle *b) {return a->atom1 < b->atom1; });
+		angles.SortByFirstAtom();
 	}
 
-	void CalculateTorsions(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, std::vector<Torsion *> &torsions, ForceField *forceField) {
-		torsions.clear();
+	void CalculateTorsions(const std::vector<Atom *> &atoms, const ParticleStore &particles, const BondGraph &bondGraph, TorsionTable &torsions, ForceField *forceField) {
+		torsions.Clear();
+
+		const std::vector<int> &offsets = bondGraph.GetOffsets();
 
 		int j = 0;
 
 		for (auto &atom2 : atoms) {
-			std::vector<int> row;
-
-			for (std::map<int, double>::iterator it = bondGraph[j].begin(); it != bondGraph[j].end(); ++it) {
-				row.push_back(it->first);
-			}
-
-			utils::IterationMatrix matrix(utils::PermutationsNR(row.size(), 2), 2);
-			utils::PermutationPairsVector(row, matrix);
+			/* Every ordered pair of distinct neighbors i, k of j, each central bond taken once from its lower atom. */
+			for (int edge1 = offsets[j]; edge1 < offsets[j + 1]; edge1++) {
+				for (int edge2 = offsets[j]; edge2 < offsets[j + 1]; edge2++) {
+					if (edge1 == edge2) continue;
 
-			for (int n = 0; n < utils::PermutationsNR(row.size(), 2); n++) {
-				int i = matrix(n, 0);
-				int k = matrix(n, 1);
+					int i = bondGraph.GetNeighbor(edge1);
+					int k = bondGraph.GetNeighbor(edge2);
 
-				if (j > k) continue;
+					if (j > k) continue;
 
-				Atom *atom1 = atoms[i];
-				Atom *atom3 = atoms[k];
+					Atom *atom1 = atoms[i];
+					Atom *atom3 = atoms[k];
 
-				for (auto pair : bondGraph[k]) {
-					int l = pair.first;
+					for (int edge3 = offsets[k]; edge3 < offsets[k + 1]; edge3++) {
+						int l = bondGraph.GetNeighbor(edge3);
 
-					if (l == i || l == j) continue;
+						if (l == i || l == j) continue;
 
-					Atom *atom4 = atoms[l];
+						Atom *atom4 = atoms[l];
 
-					double tijkl = GetTijkl(atom1->position, atom2->position, atom3->position, atom4->position);
+						double tijkl = GetTijkl(particles.GetPosition(i), particles.GetPosition(j), particles.GetPosition(k), particles.GetPosition(l));
 
-					std::vector<std::tuple<double, double, int, int>> torsionParameters = 
-						forceField->GetTorsionParameters(atom1->type, atom2->type, atom3->type, atom4->type);
+						std::vector<std::tuple<double, double, int, int>> torsionParameters = 
+							forceField->GetTorsionParameters(atom1->typeId, atom2->typeId, atom3->typeId, atom4->typeId);
 					
-					for (auto &tuple : torsionParameters) {
-						double vn = std::get<0>(tuple);
-						double gamma = std::get<1>(tuple);
-						int nfold = std::get<2>(tuple);
-						int paths = std::get<3>(tuple);
-
-						if (vn) {
-							torsions.push_back(new Torsion(i, j, k, l, tijkl, vn, gamma, nfold, paths));
+						for (auto &tuple : torsionParameters) {
+							double vn = std::get<0>(tuple);
+							double gamma = std::get<1>(tuple);
+							int nfold = std::get<2>(tuple);
+							int paths = std::get<3>(tuple);
+
+							if (vn) {
+								Torsion torsion(i, j, k, l, tijkl, vn, gamma, nfold, paths);
+								torsion.bond12 = bondGraph.GetEdgeBond(edge1);
+								torsion.bond23 = bondGraph.GetEdgeBond(edge2);
+								torsion.bond34 = bondGraph.GetEdgeBond(edge3);
+
+								torsions.Add(torsion);
+							}
 						}
 					}
 				}
@@ -169,142 +188,187 @@ namespace classical {
 			j++;
 		}
 
-		std::sort(std::begin(torsions), std::end(torsions), [](Torsion *a, Torsion *b) {return a->atom1 < b->atom1; });
+		torsions.SortByFirstAtom();
 	}
 
-	void CalculateOutOfPlanes(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, std::vector<OutOfPlane *> &outOfPlanes, ForceField *forceField) {
-		outOfPlanes.clear();
-
-		int k = 0;
-
-		for (auto &atom : atoms) {
-			std::vector<int> row;
-			std::vector<std::vector<int>> indices;
-
-			for (std::map<int, double>::iterator it = bondGraph[k].begin(); it != bondGraph[k].end(); ++it) {
-				row.push_back(it->first);
+	void CalculateOutOfPlanes(const std::vector<Atom *> &atoms, const ParticleStore &particles, const BondGraph &bondGraph, OutOfPlaneTable &outOfPlanes, ForceField *forceField) {
+		outOfPlanes.Clear();
+
+		const std::vector<int> &offsets = bondGraph.GetOffsets();
+
+		for (int k = 0; k < (int)atoms.size(); k++) {
+			/* Every triplet of neighbors of k; rows are ascending, so each neighbor pair below is already ordered. */
+			for (int edge1 = offsets[k]; edge1 < offsets[k + 1]; edge1++) {
+				for (int edge2 = edge1 + 1; edge2 < offsets[k + 1]; edge2++) {
+					for (int edge3 = edge2 + 1; edge3 < offsets[k + 1]; edge3++) {
+						/* Edges to atoms 1, 2 and 4; each neighbor in turn is the one out of the plane. */
+						int combos[3][3] = {
+							{ edge1, edge2, edge3 },
+							{ edge2, edge3, edge1 },
+							{ edge1, edge3, edge2 },
+						};
+
+						for (auto &combo : combos) {
+							int x = bondGraph.GetNeighbor(combo[0]);
+							int y = bondGraph.GetNeighbor(combo[1]);
+							int w = bondGraph.GetNeighbor(combo[2]);
+
+							double oijkl = GetOijkl(particles.GetPosition(x), particles.GetPosition(y), particles.GetPosition(k), particles.GetPosition(w));
+							double vn = forceField->GetOutOfPlaneHeightBarrier(atoms[x]->typeId, atoms[y]->typeId, atoms[k]->typeId, atoms[w]->typeId);
+
+							if (vn) {
+								OutOfPlane outOfPlane(x, y, k, w, oijkl, vn);
+								outOfPlane.bond31 = bondGraph.GetEdgeBond(combo[0]);
+								outOfPlane.bond32 = bondGraph.GetEdgeBond(combo[1]);
+								outOfPlane.bond34 = bondGraph.GetEdgeBond(combo[2]);
+
+								outOfPlanes.Add(outOfPlane);
+							}
+						}
+					}
+				}
 			}
+		}
 
-			if (row.size()) {
-				int *data = new int[row.size()];
+		outOfPlanes.SortByFirstAtom();
+	}
 
-				utils::CombinationArray(&row[0], data, indices, 0, row.size() - 1, 0, 3);
+	void CalculateExclusions(int natoms, const BondTable &bonds, const AngleTable &angles, const TorsionTable &torsions, ExclusionTable &exclusions) {
+		std::vector<int> excludedPairs;
+		std::vector<int> pairs14;
 
-				delete[] data;
-			}
+		for (int n = 0; n < bonds.GetSize(); n++) {
+			excludedPairs.push_back(bonds.atom1[n]);
+			excludedPairs.push_back(bonds.atom2[n]);
+		}
 
-			for (auto &v : indices) {
-				int i = v[0];
-				int j = v[1];
-				int l = v[2];
+		for (int n = 0; n < angles.GetSize(); n++) {
+			excludedPairs.push_back(angles.atom1[n]);
+			excludedPairs.push_back(angles.atom3[n]);
+		}
 
-				Atom *atom1 = atoms[i];
-				Atom *atom2 = atoms[j];
-				Atom *atom3 = atoms[l];
+		for (int n = 0; n < torsions.GetSize(); n++) {
+			pairs14.push_back(torsions.atom1[n]);
+			pairs14.push_back(torsions.atom4[n]);
+		}
 
-				std::vector<std::tuple<int, int, int, int>> combos = {
-					{ std::min(i, j), std::max(i, j), k, l },
-					{ std::min(j, l), std::max(j, l), k, i },
-					{ std::min(l, i), std::max(l, i), k, j },
-				};
+		exclusions.Build(natoms, excludedPairs, pairs14);
+	}
 
-				for (auto combo : combos) {
-					int x = std::get<0>(combo);
-					int y = std::get<1>(combo);
-					int z = std::get<2>(combo);
-					int w = std::get<3>(combo);
+	void RemoveRigidWaterTerms(int natoms, const std::vector<int> &waters, BondTable &bonds, AngleTable &angles) {
+		std::vector<int> water(natoms, -1);
 
-					double oijkl = GetOijkl(atoms[x]->position, atoms[y]->position, atoms[z]->position, atoms[w]->position);
-					double vn = forceField->GetOutOfPlaneHeightBarrier(atoms[x]->type, atoms[y]->type, atoms[z]->type, atoms[w]->type);
+		for (int n = 0; n < (int)waters.size(); n++) {
+			water[waters[n]] = n / 3;
+		}
 
-					if (vn) {
-						outOfPlanes.push_back(new OutOfPlane(x, y, z, w, oijkl, vn));
-					}
-				}
+		std::vector<int> keptBonds;
+		std::vector<int> keptAngles;
+
+		for (int n = 0; n < bonds.GetSize(); n++) {
+			if (water[bonds.atom1[n]] < 0 || water[bonds.atom1[n]] != water[bonds.atom2[n]]) {
+				keptBonds.push_back(n);
 			}
+		}
 
-			k++;
+		for (int n = 0; n < angles.GetSize(); n++) {
+			if (water[angles.atom1[n]] < 0 || water[angles.atom1[n]] != water[angles.atom2[n]] || water[angles.atom2[n]] != water[angles.atom3[n]]) {
+				keptAngles.push_back(n);
+			}
 		}
 
-		std::sort(std::begin(outOfPlanes), std::end(outOfPlanes), [](OutOfPlane *a, OutOfPlane *b) {return a->atom1 < b->atom1; });
+		bonds.Select(keptBonds);
+		angles.Select(keptAngles);
 	}
 
-	void CalculateNonInts(const std::vector<Bond *> &bonds, const std::vector<Angle *> &angles, const std::vector<Torsion *> &torsions, std::vector<int> &nonInts) {
-		nonInts.clear();
+	void UpdateBonds(BondTable &bonds, const BondGraph &bondGraph) {
+		int nbonds = bonds.GetSize();
 
-		for (Bond *bond : bonds) {
-			nonInts.push_back(bond->atom1);
-			nonInts.push_back(bond->atom2);
-			nonInts.push_back(bond->atom2);
-			nonInts.push_back(bond->atom1);
+		for (int n = 0; n < nbonds; n++) {
+			bonds.distance[n] = bondGraph.GetLength(bonds.graphIndex[n]);
 		}
+	}
 
-		for (Angle *angle : angles) {
-			nonInts.push_back(angle->atom1);
-			nonInts.push_back(angle->atom3);
-			nonInts.push_back(angle->atom3);
-			nonInts.push_back(angle->atom1);
-		}
+	void MakeMoleculesWhole(ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box) {
+		if (!box.IsPeriodic()) return;
 
-		for (Torsion *torsion : torsions) {
-			nonInts.push_back(torsion->atom1);
-			nonInts.push_back(torsion->atom4);
-			nonInts.push_back(torsion->atom4);
-			nonInts.push_back(torsion->atom1);
-		}
+		std::vector<int> offsets;
+		std::vector<int> atoms;
 
-		// TODO: implement sorting. std::sort(nonInts.begin(), nonInts.end());
-	}
+		/* The components come in breadth-first order, so every atom after the first of its molecule has a bonded
+		   atom before it that is already in place. */
+		bondGraph.FindComponents(offsets, atoms);
+
+		std::vector<bool> placed(particles.GetSize(), false);
+
+		for (int n = 0; n < (int)atoms.size(); n++) {
+			int i = atoms[n];
+
+			for (int edge = bondGraph.GetOffsets()[i]; edge < bondGraph.GetOffsets()[i + 1]; edge++) {
+				int j = bondGraph.GetNeighbor(edge);
+
+				if (!placed[j]) continue;
+
+				double a = particles.position[0][i] - particles.position[0][j];
+				double b = particles.position[1][i] - particles.position[1][j];
+				double c = particles.position[2][i] - particles.position[2][j];
 
-	void UpdateBonds(std::vector<Bond *> &bonds, const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph) {
-		for (Bond *bond : bonds) {
-			math::Vec3 position1 = atoms[bond->atom1]->position;
-			math::Vec3 position2 = atoms[bond->atom2]->position;
+				box.ApplyMinimumImage(a, b, c);
 
-			bond->distance = GetRij(position1, position2);
+				particles.position[0][i] = particles.position[0][j] + a;
+				particles.position[1][i] = particles.position[1][j] + b;
+				particles.position[2][i] = particles.position[2][j] + c;
 
-			bondGraph[bond->atom1][bond->atom2] = bond->distance;
-			bondGraph[bond->atom2][bond->atom1] = bond->distance;
+				break;
+			}
+
+			placed[i] = true;
 		}
 	}
 
-	void UpdateAngles(std::vector<Angle *> &angles, const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph) {
-		for (Angle *angle : angles) {
-			double r12 = bondGraph[angle->atom1][angle->atom2];
-			double r23 = bondGraph[angle->atom2][angle->atom3];
-			math::Vec3 position1 = atoms[angle->atom1]->position;
-			math::Vec3 position2 = atoms[angle->atom2]->position;
-			math::Vec3 position3 = atoms[angle->atom3]->position;
+	void UpdateAngles(AngleTable &angles, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box) {
+		int nangles = angles.GetSize();
 
-			angle->degrees = GetAijk(position1, position2, position3, r12, r23);
+		for (int n = 0; n < nangles; n++) {
+			double r12 = bondGraph.GetLength(angles.bond12[n]);
+			double r23 = bondGraph.GetLength(angles.bond23[n]);
+			math::Vec3 position2 = particles.GetPosition(angles.atom2[n]);
+			math::Vec3 position1 = box.GetNearestImage(particles.GetPosition(angles.atom1[n]), position2);
+			math::Vec3 position3 = box.GetNearestImage(particles.GetPosition(angles.atom3[n]), position2);
+
+			angles.degrees[n] = GetAijk(position1, position2, position3, r12, r23);
 		}
 	}
 
-	void UpdateTorsions(std::vector<Torsion *> &torsions, const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph) {
-		for (Torsion *torsion : torsions) {
-			double r12 = bondGraph[torsion->atom1][torsion->atom2];
-			double r23 = bondGraph[torsion->atom2][torsion->atom3];
-			double r34 = bondGraph[torsion->atom3][torsion->atom4];
-			math::Vec3 position1 = atoms[torsion->atom1]->position;
-			math::Vec3 position2 = atoms[torsion->atom2]->position;
-			math::Vec3 position3 = atoms[torsion->atom3]->position;
-			math::Vec3 position4 = atoms[torsion->atom4]->position;
-
-			torsion->degrees = GetTijkl(position1, position2, position3, position4, r12, r23, r34);
+	void UpdateTorsions(TorsionTable &torsions, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box) {
+		int ntorsions = torsions.GetSize();
+
+		for (int n = 0; n < ntorsions; n++) {
+			double r12 = bondGraph.GetLength(torsions.bond12[n]);
+			double r23 = bondGraph.GetLength(torsions.bond23[n]);
+			double r34 = bondGraph.GetLength(torsions.bond34[n]);
+			math::Vec3 position2 = particles.GetPosition(torsions.atom2[n]);
+			math::Vec3 position1 = box.GetNearestImage(particles.GetPosition(torsions.atom1[n]), position2);
+			math::Vec3 position3 = box.GetNearestImage(particles.GetPosition(torsions.atom3[n]), position2);
+			math::Vec3 position4 = box.GetNearestImage(particles.GetPosition(torsions.atom4[n]), position3);
+
+			torsions.degrees[n] = GetTijkl(position1, position2, position3, position4, r12, r23, r34);
 		}
 	}
 
-	void UpdateOutOfPlanes(std::vector<OutOfPlane *> &outOfPlanes, const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph) {
-		for (OutOfPlane *outOfPlane : outOfPlanes) {
-			double r31 = bondGraph[outOfPlane->atom3][outOfPlane->atom1];
-			double r32 = bondGraph[outOfPlane->atom3][outOfPlane->atom2];
-			double r34 = bondGraph[outOfPlane->atom3][outOfPlane->atom4];
-			math::Vec3 position1 = atoms[outOfPlane->atom1]->position;
-			math::Vec3 position2 = atoms[outOfPlane->atom2]->position;
-			math::Vec3 position3 = atoms[outOfPlane->atom3]->position;
-			math::Vec3 position4 = atoms[outOfPlane->atom4]->position;
-
-			outOfPlane->degrees = GetOijkl(position1, position2, position3, position4, r31, r32, r34);
+	void UpdateOutOfPlanes(OutOfPlaneTable &outOfPlanes, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box) {
+		int noutOfPlanes = outOfPlanes.GetSize();
+
+		for (int n = 0; n < noutOfPlanes; n++) {
+			double r31 = bondGraph.GetLength(outOfPlanes.bond31[n]);
+			double r32 = bondGraph.GetLength(outOfPlanes.bond32[n]);
+			double r34 = bondGraph.GetLength(outOfPlanes.bond34[n]);
+			math::Vec3 position3 = particles.GetPosition(outOfPlanes.atom3[n]);
+			math::Vec3 position1 = box.GetNearestImage(particles.GetPosition(outOfPlanes.atom1[n]), position3);
+			math::Vec3 position2 = box.GetNearestImage(particles.GetPosition(outOfPlanes.atom2[n]), position3);
+			math::Vec3 position4 = box.GetNearestImage(particles.GetPosition(outOfPlanes.atom4[n]), position3);
+
+			outOfPlanes.degrees[n] = GetOijkl(position1, position2, position3, position4, r31, r32, r34);
 		}
 	}
 
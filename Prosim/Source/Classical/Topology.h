@@ -2,24 +2,34 @@
 
 #include <vector>
 
-#include "Angle.h"
 #include "Atom.h"
-#include "Bond.h"
-#include "OutOfPlane.h"
-#include "Torsion.h"
+#include "BondGraph.h"
+#include "BondedTables.h"
+#include "ExclusionTable.h"
+#include "ParticleStore.h"
+#include "PeriodicBox.h"
 
 namespace classical {
 
-	void CalculateBondGraph(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, ForceField *forceField);
-	void CalculateBondGraphFromBonds(int natoms, std::map<int, std::map<int, double>> &bondGraph, const std::vector<Bond *> &bonds);
-	void CalculateBonds(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, std::vector<Bond *> &bonds, ForceField *forceField);
-	void CalculateAngles(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, std::vector<Angle *> &angles, ForceField *forceField);
-	void CalculateTorsions(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, std::vector<Torsion *> &torsions, ForceField *forceField);
-	void CalculateOutOfPlanes(const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph, std::vector<OutOfPlane *> &outOfPlanes, ForceField *forceField);
-	void CalculateNonInts(const std::vector<Bond *> &bonds, const std::vector<Angle *> &angles, const std::vector<Torsion *> &torsions, std::vector<int> &nonInts);
-	void UpdateBonds(std::vector<Bond *> &bonds, const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph);
-	void UpdateAngles(std::vector<Angle *> &angles, const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph);
-	void UpdateTorsions(std::vector<Torsion *> &torsions, const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph);
-	void UpdateOutOfPlanes(std::vector<OutOfPlane *> &outOfPlanes, const std::vector<Atom *> &atoms, std::map<int, std::map<int, double>> &bondGraph);
+	/* Appends the flattened (i, j) pairs closer than BOND_THRESHOLD times the sum of their covalent radii, as minimum images in
+	   a periodic box. */
+	void CalculateBondedPairs(const std::vector<Atom *> &atoms, const ParticleStore &particles, std::vector<int> &bondedPairs, const PeriodicBox &box = PeriodicBox());
+	void CalculateBondedPairsFromBonds(const BondTable &bonds, std::vector<int> &bondedPairs);
+	void CalculateBonds(const std::vector<Atom *> &atoms, const BondGraph &bondGraph, BondTable &bonds, ForceField *forceField);
+	void CalculateAngles(const std::vector<Atom *> &atoms, const ParticleStore &particles, const BondGraph &bondGraph, AngleTable &angles, ForceField *forceField);
+	void CalculateTorsions(const std::vector<Atom *> &atoms, const ParticleStore &particles, const BondGraph &bondGraph, TorsionTable &torsions, ForceField *forceField);
+	void CalculateOutOfPlanes(const std::vector<Atom *> &atoms, const ParticleStore &particles, const BondGraph &bondGraph, OutOfPlaneTable &outOfPlanes, ForceField *forceField);
+	void CalculateExclusions(int natoms, const BondTable &bonds, const AngleTable &angles, const TorsionTable &torsions, ExclusionTable &exclusions);
+	/* Drops the bonds and angles inside the flattened (oxygen, hydrogen, hydrogen) waters, which SETTLE keeps rigid. The
+	   exclusions have to be calculated before, since the waters keep theirs. */
+	void RemoveRigidWaterTerms(int natoms, const std::vector<int> &waters, BondTable &bonds, AngleTable &angles);
+	/* Moves every atom to the image nearest the bonded atom it is reached from, so that no molecule is split across
+	   the faces of a periodic box. */
+	void MakeMoleculesWhole(ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box);
+	/* The Update functions read the bond lengths cached in bondGraph, so BondGraph::UpdateLengths has to run first. */
+	void UpdateBonds(BondTable &bonds, const BondGraph &bondGraph);
+	void UpdateAngles(AngleTable &angles, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box);
+	void UpdateTorsions(TorsionTable &torsions, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box);
+	void UpdateOutOfPlanes(OutOfPlaneTable &outOfPlanes, const ParticleStore &particles, const BondGraph &bondGraph, const PeriodicBox &box);
 
 }
\ No newline at end of file
@@ -9,7 +9,7 @@ namespace classical {
 		double degrees, double halfBarrierHeight, double barrierOffset, 
 		int barrierFrequency, int paths) 
 
-		: atom1(atom1), atom2(atom2), atom3(atom3), atom4(atom4), 
+		: atom1(atom1), atom2(atom2), atom3(atom3), atom4(atom4), bond12(-1), bond23(-1), bond34(-1), 
 		degrees(degrees), halfBarrierHeight(halfBarrierHeight), barrierOffset(barrierOffset), 
 		barrierFrequency(barrierFrequency), paths(paths) {
 
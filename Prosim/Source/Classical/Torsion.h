@@ -16,6 +16,10 @@ namespace classical {
 		int atom2;
 		int atom3;
 		int atom4;
+		/* BondGraph indices of the bonds 1-2, 2-3 and 3-4. */
+		int bond12;
+		int bond23;
+		int bond34;
 		double degrees;
 		double halfBarrierHeight;
 		double barrierOffset;
@@ -8,14 +8,14 @@ namespace classical {
 
 	namespace utils {
 
-		int CombinationsNR(int n, int r) {
+		long long CombinationsNR(long long n, int r) {
 			if (n < r) return 0;
 			if (n == r) return 1;
 			if (r == 0) return 1;
 
 			if (r > n / 2) return CombinationsNR(n, n - r);
 
-			long res = 1;
+			long long res = 1;
 
 			for (int k = 1; k <= r; ++k)
 			{
@@ -8,12 +8,22 @@ namespace classical {
 
 	namespace utils {
 
-		int CombinationsNR(int n, int r);
+		long long CombinationsNR(long long n, int r);
 		int PermutationsNR(int n, int r);
 		void CombinationArray(int arr[], int data[], std::vector<std::vector<int>> &indices, int start, int end, int index, int r);
 		void CombinationKN(IterationMatrix &matrix, int K, int N);
 		void PermutationPairsVector(const std::vector<int> &v, IterationMatrix &indices);
 
+		/* Calls function(i, j) for every unordered pair i < j of n items in row order, generating the indices on the fly. */
+		template <typename Function>
+		void ForEachPair(int n, Function function) {
+			for (int i = 0; i < n - 1; i++) {
+				for (int j = i + 1; j < n; j++) {
+					function(i, j);
+				}
+			}
+		}
+
 	}
 
 }
\ No newline at end of file